@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Decides when the hook may try to reach WhatsappTray again after a failure.
+// When WhatsappTray is not running, every connect() fails and can take seconds. So after a failure no connection is attempted until the backoff-time is over.
+// The backoff-time doubles with every failure in a row. In the meantime the messages stay in the buffer.
+// NOTE: This file must not depend on Winsock or windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <chrono>
+
+struct ReconnectConfig
+{
+	/* The time to wait after the first failure. */
+	std::chrono::milliseconds initialBackoff = std::chrono::milliseconds(100);
+	/* The time to wait is never longer than this. It is also the longest time until a restarted WhatsappTray gets the messages. */
+	std::chrono::milliseconds maxBackoff = std::chrono::milliseconds(10000);
+};
+
+class CircuitBreaker
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum class State
+	{
+		/* Everything works. Every send is attempted. */
+		Closed,
+		/* The last attempt failed. Nothing is attempted until the backoff-time is over. */
+		Open,
+		/* The backoff-time is over. One attempt is allowed to check if the server is reachable again. */
+		HalfOpen,
+	};
+
+	CircuitBreaker(const ReconnectConfig& config = ReconnectConfig()) : _config(config) { }
+
+	/**
+	 * @brief True if a connection- or send-attempt is allowed now.
+	 */
+	bool AllowAttempt(Clock::time_point now)
+	{
+		if (_state == State::Open && now >= _nextAttempt) {
+			_state = State::HalfOpen;
+		}
+		return _state != State::Open;
+	}
+
+	/**
+	 * @brief The time until AllowAttempt() returns true again. Zero if it already does.
+	 */
+	Clock::duration TimeUntilNextAttempt(Clock::time_point now) const
+	{
+		return _state != State::Open || now >= _nextAttempt ? Clock::duration::zero() : _nextAttempt - now;
+	}
+
+	void OnSuccess()
+	{
+		_state = State::Closed;
+		_failureCount = 0;
+	}
+
+	void OnFailure(Clock::time_point now)
+	{
+		auto backoff = _config.initialBackoff;
+		for (int i = 0; i < _failureCount && backoff < _config.maxBackoff; i++) {
+			backoff *= 2;
+		}
+		if (backoff > _config.maxBackoff) {
+			backoff = _config.maxBackoff;
+		}
+
+		_failureCount++;
+		_state = State::Open;
+		_nextAttempt = now + backoff;
+	}
+
+private:
+	ReconnectConfig _config;
+	State _state = State::Closed;
+	/* The count of failures in a row. */
+	int _failureCount = 0;
+	Clock::time_point _nextAttempt;
+};
@@ -107,7 +107,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 		break;
 	}
 	case DLL_PROCESS_DETACH: {
-		LogString("Detach hook.dll from ProcessID: 0x%08X", _processID);
+		LogImportant("Detach hook.dll from ProcessID: 0x%08X", _processID);
 
 		// Remove our window-proc from the chain by setting the original window-proc.
 		if (_originalWndProc != NULL) {
@@ -118,7 +118,13 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 		// Because according to this:https://docs.microsoft.com/en-ca/windows/win32/dlls/dynamic-link-library-best-practices?redirectedfrom=MSDN
 		// All threads should be terminated already?
 		// Anyway without stopping a messagebox with an error will appear.
-		SocketStop();
+		// SocketStop() returns after a short time, also when WhatsappTray does not read the remaining messages. So WhatsApp is never kept from exiting.
+		auto unsentCount = SocketStop();
+		if (unsentCount > 0) {
+			char message[128];
+			snprintf(message, sizeof(message), "Hook: %llu log-messages were dropped on exit.", static_cast<unsigned long long>(unsentCount));
+			OutputDebugStringA(message);
+		}
 
 		// Cleanup COM-lib usage (for _pTaskbarList)
 		CoUninitialize();
@@ -133,12 +139,13 @@ DWORD WINAPI Init(LPVOID lpParam)
 {
 	//OutputDebugStringA("Hook-init-thread is started");
 
+	WinSockLogger::OpenLogControl();
 	SocketStart(LOGGER_IP, LOGGER_PORT);
 
 	// Find the WhatsApp window-handle that we need to replace the window-proc
 	_processID = GetCurrentProcessId();
 
-	LogString("Attached hook.dll to ProcessID: 0x%08X", _processID);
+	LogImportant("Attached hook.dll to ProcessID: 0x%08X", _processID);
 
 	auto filepath = GetFilepathFromProcessID(_processID);
 
@@ -147,10 +154,10 @@ DWORD WINAPI Init(LPVOID lpParam)
 	 * the easiest/best way to detect that is by setting a enviroment variable before LoadLibrary() */
 	auto envValue = GetEnviromentVariable(WHATSAPPTRAY_LOAD_LIBRARY_TEST_ENV_VAR);
 
-	LogString("Filepath: '%s' " WHATSAPPTRAY_LOAD_LIBRARY_TEST_ENV_VAR ": '%s'", filepath.c_str(), envValue.c_str());
+	LogImportant("Filepath: '%s' " WHATSAPPTRAY_LOAD_LIBRARY_TEST_ENV_VAR ": '%s'", filepath.c_str(), envValue.c_str());
 
 	if (envValue.compare(WHATSAPPTRAY_LOAD_LIBRARY_TEST_ENV_VAR_VALUE) == 0) {
-		LogString("Detected that this Attache was triggered by LoadLibrary() => Cancel further processing");
+		LogImportant("Detected that this Attache was triggered by LoadLibrary() => Cancel further processing");
 
 		// It is best to remove the variable here so we can be sure it is not removed before it was detected.
 		// Delete enviroment-variable by setting it to "".
@@ -161,10 +168,10 @@ DWORD WINAPI Init(LPVOID lpParam)
 	_whatsAppWindowHandle = GetTopLevelWindowhandleWithName(WHATSAPP_CLIENT_NAME);
 	auto windowTitle = GetWindowTitle(_whatsAppWindowHandle);
 
-	LogString("Attached in window '%s' _whatsAppWindowHandle: 0x%08X", windowTitle.c_str(), _whatsAppWindowHandle);
+	LogImportant("Attached in window '%s' _whatsAppWindowHandle: 0x%08X", windowTitle.c_str(), _whatsAppWindowHandle);
 
 	if (_whatsAppWindowHandle == NULL) {
-		LogString("Error, window-handle for '" WHATSAPP_CLIENT_NAME "' was not found");
+		LogFailure("Error, window-handle for '" WHATSAPP_CLIENT_NAME "' was not found");
 		return 2;
 	}
 
@@ -182,14 +189,14 @@ DWORD WINAPI Init(LPVOID lpParam)
 
 	_whatsappTrayPath = GetWhatsappTrayPath();
 	if (_whatsappTrayPath.length() == 0) {
-		LogString("GetWhatsappTrayPath FAILED");
+		LogFailure("GetWhatsappTrayPath FAILED");
 		return 3;
 	}
-	LogString("_whatsappTrayPath=%s", _whatsappTrayPath.c_str());
+	LogImportant("_whatsappTrayPath=%s", _whatsappTrayPath.c_str());
 
 	HRESULT hrInit = CoInitialize(NULL);
 	if (FAILED(hrInit)) {
-		LogString("CoInitialize FAILED");
+		LogFailure("CoInitialize FAILED");
 		return 4;
 	}
 
@@ -197,10 +204,10 @@ DWORD WINAPI Init(LPVOID lpParam)
 	_setOverlayIconMemoryAddress = GetSetOverlayIconMemoryAddressFromVtable(iTaskbarList3Vtable);
 
 	auto Rerouted_SetOverlayIcon_Addr = (intptr_t)Rerouted_SetOverlayIcon;
-	LogString("Rerouted_SetOverlayIcon-address=%llX.", Rerouted_SetOverlayIcon);
+	LogImportant("Rerouted_SetOverlayIcon-address=%llX.", Rerouted_SetOverlayIcon);
 
 	if (WriteJumpToFunctionInVtable(iTaskbarList3Vtable, Rerouted_SetOverlayIcon_Addr) == false) {
-		LogString("WriteJumpToFunctionInVtable FAILED");
+		LogFailure("WriteJumpToFunctionInVtable FAILED");
 		return 5;
 	}
 
@@ -215,7 +222,7 @@ DWORD WINAPI Init(LPVOID lpParam)
  */
 void OnWhatsAppFullyInitialized()
 {
-	LogString("WhatsAppFullyInitialized");
+	LogImportant("WhatsAppFullyInitialized");
 
 	std::this_thread::sleep_for(std::chrono::seconds(5));
 
@@ -233,7 +240,7 @@ static LRESULT APIENTRY RedirectedWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 	static UINT s_uTBBC = WM_NULL;
 
 	if (s_uTBBC == WM_NULL) {
-		LogString("RegisterWindowMessage");
+		LogWindowMessage("RegisterWindowMessage");
 
 		// In case the application is run elevated, allow the
 		// TaskbarButtonCreated message through.
@@ -249,11 +256,11 @@ static LRESULT APIENTRY RedirectedWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 		if (!_pTaskbarList) {
 			HRESULT hr = CoCreateInstance(CLSID_TaskbarList, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&_pTaskbarList));
 			if (SUCCEEDED(hr)) {
-				LogString("CoCreateInstance SUCCEEDED %llX", _pTaskbarList);
+				LogWindowMessage("CoCreateInstance SUCCEEDED %llX", _pTaskbarList);
 
 				hr = _pTaskbarList->HrInit();
 				if (FAILED(hr)) {
-					LogString("CoCreateInstance FAILED");
+					LogFailure("CoCreateInstance FAILED");
 
 					_pTaskbarList->Release();
 					_pTaskbarList = NULL;
@@ -263,24 +270,22 @@ static LRESULT APIENTRY RedirectedWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 
 	}
 
-	std::ostringstream traceBuffer;
-
-#ifdef _DEBUG
-	if (uMsg != WM_GETTEXT) {
-		// Dont print WM_GETTEXT so there is not so much "spam"
-
+	// Dont print WM_GETTEXT so there is not so much "spam"
+	// When the trace-level is off, this only costs the check of the control-block. (See LogControl.h)
+	static LogRateLimiter windowMessageRateLimiter;
+	if (uMsg != WM_GETTEXT && WinSockLogger::IsEnabled(HookLogLevel::Trace, LogCategory::WindowMessages) && WinSockLogger::PassesRateLimit(windowMessageRateLimiter, MODULE_NAME, __func__)) {
+		std::ostringstream traceBuffer;
 		traceBuffer << MODULE_NAME << "::" << __func__ << ": " << WindowsMessage::GetString(uMsg) << "(0x" << std::uppercase << std::hex << uMsg << ") ";
 		traceBuffer << "windowTitle='" << GetWindowTitle(hwnd) << "' ";
 		traceBuffer << "hwnd=0x'" << std::uppercase << std::hex << hwnd << "' ";
 		traceBuffer << "wParam=0x'" << std::uppercase << std::hex << wParam << "' ";
 		WinSockLogger::TraceStream(traceBuffer);
 	}
-#endif
 
 	if (uMsg == WM_SYSCOMMAND) {
 		// Description for WM_SYSCOMMAND: https://msdn.microsoft.com/de-de/library/windows/desktop/ms646360(v=vs.85).aspx
 		if (wParam == SC_MINIMIZE) {
-			LogString("SC_MINIMIZE received");
+			LogWindowMessage("SC_MINIMIZE received");
 
 			// Here i check if the windowtitle matches. Vorher hatte ich das Problem das sich Chrome auch minimiert hat.
 			if (hwnd == _whatsAppWindowHandle) {
@@ -288,22 +293,22 @@ static LRESULT APIENTRY RedirectedWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 			}
 		}
 	} else if (uMsg == WM_NCDESTROY) {
-		LogString("WM_NCDESTROY received");
+		LogWindowMessage("WM_NCDESTROY received");
 
 		if (hwnd == _whatsAppWindowHandle) {
 			auto successfulSent = SendMessageToWhatsappTray(WM_WHAHTSAPP_CLOSING);
 			if (successfulSent) {
-				LogString("WM_WHAHTSAPP_CLOSING successful sent.");
+				LogWindowMessage("WM_WHAHTSAPP_CLOSING successful sent.");
 			}
 		}
 	} else if (uMsg == WM_CLOSE) {
 		// This happens when alt + f4 is pressed.
-		LogString("WM_CLOSE received. Probably Alt + F4");
+		LogWindowMessage("WM_CLOSE received. Probably Alt + F4");
 
 		// Notify WhatsappTray and if it wants to close it can do so...
 		SendMessageToWhatsappTray(WM_WHATSAPP_TO_WHATSAPPTRAY_RECEIVED_WM_CLOSE);
 
-		LogString("WM_CLOSE blocked.");
+		LogWindowMessage("WM_CLOSE blocked.");
 
 		// Block WM_CLOSE
 		return 0;
@@ -311,15 +316,15 @@ static LRESULT APIENTRY RedirectedWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 		// This message is defined by me and should only come from WhatsappTray.
 		// It more or less replaces WM_CLOSE which is now always blocked...
 		// To have a way to still send WM_CLOSE this message was made.
-		LogString("WM_WHATSAPPTRAY_TO_WHATSAPP_SEND_WM_CLOSE received");
+		LogWindowMessage("WM_WHATSAPPTRAY_TO_WHATSAPP_SEND_WM_CLOSE received");
 
-		LogString("Send WM_CLOSE to WhatsApp.");
+		LogWindowMessage("Send WM_CLOSE to WhatsApp.");
 		// NOTE: lParam/wParam are not used in WM_CLOSE.
 		return CallWindowProc(_originalWndProc, hwnd, WM_CLOSE, 0, 0);
 	} else if (uMsg == WM_DPICHANGED) {
-		LogString("WM_DPICHANGED received");
+		LogWindowMessage("WM_DPICHANGED received");
 
-		LogString("Updating the Dpi");
+		LogWindowMessage("Updating the Dpi");
 		UpdateDpi(_whatsAppWindowHandle);
 	} else if (uMsg == WM_LBUTTONUP) {
 		// Unblock ShowWindow()-function if a mouseclick is registered.
@@ -327,7 +332,7 @@ static LRESULT APIENTRY RedirectedWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 
 		// Note x and y are clientare-coordiantes
 		auto clickPoint = LParamToPoint(lParam);
-		LogString("WM_LBUTTONUP received x=%d y=%d", clickPoint.x, clickPoint.y);
+		LogWindowMessage("WM_LBUTTONUP received x=%d y=%d", clickPoint.x, clickPoint.y);
 
 		RECT rect;
 		GetClientRect(hwnd, &rect);
@@ -346,19 +351,19 @@ static LRESULT APIENTRY RedirectedWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 		// calculate x-distance fom right window border
 		int windowWidth = rect.right - rect.left;
 		int xDistanceFromRight = windowWidth - clickPoint.x;
-		LogString("WM_LBUTTONUP => windowWidth=%d xDistanceFromRight=%d widthOfButton=%d", windowWidth, xDistanceFromRight, widthOfButton);
+		LogWindowMessage("WM_LBUTTONUP => windowWidth=%d xDistanceFromRight=%d widthOfButton=%d", windowWidth, xDistanceFromRight, widthOfButton);
 
 		if (xDistanceFromRight <= widthOfButton && clickPoint.y <= heightOfButton) {
 			SendMessageToWhatsappTray(WM_WA_CLOSE_BUTTON_PRESSED);
 
-			LogString("Block WM_LBUTTONUP");
+			LogWindowMessage("Block WM_LBUTTONUP");
 			return 0;
 		}
 	} else if (uMsg == WM_RBUTTONUP) {
 		// Unblock ShowWindow()-function if a mouseclick is registered.
 		UnblockShowWindowFunction();
 	} else if (uMsg == WM_KEYUP) {
-		LogString("WM_KEYUP received key=%d", wParam);
+		LogWindowMessage("WM_KEYUP received key=%d", wParam);
 
 		SendMessageToWhatsappTray(WM_WA_KEY_PRESSED, wParam, lParam);
 	}
@@ -378,14 +383,14 @@ static void UpdateDpi(HWND hwnd)
 	if (shcoreLib == NULL) {
 		shcoreLib = LoadLibrary("Shcore.dll");
 		if (shcoreLib == NULL) {
-			LogString("Could not load Shcore.dll");
+			LogFailure("Could not load Shcore.dll");
 			return;
 		}
 	}
 
 	auto GetDpiForMonitor = reinterpret_cast<GetDpiForMonitorFunc>(GetProcAddress(shcoreLib, "GetDpiForMonitor"));
 	if (CallWndRetProc == NULL) {
-		LogString("The function 'GetDpiForMonitor' was not found");
+		LogFailure("The function 'GetDpiForMonitor' was not found");
 		return;
 	}
 
@@ -397,7 +402,7 @@ static void UpdateDpi(HWND hwnd)
 	auto result = GetDpiForMonitor(monitorHandle, MDT_DEFAULT, &_dpiX, &_dpiY);
 
 	if (result != S_OK) {
-		LogString("Error when getting the dpi for WhatsApp");
+		LogFailure("Error when getting the dpi for WhatsApp");
 		// Continue even with the error...
 	} else {
 		LogString("The dpi for WhatsApp is dpiX: %d dpiY: %d", _dpiX, _dpiY);
@@ -557,7 +562,7 @@ static bool BlockShowWindowFunction()
 	// Get the User32.dll-handle
 	auto hLib = LoadLibrary("User32.dll");
 	if (hLib == NULL) {
-		LogString("Error loading User32.dll");
+		LogFailure("Error loading User32.dll");
 		return false;
 	}
 	LogString("loading User32.dll finished");
@@ -565,7 +570,7 @@ static bool BlockShowWindowFunction()
 	// Get the address of the ShowWindow()-function of the User32.dll
 	auto showWindowFunc = (HOOKPROC)GetProcAddress(hLib, "ShowWindow");
 	if (showWindowFunc == NULL) {
-		LogString("The function 'ShowWindow' was NOT found");
+		LogFailure("The function 'ShowWindow' was NOT found");
 		return false;
 	}
 	LogString("The function 'ShowWindow' was NOT found (0x%" PRIx64 ")", showWindowFunc);
@@ -579,7 +584,7 @@ static bool BlockShowWindowFunction()
 
 	// Read the first byte of the ShowWindow()-function
 	auto showWindowFunc_FirstByte = *((uint8_t*)showWindowFunc);
-	LogString("First byte of the ShowWindow()-function =0X% (before change)" PRIx8 " NOTE: 0xFF is expected", showWindowFunc_FirstByte);
+	LogString("First byte of the ShowWindow()-function =0x%" PRIX8 " (before change) NOTE: 0xFF is expected", showWindowFunc_FirstByte);
 
 	// Write 0xC3 to the first byte of the ShowWindow()-function
 	// This translate to a "RET"-command so the function will immediatly return instead of the normal jmp-command
@@ -587,7 +592,7 @@ static bool BlockShowWindowFunction()
 
 	// Read the first byte of the ShowWindow()-function to see that it has worked
 	showWindowFunc_FirstByte = *((uint8_t*)showWindowFunc);
-	LogString("First byte of the ShowWindow()-function =0X% (after change)" PRIx8 " NOTE: 0xC3 is expected", showWindowFunc_FirstByte);
+	LogString("First byte of the ShowWindow()-function =0x%" PRIX8 " (after change) NOTE: 0xC3 is expected", showWindowFunc_FirstByte);
 
 	_showWindowFunctionIsBlocked = true;
 
@@ -605,7 +610,7 @@ static bool UnblockShowWindowFunction()
 		// Get the User32.dll-handle
 		auto hLib = LoadLibrary("User32.dll");
 		if (hLib == NULL) {
-			LogString("Error loading User32.dll");
+			LogFailure("Error loading User32.dll");
 			return false;
 		}
 		LogString("loading User32.dll finished");
@@ -613,7 +618,7 @@ static bool UnblockShowWindowFunction()
 		// Get the address of the ShowWindow()-function of the User32.dll
 		auto showWindowFunc = (HOOKPROC)GetProcAddress(hLib, "ShowWindow");
 		if (showWindowFunc == NULL) {
-			LogString("The function 'ShowWindow' was NOT found");
+			LogFailure("The function 'ShowWindow' was NOT found");
 			return false;
 		}
 		LogString("The function 'ShowWindow' was NOT found (0x%" PRIx64 ")", showWindowFunc);
@@ -627,7 +632,7 @@ static bool UnblockShowWindowFunction()
 
 		// Read the first byte of the ShowWindow()-function
 		auto showWindowFunc_FirstByte = *((uint8_t*)showWindowFunc);
-		LogString("First byte of the ShowWindow()-function =0X% (before change)" PRIx8 " NOTE: 0xC3 is expected", showWindowFunc_FirstByte);
+		LogString("First byte of the ShowWindow()-function =0x%" PRIX8 " (before change) NOTE: 0xC3 is expected", showWindowFunc_FirstByte);
 
 		// Write 0xFF to the first byte of the ShowWindow()-function
 		// This should restore the original function
@@ -635,7 +640,7 @@ static bool UnblockShowWindowFunction()
 
 		// Read the first byte of the ShowWindow()-function to see that it has worked
 		showWindowFunc_FirstByte = *((uint8_t*)showWindowFunc);
-		LogString("First byte of the ShowWindow()-function =0X% (after change)" PRIx8 " NOTE: 0xFF is expected", showWindowFunc_FirstByte);
+		LogString("First byte of the ShowWindow()-function =0x%" PRIX8 " (after change) NOTE: 0xFF is expected", showWindowFunc_FirstByte);
 	
 		_showWindowFunctionIsBlocked = false;
 	}
@@ -732,13 +737,13 @@ bool SaveHBITMAPToFile(HBITMAP hBitmap, LPCTSTR fileName)
 	HANDLE hDib = GlobalAlloc(GHND, sizeof(BITMAPINFOHEADER) + dwBmBitsSize + dwPaletteSize);
 
 	if (hDib == NULL) {
-		LogString("hDib == NULL");
+		LogFailure("hDib == NULL");
 		return false;
 	}
 
 	LPBITMAPINFOHEADER lpbi = (LPBITMAPINFOHEADER)GlobalLock(hDib);
 	if (lpbi == NULL) {
-		LogString("lpbi == NULL");
+		LogFailure("lpbi == NULL");
 		return false;
 	}
 	*lpbi = bi;
@@ -762,7 +767,7 @@ bool SaveHBITMAPToFile(HBITMAP hBitmap, LPCTSTR fileName)
 	HANDLE fh = CreateFile(fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
 
 	if (fh == INVALID_HANDLE_VALUE) {
-		LogString("fh == INVALID_HANDLE_VALUE");
+		LogFailure("fh == INVALID_HANDLE_VALUE");
 		return false;
 	}
 
@@ -797,13 +802,13 @@ std::string GetWhatsappTrayPath()
 
 	auto waTrayProcessHandle = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, waTrayProcessId);
 	if (waTrayProcessHandle == NULL) {
-		LogString("Failed to open process.");
+		LogFailure("Failed to open process.");
 		return "";
 	}
 
 	char filename[MAX_PATH];
 	if (GetModuleFileNameEx(waTrayProcessHandle, NULL, filename, MAX_PATH) == 0) {
-		LogString("Failed to get module filename.");
+		LogFailure("Failed to get module filename.");
 		return "";
 	}
 
@@ -822,7 +827,7 @@ intptr_t* GetITaskbarList3Vtable()
 {
 	HRESULT hr = CoCreateInstance(CLSID_TaskbarList, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&_pTaskbarList));
 	if (FAILED(hr)) {
-		LogString("CoCreateInstance FAILED");
+		LogFailure("CoCreateInstance FAILED");
 		return NULL;
 	}
 
@@ -862,7 +867,7 @@ bool WriteJumpToFunctionInVtable(intptr_t* iTaskbarList3_vtableAddress, intptr_t
 	// NOTE: If this is not done WhatsApp will crash!
 	DWORD oldProtect;
 	if (VirtualProtect((PVOID)iTaskbarList3_vtableAddress_To_SetOverlayIcon, 8, PAGE_EXECUTE_READWRITE, &oldProtect) == NULL) {
-		LogString("Failed to change protection-level of memorysection for iTaskbarList3 v-table");
+		LogFailure("Failed to change protection-level of memorysection for iTaskbarList3 v-table");
 		return false;
 	}
 
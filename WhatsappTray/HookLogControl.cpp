@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Implementation for the control-block of the hook.
+
+#include "stdafx.h"
+#include "HookLogControl.h"
+
+#include "SharedDefines.h"
+
+#include "Logger.h"
+
+#undef MODULE_NAME
+#define MODULE_NAME "HookLogControl"
+
+HookLogControl::~HookLogControl()
+{
+	Cleanup();
+}
+
+bool HookLogControl::Create(HookLogLevel level, uint32_t categoryMask)
+{
+	_fileMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(LogControlBlock), LOGGER_CONTROL_NAME);
+	if (_fileMapping == NULL) {
+		LogError("Error occurred while creating the file-mapping: %ld.", GetLastError());
+		return false;
+	}
+	// When a hook of the previous WhatsappTray still holds the mapping, the existing block is used. So the hook gets the new level too.
+
+	_controlBlock = static_cast<LogControlBlock*>(MapViewOfFile(_fileMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(LogControlBlock)));
+	if (_controlBlock == NULL) {
+		LogError("Error occurred while mapping the shared memory: %ld.", GetLastError());
+		Cleanup();
+		return false;
+	}
+
+	Set(level, categoryMask);
+	return true;
+}
+
+void HookLogControl::Set(HookLogLevel level, uint32_t categoryMask)
+{
+	if (_controlBlock == NULL) {
+		return;
+	}
+	_controlBlock->Set(level, categoryMask);
+}
+
+HookLogLevel HookLogControl::Level() const
+{
+	if (_controlBlock == NULL) {
+		return HookLogLevel::Off;
+	}
+	return static_cast<HookLogLevel>(_controlBlock->minLevel.load(std::memory_order_relaxed));
+}
+
+uint32_t HookLogControl::CategoryMask() const
+{
+	if (_controlBlock == NULL) {
+		return 0;
+	}
+	return _controlBlock->categoryMask.load(std::memory_order_relaxed);
+}
+
+void HookLogControl::Cleanup()
+{
+	if (_controlBlock != NULL) {
+		UnmapViewOfFile(_controlBlock);
+		_controlBlock = NULL;
+	}
+	if (_fileMapping != NULL) {
+		CloseHandle(_fileMapping);
+		_fileMapping = NULL;
+	}
+}
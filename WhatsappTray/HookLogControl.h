@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+#pragma once
+
+#include "LogControl.h"
+
+#include <windows.h>
+
+/**
+ * @brief Owns the control-block in shared memory, which sets the level of the log-messages of the hook.
+ */
+class HookLogControl
+{
+public:
+	~HookLogControl();
+
+	/**
+	 * @brief Creates the control-block. Should be called before the hook is set, so the hook already starts with the right level.
+	 */
+	bool Create(HookLogLevel level, uint32_t categoryMask);
+	/**
+	 * @brief Changes the level. The hook uses it with its next log-call.
+	 */
+	void Set(HookLogLevel level, uint32_t categoryMask);
+
+	/**
+	 * @brief The current level. HookLogLevel::Off if the control-block could not be created.
+	 */
+	HookLogLevel Level() const;
+	uint32_t CategoryMask() const;
+
+private:
+	HANDLE _fileMapping = NULL;
+	LogControlBlock* _controlBlock = NULL;
+
+	void Cleanup();
+};
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// A transport that does not leave the process. The batches are handed over through a MessageQueue to an InProcessServer.
+// It is the baseline of the benchmark (See benchmarks/LogTransportBenchmark.cpp): The difference to the other transports is the cost of the operating-system.
+// It is also used by the tests, which need a server that is always reachable.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include "LogServer.h"
+#include "LogTransport.h"
+#include "MessageFraming.h"
+#include "MessageQueue.h"
+
+#include <atomic>
+#include <string>
+
+/**
+ * @brief The connection between InProcessTransport and InProcessServer. Must live longer than both.
+ */
+class InProcessChannel
+{
+public:
+	InProcessChannel(const MessageQueueConfig& config = DefaultConfig()) : _batches(config) { }
+
+	MessageQueue& Batches() { return _batches; }
+
+	/**
+	 * @brief The sender waits for free space, like on a full socket-buffer, instead of dropping a batch.
+	 */
+	static MessageQueueConfig DefaultConfig()
+	{
+		MessageQueueConfig config;
+		config.capacity = 256;
+		config.maxBytes = 16 * 1024 * 1024;
+		config.fullPolicy = QueueFullPolicy::Block;
+		config.blockTimeout = std::chrono::milliseconds(1000);
+		return config;
+	}
+
+private:
+	MessageQueue _batches;
+};
+
+class InProcessTransport : public LogTransport
+{
+public:
+	explicit InProcessTransport(InProcessChannel& channel) : _channel(channel) { }
+
+	bool Open() override { return true; }
+	bool Connect() override { return true; }
+	bool IsConnected() const override { return true; }
+	void SetTimeout(std::chrono::milliseconds /*timeout*/) override { }
+
+	/**
+	 * @brief Copies the batch into the channel. Fails like a socket whose buffer stays full, when the server does not take the batches.
+	 */
+	bool Send(const char data[], size_t size) override
+	{
+		return _channel.Batches().Enqueue(std::string(data, size));
+	}
+
+	void Close() override { }
+	const char* Name() const override { return "in-process"; }
+
+private:
+	InProcessChannel& _channel;
+};
+
+class InProcessServer : public LogServer
+{
+public:
+	explicit InProcessServer(InProcessChannel& channel) : _channel(channel) { }
+
+	/**
+	 * @brief Splits the batches of the channel into records and forwards them. The same as the other servers do with their byte-stream.
+	 */
+	bool Run() override
+	{
+		FrameReader frameReader;
+		std::string batch;
+		std::string record;
+		while (_isRunning) {
+			if (_channel.Batches().WaitDequeue(batch) == false) {
+				continue;
+			}
+
+			frameReader.Append(batch.data(), batch.size());
+			while (frameReader.NextFrame(record)) {
+				ForwardRecord(record);
+			}
+			if (frameReader.HasError()) {
+				ForwardLine("InProcessServer::Run: The stream is corrupt.", 0);
+				break;
+			}
+		}
+		return true;
+	}
+
+	void Stop() override
+	{
+		_isRunning = false;
+		_channel.Batches().WakeUp();
+	}
+
+private:
+	InProcessChannel& _channel;
+	/* Only reset by Stop(), so a Stop() before Run() is not lost. */
+	std::atomic<bool> _isRunning = true;
+};
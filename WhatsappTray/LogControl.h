@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Lets WhatsappTray decide at runtime which log-messages the hook creates.
+// WhatsappTray creates the control-block in shared memory (LOGGER_CONTROL_NAME) and the hook reads it before every log-call, before any argument is evaluated.
+// So when the level is low, a disabled log-call only costs two loads and a compare in WhatsApp.
+// NOTE: This file is used by Hook.dll and WhatsappTray. It must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+enum class HookLogLevel : int32_t
+{
+	Off = 0,
+	Error = 1,
+	/* The steps of the initialization. */
+	Info = 2,
+	Debug = 3,
+	/* Every window-message. Very high volume. */
+	Trace = 4,
+};
+
+namespace LogCategory
+{
+	constexpr uint32_t General = 1u << 0;
+	/* Everything that is logged for the window-messages of WhatsApp. */
+	constexpr uint32_t WindowMessages = 1u << 1;
+	constexpr uint32_t All = 0xFFFFFFFFu;
+}
+
+/**
+ * @brief The settings in the shared memory. Written by WhatsappTray, read by all hooked processes.
+ */
+struct LogControlBlock
+{
+	std::atomic<int32_t> minLevel;
+	std::atomic<uint32_t> categoryMask;
+
+	bool IsEnabled(HookLogLevel level, uint32_t category) const
+	{
+		return static_cast<int32_t>(level) <= minLevel.load(std::memory_order_relaxed) && (categoryMask.load(std::memory_order_relaxed) & category) != 0;
+	}
+
+	void Set(HookLogLevel level, uint32_t mask)
+	{
+		minLevel.store(static_cast<int32_t>(level), std::memory_order_relaxed);
+		categoryMask.store(mask, std::memory_order_relaxed);
+	}
+};
+
+static_assert(std::atomic<int32_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free, "The control-block is shared between processes, so the atomics must not use locks.");
+
+/**
+ * @brief The level when WhatsappTray does not set one.
+ *
+ * All levels are compiled into every build, so the traces of every window-message can be switched on at a production machine without a rebuild.
+ * A release-build starts without them, because they are the bulk of the log.
+ */
+constexpr HookLogLevel DefaultHookLogLevel()
+{
+#ifdef _DEBUG
+	return HookLogLevel::Trace;
+#else
+	return HookLogLevel::Debug;
+#endif
+}
+
+/**
+ * @brief The name of the level for the tray-menu and the log.
+ */
+inline const char* HookLogLevelName(HookLogLevel level)
+{
+	const char* names[] = { "off", "error", "info", "debug", "trace" };
+	auto index = static_cast<int32_t>(level);
+	return index >= 0 && index < 5 ? names[index] : "unknown";
+}
+
+/**
+ * @brief Parses the name of a level. ("off", "error", "info", "debug", "trace")
+ *
+ * @return False if the name is unknown.
+ */
+inline bool ParseHookLogLevel(const char* name, HookLogLevel& level)
+{
+	for (int32_t i = 0; i < 5; i++) {
+		if (strcmp(name, HookLogLevelName(static_cast<HookLogLevel>(i))) == 0) {
+			level = static_cast<HookLogLevel>(i);
+			return true;
+		}
+	}
+	return false;
+}
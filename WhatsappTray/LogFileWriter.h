@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Writes the log-file in a separate thread, so the threads that log never wait for the disk.
+// The callers only append to the front-buffer. The writer-thread swaps it with the back-buffer and writes the back-buffer as one big chunk.
+// The buffers keep their memory after the swap, so appending does not allocate once they have grown.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+struct LogFileWriterConfig
+{
+	/* The longest time a line stays in memory before it is written. */
+	std::chrono::milliseconds flushInterval = std::chrono::milliseconds(200);
+	/* When the front-buffer gets bigger, the writer-thread is woken up before the interval is over. */
+	size_t bufferSize = 64 * 1024;
+};
+
+class LogFileWriter
+{
+public:
+	~LogFileWriter()
+	{
+		Stop();
+	}
+
+	/**
+	 * @brief Starts the writer-thread.
+	 *
+	 * @param output Must stay valid until Stop() is called.
+	 */
+	void Start(std::ostream& output, const LogFileWriterConfig& config = LogFileWriterConfig())
+	{
+		Stop();
+
+		_output = &output;
+		_config = config;
+		_front.reserve(config.bufferSize);
+		_back.reserve(config.bufferSize);
+		_isRunning = true;
+		_writerThread = std::thread(&LogFileWriter::Run, this);
+	}
+
+	/**
+	 * @brief Writes everything that is buffered and stops the writer-thread.
+	 */
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_frontMutex);
+			if (_isRunning == false) {
+				return;
+			}
+			_isRunning = false;
+		}
+		_wakeUp.notify_one();
+		_writerThread.join();
+
+		Flush();
+		std::lock_guard<std::mutex> writeLock(_writeMutex);
+		_output = nullptr;
+	}
+
+	/**
+	 * @brief Appends the text to the front-buffer. Only waits for other callers, never for the disk.
+	 *
+	 * Can be called from any thread.
+	 */
+	void Append(const std::string& text)
+	{
+		bool isFull;
+		{
+			std::lock_guard<std::mutex> lock(_frontMutex);
+			_front.append(text);
+			isFull = _front.size() >= _config.bufferSize;
+		}
+		if (isFull) {
+			_wakeUp.notify_one();
+		}
+	}
+
+	/**
+	 * @brief Writes everything that was appended until now and waits until it is in the file.
+	 *
+	 * Used for fatal errors and at the end, so no line is lost when the process dies.
+	 * Can be called from any thread.
+	 */
+	void Flush()
+	{
+		// Only one thread writes at a time, so the chunks stay in order.
+		std::lock_guard<std::mutex> writeLock(_writeMutex);
+		{
+			std::lock_guard<std::mutex> lock(_frontMutex);
+			_back.swap(_front);
+		}
+
+		if (_output == nullptr) {
+			_back.clear();
+			return;
+		}
+		if (_back.empty() == false) {
+			_output->write(_back.data(), _back.size());
+			_back.clear();
+		}
+		_output->flush();
+	}
+
+private:
+	LogFileWriterConfig _config;
+	std::ostream* _output = nullptr;
+
+	/* Protects _front and _isRunning. */
+	std::mutex _frontMutex;
+	std::condition_variable _wakeUp;
+	std::string _front;
+	bool _isRunning = false;
+
+	/* Held while the back-buffer is written. */
+	std::mutex _writeMutex;
+	std::string _back;
+
+	std::thread _writerThread;
+
+	void Run()
+	{
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(_frontMutex);
+				_wakeUp.wait_for(lock, _config.flushInterval, [this]() { return _isRunning == false || _front.size() >= _config.bufferSize; });
+				if (_isRunning == false) {
+					return;
+				}
+			}
+			Flush();
+		}
+	}
+};
@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Keeps the last log-lines of all levels in memory, also the ones that are not written into the log-file.
+// They are only written when something went wrong, so the details before an error are available without logging everything. (See Logger::DumpFlightRecorder())
+// A line is copied into a fixed slot of a ring-buffer, with the raw timestamp. There is no lock, no allocation and no formatting of the time.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+
+constexpr size_t defaultLogFlightRecorderSlots = 4096;
+
+class LogFlightRecorder
+{
+public:
+	/* Longer lines are cut. */
+	static constexpr size_t maxTextLength = 232;
+
+	struct Entry
+	{
+		int64_t timestamp;
+		uint8_t level;
+		uint16_t length;
+		char text[maxTextLength];
+	};
+
+	/**
+	 * @brief Allocates the slots. Must be called before the first Record().
+	 *
+	 * @param slotCount Is rounded up to a power of two. 0 disables the recorder.
+	 */
+	void Setup(size_t slotCount)
+	{
+		size_t roundedCount = 1;
+		while (roundedCount < slotCount) {
+			roundedCount *= 2;
+		}
+		_slots.reset(slotCount > 0 ? new Slot[roundedCount] : nullptr);
+		_mask = slotCount > 0 ? roundedCount - 1 : 0;
+		_head = 0;
+	}
+
+	bool IsEnabled() const { return _slots != nullptr; }
+
+	/**
+	 * @brief Overwrites the oldest line.
+	 *
+	 * Can be called from multiple threads at the same time.
+	 */
+	void Record(int64_t timestamp, uint8_t level, const char* text)
+	{
+		if (_slots == nullptr) {
+			return;
+		}
+
+		uint64_t index = _head.fetch_add(1, std::memory_order_relaxed);
+		Slot& slot = _slots[index & _mask];
+
+		// An odd sequence means a writer is in the slot. A bigger sequence means a newer line was already written.
+		// Both only happen when all other slots were written in the meantime, so this line is dropped.
+		uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+		if ((sequence & 1) != 0 || sequence > index * 2 || slot.sequence.compare_exchange_strong(sequence, index * 2 + 1, std::memory_order_acquire) == false) {
+			return;
+		}
+
+		size_t length = strnlen(text, maxTextLength);
+		slot.entry.timestamp = timestamp;
+		slot.entry.level = level;
+		slot.entry.length = static_cast<uint16_t>(length);
+		memcpy(slot.entry.text, text, length);
+
+		slot.sequence.store(index * 2 + 2, std::memory_order_release);
+	}
+
+	/**
+	 * @brief Calls visitor with every recorded line, from the oldest to the newest.
+	 *
+	 * Lines that are overwritten while they are read are left out.
+	 */
+	template<typename Visitor>
+	void Visit(Visitor visitor) const
+	{
+		if (_slots == nullptr) {
+			return;
+		}
+
+		uint64_t head = _head.load(std::memory_order_acquire);
+		uint64_t slotCount = _mask + 1;
+		uint64_t first = head > slotCount ? head - slotCount : 0;
+		for (uint64_t index = first; index < head; index++) {
+			const Slot& slot = _slots[index & _mask];
+			if (slot.sequence.load(std::memory_order_acquire) != index * 2 + 2) {
+				continue;
+			}
+
+			Entry entry;
+			memcpy(&entry, &slot.entry, sizeof(entry));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != index * 2 + 2) {
+				continue;
+			}
+			visitor(static_cast<const Entry&>(entry));
+		}
+	}
+
+private:
+	struct Slot
+	{
+		/* (index * 2 + 2) when the line with this index is complete. Odd while it is written. */
+		std::atomic<uint64_t> sequence = 0;
+		Entry entry;
+	};
+
+	std::unique_ptr<Slot[]> _slots;
+	uint64_t _mask = 0;
+	std::atomic<uint64_t> _head = 0;
+};
@@ -0,0 +1,196 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The formatting of the log-messages. Used by WhatsappTray and Hook.dll.
+// LogFormatBuffer formats printf-style into a buffer on the stack and only uses the heap for long lines. Long lines are never truncated.
+// The format-strings of the log-macros are checked at compile-time. (See LOG_CHECK_FORMAT and CountFormatArguments())
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+#if defined(__GNUC__)
+#define LOG_PRINTF_FORMAT(formatIndex, firstArgumentIndex) __attribute__((format(printf, formatIndex, firstArgumentIndex)))
+#else
+#define LOG_PRINTF_FORMAT(formatIndex, firstArgumentIndex)
+#endif
+
+/**
+ * Lets the compiler check the format-string against the arguments like for printf(). The call is never executed.
+ * The format-string is the first of the arguments, so there is no trailing comma when a line has no arguments. (Only MSVC removes it.)
+ */
+#define LOG_CHECK_FORMAT(...) do { if (false) { (void)printf(__VA_ARGS__); } } while (0)
+
+/**
+ * The format-string out of the arguments of a log-macro. LOG_EXPAND() is needed, because the old preprocessor of MSVC passes __VA_ARGS__ as one argument.
+ */
+#define LOG_EXPAND(x) x
+#define LOG_FORMAT_STRING(...) LOG_EXPAND(LOG_FORMAT_STRING_(__VA_ARGS__, unused))
+#define LOG_FORMAT_STRING_(format, ...) format
+
+constexpr bool IsFormatCharacterOf(char character, const char* characters)
+{
+	for (; *characters != '\0'; characters++) {
+		if (*characters == character) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Counts the conversions in a printf-format-string, the same way LogRecordDecoder reads them.
+ *
+ * Used for the log-messages of the hook. They are formatted by WhatsappTray with the type of the argument, so only the count has to match.
+ */
+constexpr size_t CountFormatArguments(const char* format)
+{
+	size_t count = 0;
+	for (size_t position = 0; format[position] != '\0'; position++) {
+		if (format[position] != '%') {
+			continue;
+		}
+		position++;
+		if (format[position] == '%') {
+			continue;
+		}
+
+		while (format[position] != '\0' && IsFormatCharacterOf(format[position], "-+ #0123456789.")) {
+			position++;
+		}
+		while (format[position] != '\0' && IsFormatCharacterOf(format[position], "hlLqjztI0123456789")) {
+			position++;
+		}
+		if (format[position] == '\0') {
+			break;
+		}
+		if (IsFormatCharacterOf(format[position], "diouxXeEfFgGaAcsp")) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Only used in decltype() to count the arguments of a macro, also when there are none.
+ */
+template<typename ... Args>
+std::integral_constant<size_t, sizeof...(Args)> LogArgumentCount(const Args& ...);
+
+class LogFormatBuffer
+{
+public:
+	LogFormatBuffer()
+	{
+		_inline[0] = '\0';
+	}
+	LogFormatBuffer(const LogFormatBuffer&) = delete;
+	LogFormatBuffer& operator=(const LogFormatBuffer&) = delete;
+
+	/**
+	 * @brief The text, always terminated with '\0'.
+	 */
+	const char* Data() const { return _data; }
+	size_t Size() const { return _size; }
+	std::string ToString() const { return std::string(_data, _size); }
+
+	void Clear()
+	{
+		_size = 0;
+		_data[0] = '\0';
+	}
+
+	void Append(const char* text, size_t length)
+	{
+		Reserve(_size + length + 1);
+		memcpy(_data + _size, text, length);
+		_size += length;
+		_data[_size] = '\0';
+	}
+
+	void Append(const char* text)
+	{
+		Append(text, strlen(text));
+	}
+
+	/* NOTE: The index of format is 2, because 'this' is the first parameter. */
+	LOG_PRINTF_FORMAT(2, 3) void AppendFormat(const char* format, ...)
+	{
+		va_list arguments;
+		va_start(arguments, format);
+		AppendFormatV(format, arguments);
+		va_end(arguments);
+	}
+
+	/**
+	 * @return False if the format-string is invalid. Then nothing is appended.
+	 */
+	bool AppendFormatV(const char* format, va_list arguments)
+	{
+		// vsnprintf() uses up the arguments. A copy is needed when the line has to be formatted a second time.
+		va_list argumentsCopy;
+		va_copy(argumentsCopy, arguments);
+
+		int count = vsnprintf(_data + _size, _capacity - _size, format, arguments);
+		if (count >= 0 && _size + count >= _capacity) {
+			// Did not fit. vsnprintf() returned the full length, so one growth is always enough.
+			Reserve(_size + count + 1);
+			count = vsnprintf(_data + _size, _capacity - _size, format, argumentsCopy);
+		}
+		va_end(argumentsCopy);
+
+		if (count < 0) {
+			_data[_size] = '\0';
+			return false;
+		}
+		_size += count;
+		return true;
+	}
+
+private:
+	/* Big enough for almost all log-lines. */
+	static constexpr size_t inlineCapacity = 512;
+
+	/* Not initialized, because that would cost more than the formatting of a short line. */
+	char _inline[inlineCapacity];
+	/* Only used when the text does not fit into _inline. */
+	std::string _heap;
+	char* _data = _inline;
+	size_t _size = 0;
+	size_t _capacity = inlineCapacity;
+
+	void Reserve(size_t capacity)
+	{
+		if (capacity <= _capacity) {
+			return;
+		}
+
+		size_t newCapacity = _capacity * 2 > capacity ? _capacity * 2 : capacity;
+		if (_data == _inline) {
+			_heap.resize(newCapacity);
+			memcpy(&_heap[0], _inline, _size + 1);
+		} else {
+			_heap.resize(newCapacity);
+		}
+		_data = &_heap[0];
+		_capacity = newCapacity;
+	}
+};
+
+/**
+ * @brief Formats printf-style and appends to text. Only allocates when text has to grow.
+ */
+LOG_PRINTF_FORMAT(2, 3) inline void AppendFormat(std::string& text, const char* format, ...)
+{
+	LogFormatBuffer buffer;
+	va_list arguments;
+	va_start(arguments, format);
+	buffer.AppendFormatV(format, arguments);
+	va_end(arguments);
+	text.append(buffer.Data(), buffer.Size());
+}
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The binary format of the log-files, that is written instead of text when "--binaryLog" is passed to WhatsappTray.
+// Every record has a fixed header with the time, level, producer and call-site, so a reader can skip records without looking at the text.
+// The files are read with tools/LogJournalDecoder.cpp, which can filter by level, module, time and producer.
+//
+// File:   [LogJournalFileHeader][record][record]...  Every segment starts with its own file-header.
+// Record: [LogJournalRecordHeader][text]  The text is "<module>::<function>: <message>" without the line-break.
+//         After a crash the rest of the segment is filled with zeros. A record with size 0 ends the file.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+//       The values are written in host byte-order. All supported platforms are little-endian.
+
+#pragma once
+
+#include "LogRecord.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+constexpr char logJournalMagic[4] = { 'W', 'T', 'L', 'J' };
+constexpr uint16_t logJournalVersion = 1;
+constexpr const char* logJournalExtension = ".wtlj";
+
+#pragma pack(push, 1)
+struct LogJournalFileHeader
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t headerSize;
+	/* The same moment in LogClock and in nanoseconds since 1970. Used to turn the timestamps of the records into the time of day. */
+	int64_t clockTimestamp;
+	int64_t unixTimeNs;
+};
+
+struct LogJournalRecordHeader
+{
+	/* The size of the whole record including this header. */
+	uint32_t size;
+	/* The Loglevel of WhatsappTray. 0 when it is not known. */
+	uint8_t level;
+	/* Where the module-name is in the text. moduleLength is 0 if the text has no module. */
+	uint8_t moduleOffset;
+	uint8_t moduleLength;
+	uint8_t reserved;
+	uint32_t producerId;
+	/* A hash of "<module>::<function>". The same call-site always has the same value. */
+	uint32_t callSite;
+	/* Nanoseconds of LogClock. */
+	int64_t timestamp;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(LogJournalRecordHeader) == 24, "The record-header is part of the file-format.");
+
+class LogJournalWriter
+{
+public:
+	static void AppendFileHeader(std::string& journal, int64_t clockTimestamp, int64_t unixTimeNs)
+	{
+		LogJournalFileHeader header;
+		memcpy(header.magic, logJournalMagic, sizeof(header.magic));
+		header.version = logJournalVersion;
+		header.headerSize = sizeof(LogJournalFileHeader);
+		header.clockTimestamp = clockTimestamp;
+		header.unixTimeNs = unixTimeNs;
+		journal.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	}
+
+	/**
+	 * @brief Appends the log-line as record. The module and the call-site are taken from the start of the text.
+	 */
+	static void AppendRecord(std::string& journal, const LogLine& logLine)
+	{
+		size_t textLength = logLine.text.size();
+		while (textLength > 0 && (logLine.text[textLength - 1] == '\n' || logLine.text[textLength - 1] == '\r')) {
+			textLength--;
+		}
+
+		LogJournalRecordHeader header = {};
+		header.size = static_cast<uint32_t>(sizeof(header) + textLength);
+		header.level = logLine.level;
+		header.producerId = logLine.producerId;
+		header.timestamp = logLine.timestamp;
+		FindCallSite(logLine.text.data(), textLength, header);
+
+		journal.append(reinterpret_cast<const char*>(&header), sizeof(header));
+		journal.append(logLine.text.data(), textLength);
+	}
+
+private:
+	static bool IsIdentifierCharacter(char character)
+	{
+		return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || (character >= '0' && character <= '9') || character == '_';
+	}
+
+	/**
+	 * @brief Finds "<module>::<function>" near the start of the text. Also behind a prefix like "Hook> ".
+	 */
+	static void FindCallSite(const char* text, size_t length, LogJournalRecordHeader& header)
+	{
+		// The module is never further in, so long texts are not searched.
+		constexpr size_t maxSearchLength = 128;
+		size_t searchLength = length < maxSearchLength ? length : maxSearchLength;
+
+		const char* separator = nullptr;
+		for (size_t i = 0; i + 1 < searchLength; i++) {
+			if (text[i] == ':' && text[i + 1] == ':') {
+				separator = text + i;
+				break;
+			}
+		}
+		if (separator == nullptr) {
+			return;
+		}
+
+		const char* moduleStart = separator;
+		while (moduleStart > text && IsIdentifierCharacter(moduleStart[-1])) {
+			moduleStart--;
+		}
+		const char* functionEnd = separator + 2;
+		while (functionEnd < text + length && IsIdentifierCharacter(*functionEnd)) {
+			functionEnd++;
+		}
+		if (moduleStart == separator) {
+			return;
+		}
+
+		header.moduleOffset = static_cast<uint8_t>(moduleStart - text);
+		header.moduleLength = static_cast<uint8_t>(separator - moduleStart);
+
+		// FNV-1a
+		uint32_t hash = 2166136261u;
+		for (const char* character = moduleStart; character < functionEnd; character++) {
+			hash = (hash ^ static_cast<uint8_t>(*character)) * 16777619u;
+		}
+		header.callSite = hash;
+	}
+};
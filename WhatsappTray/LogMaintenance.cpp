@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Implementation for the maintenance of the log-folder.
+// The log-files are compressed with the compression of NTFS. So they stay normal text-files that every editor can open, and no library is needed.
+// NOTE: The logger uses this class, so errors can only be reported with OutputDebugStringA().
+
+#include "stdafx.h"
+#include "LogMaintenance.h"
+
+#include "Logger.h"
+
+#include <windows.h>
+#include <winioctl.h>
+#include <algorithm>
+
+/* How often the log-folder is checked when nothing happens. */
+constexpr std::chrono::seconds maintenanceInterval(60);
+
+LogMaintenance::~LogMaintenance()
+{
+	Stop();
+}
+
+void LogMaintenance::Start(const std::string& logDirectory, const LogRotationConfig& config)
+{
+	Stop();
+
+	_logDirectory = logDirectory;
+	_config = config;
+	_isRunning = true;
+	_isWokenUp = false;
+	_thread = std::thread(&LogMaintenance::Run, this);
+}
+
+void LogMaintenance::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_isRunning == false) {
+			return;
+		}
+		_isRunning = false;
+	}
+	_wakeUp.notify_one();
+	_thread.join();
+}
+
+void LogMaintenance::WakeUp()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isWokenUp = true;
+	}
+	_wakeUp.notify_one();
+}
+
+void LogMaintenance::Run()
+{
+	// Also lowers the priority of the disk-accesses, so the compression does not slow down WhatsApp or the logger.
+	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+	while (true) {
+		// A call-site that stopped logging still holds its counts. They are written at the latest after one interval.
+		Logger::ReportPendingRateLimits();
+		Logger::RotateLogSegmentIfOlderThan(_config.maxSegmentAge);
+
+		auto files = ListLogFiles();
+		CompressSealedFiles(files);
+		DeleteOldFiles(files);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wakeUp.wait_for(lock, maintenanceInterval, [this]() { return _isRunning == false || _isWokenUp; });
+		if (_isRunning == false) {
+			break;
+		}
+		_isWokenUp = false;
+	}
+
+	SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+}
+
+/**
+ * @brief Returns the log-files of all sessions, sorted from the oldest to the newest.
+ */
+std::vector<LogFileInfo> LogMaintenance::ListLogFiles()
+{
+	std::vector<LogFileInfo> files;
+	std::string activePath = Logger::ActiveLogFilePath();
+
+	WIN32_FIND_DATAA findData;
+	// "Log_*" also finds the binary journals (".wtlj").
+	HANDLE findHandle = FindFirstFileA((_logDirectory + "Log_*").c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE) {
+		return files;
+	}
+
+	do {
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+			continue;
+		}
+
+		LogFileInfo file;
+		file.path = _logDirectory + findData.cFileName;
+
+		DWORD sizeHigh = 0;
+		DWORD sizeLow = GetCompressedFileSizeA(file.path.c_str(), &sizeHigh);
+		if (sizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+			sizeLow = findData.nFileSizeLow;
+			sizeHigh = findData.nFileSizeHigh;
+		}
+		file.size = (static_cast<uint64_t>(sizeHigh) << 32) | sizeLow;
+
+		// FILETIME counts 100ns-steps since 1601. The system_clock of MSVC counts from 1970.
+		constexpr int64_t fileTimeTo1970 = 116444736000000000;
+		int64_t fileTime = (static_cast<int64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) | findData.ftLastWriteTime.dwLowDateTime;
+		file.lastWriteTime = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds((fileTime - fileTimeTo1970) * 100)));
+
+		file.isActive = _stricmp(file.path.c_str(), activePath.c_str()) == 0;
+		file.isCompressed = (findData.dwFileAttributes & FILE_ATTRIBUTE_COMPRESSED) != 0;
+		files.push_back(file);
+	} while (FindNextFileA(findHandle, &findData));
+	FindClose(findHandle);
+
+	std::sort(files.begin(), files.end(), [](const LogFileInfo& a, const LogFileInfo& b) { return a.lastWriteTime < b.lastWriteTime; });
+	return files;
+}
+
+void LogMaintenance::CompressSealedFiles(std::vector<LogFileInfo>& files)
+{
+	for (auto& file : files) {
+		if (_isCompressionSupported == false) {
+			return;
+		}
+		if (file.isActive || file.isCompressed) {
+			continue;
+		}
+
+		HANDLE fileHandle = CreateFileA(file.path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			// Probably opened by someone else. Is tried again in the next pass.
+			continue;
+		}
+
+		USHORT compressionFormat = COMPRESSION_FORMAT_DEFAULT;
+		DWORD bytesReturned = 0;
+		if (DeviceIoControl(fileHandle, FSCTL_SET_COMPRESSION, &compressionFormat, sizeof(compressionFormat), NULL, 0, &bytesReturned, NULL) == FALSE) {
+			auto error = GetLastError();
+			if (error == ERROR_INVALID_FUNCTION || error == ERROR_NOT_SUPPORTED) {
+				OutputDebugStringA("WARNING: The file-system of the log-folder does not support compression.\n");
+				_isCompressionSupported = false;
+			}
+		} else {
+			file.isCompressed = true;
+			DWORD sizeHigh = 0;
+			DWORD sizeLow = GetCompressedFileSizeA(file.path.c_str(), &sizeHigh);
+			if (sizeLow != INVALID_FILE_SIZE || GetLastError() == NO_ERROR) {
+				file.size = (static_cast<uint64_t>(sizeHigh) << 32) | sizeLow;
+			}
+		}
+		CloseHandle(fileHandle);
+	}
+}
+
+void LogMaintenance::DeleteOldFiles(const std::vector<LogFileInfo>& files)
+{
+	for (auto index : SelectLogFilesToDelete(files, _config, std::chrono::system_clock::now())) {
+		if (DeleteFileA(files[index].path.c_str()) == FALSE) {
+			OutputDebugStringA(("WARNING: The old log-file '" + files[index].path + "' could not be deleted.\n").c_str());
+		}
+	}
+}
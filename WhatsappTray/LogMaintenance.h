@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+#pragma once
+
+#include "LogRetention.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Keeps the log-folder small in a background-thread with low priority.
+ *
+ * Starts a new segment when the current one gets too old, compresses the sealed log-files and deletes the oldest files when the budget is exceeded.
+ * The logger never waits for it, except for the short moment in which a segment is replaced.
+ */
+class LogMaintenance
+{
+public:
+	~LogMaintenance();
+
+	void Start(const std::string& logDirectory, const LogRotationConfig& config);
+	void Stop();
+	/**
+	 * @brief Starts the next pass now, for example because a segment was sealed.
+	 */
+	void WakeUp();
+
+private:
+	std::string _logDirectory;
+	LogRotationConfig _config;
+	/* False when the file-system of the log-folder can not compress. */
+	bool _isCompressionSupported = true;
+
+	std::mutex _mutex;
+	std::condition_variable _wakeUp;
+	bool _isRunning = false;
+	bool _isWokenUp = false;
+	std::thread _thread;
+
+	void Run();
+	std::vector<LogFileInfo> ListLogFiles();
+	void CompressSealedFiles(std::vector<LogFileInfo>& files);
+	void DeleteOldFiles(const std::vector<LogFileInfo>& files);
+};
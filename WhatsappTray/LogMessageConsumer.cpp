@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+#include "stdafx.h"
+#include "LogMessageConsumer.h"
+
+#include "Logger.h"
+
+#undef MODULE_NAME
+#define MODULE_NAME "LogMessageConsumer"
+
+/* The first depth that is reported. Below that the consumer just is a little behind. */
+constexpr size_t firstDepthWarning = 256;
+
+LogMessageConsumer::LogMessageConsumer(const std::function<void(const LogLine&)>& handler, std::chrono::nanoseconds reorderWindow, const MessageQueueConfig& queueConfig)
+	: _handler(handler), _queue(queueConfig), _reorderBuffer(reorderWindow)
+{
+}
+
+/**
+ * @brief The log-lines are dropped rather than letting the memory of WhatsappTray grow without limit, when the disk can not keep up.
+ */
+MessageQueueConfig LogMessageConsumer::DefaultQueueConfig()
+{
+	MessageQueueConfig queueConfig;
+	queueConfig.capacity = 16 * 1024;
+	queueConfig.maxBytes = 16 * 1024 * 1024;
+	queueConfig.fullPolicy = QueueFullPolicy::DropNewest;
+	return queueConfig;
+}
+
+void LogMessageConsumer::Start()
+{
+	_maxDepth = 0;
+	_depthWarningThreshold = firstDepthWarning;
+	_isRunning = true;
+	_consumerThread = std::thread(&LogMessageConsumer::Consume, this);
+}
+
+void LogMessageConsumer::Push(const LogLine& logLine)
+{
+	std::string record;
+	LogRecordWriter::BeginText(record, logLine.producerId, logLine.timestamp, logLine.level);
+	record.append(logLine.text);
+	_queue.Enqueue(std::move(record));
+}
+
+/**
+ * @brief Handles all log-lines that are still in the queue and stops the consumer-thread.
+ */
+void LogMessageConsumer::Stop()
+{
+	_isRunning = false;
+	_queue.WakeUp();
+
+	if (_consumerThread.joinable()) {
+		_consumerThread.join();
+	}
+
+	LogInfo("Maximum depth of the hook-messages: %zu", MaxDepth());
+}
+
+void LogMessageConsumer::Consume()
+{
+	std::string record;
+	while (_isRunning) {
+		// Wait for the next line, but only until the next held back line is ready.
+		bool hasRecord;
+		if (_reorderBuffer.IsEmpty()) {
+			hasRecord = _queue.WaitDequeue(record);
+		} else {
+			auto timeUntilRelease = std::chrono::nanoseconds(_reorderBuffer.NextReleaseTime() - LogRecordWriter::Now());
+			// Round up, so the line is really ready when the wait is over.
+			hasRecord = _queue.WaitDequeueTimed(record, std::chrono::duration_cast<std::chrono::microseconds>(timeUntilRelease) + std::chrono::microseconds(1));
+		}
+
+		if (hasRecord) {
+			UpdateDepth();
+			TakeRecord(record);
+		}
+
+		ReleaseReadyLines();
+
+		auto droppedCount = _queue.TakeDroppedCount();
+		if (droppedCount > 0) {
+			LogError("%llu hook-messages dropped, because writing the log could not keep up.", droppedCount);
+		}
+	}
+
+	while (_queue.TryDequeue(record)) {
+		TakeRecord(record);
+	}
+
+	LogLine logLine;
+	while (_reorderBuffer.Pop(logLine)) {
+		_handler(logLine);
+	}
+}
+
+void LogMessageConsumer::TakeRecord(const std::string& record)
+{
+	LogLine logLine;
+	if (_recordDecoder.Decode(record, logLine)) {
+		_reorderBuffer.Push(std::move(logLine));
+	}
+}
+
+/**
+ * @brief Writes the lines whose reorder-window is over.
+ */
+void LogMessageConsumer::ReleaseReadyLines()
+{
+	LogLine logLine;
+	auto now = LogRecordWriter::Now();
+	while (_reorderBuffer.PopReady(now, logLine)) {
+		_handler(logLine);
+	}
+
+	auto lateCount = _reorderBuffer.TakeLateCount();
+	if (lateCount > 0) {
+		LogInfo("%llu log-lines arrived after the reorder-window and are not in order.", lateCount);
+	}
+}
+
+/**
+ * @brief Remembers the highest depth and logs when it reaches the next threshold.
+ */
+void LogMessageConsumer::UpdateDepth()
+{
+	// +1 for the log-line that was just taken out.
+	auto depth = _queue.Size() + 1;
+	if (depth > _maxDepth) {
+		_maxDepth = depth;
+	}
+
+	if (depth >= _depthWarningThreshold) {
+		LogInfo("%zu hook-messages are waiting to be written. Writing the log is slower than receiving.", depth);
+		_depthWarningThreshold *= 2;
+	}
+}
@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The stage between the log-servers and the log-file.
+// The servers only put the received log-lines into the queue. A separate thread takes them out and writes them, so receiving never waits for the disk.
+// The consumer-thread also merges the lines of the hooked processes and of WhatsappTray in the order of their origin-timestamps. (See LogReorderBuffer.h)
+
+#pragma once
+
+#include "LogRecordDecoder.h"
+#include "LogReorderBuffer.h"
+#include "MessageQueue.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+class LogMessageConsumer
+{
+public:
+	/**
+	 * @param handler Called in the consumer-thread for every log-line, ordered by the timestamps. For example writes the line into the log-file.
+	 * @param reorderWindow How long the lines are held back to bring them in order.
+	 */
+	LogMessageConsumer(const std::function<void(const LogLine&)>& handler, std::chrono::nanoseconds reorderWindow = std::chrono::milliseconds(100), const MessageQueueConfig& queueConfig = DefaultQueueConfig());
+
+	void Start();
+	void Stop();
+
+	/**
+	 * @brief Hands the log-line over to the consumer-thread. Never waits. Can be called from any thread.
+	 */
+	void Push(const LogLine& logLine);
+
+	/**
+	 * @brief The count of log-lines that are received but not yet handled.
+	 */
+	size_t Depth() const { return _queue.Size(); }
+
+	/**
+	 * @brief The highest Depth() since Start(). When this gets high, writing the log is the bottleneck.
+	 */
+	size_t MaxDepth() const { return _maxDepth; }
+
+	static MessageQueueConfig DefaultQueueConfig();
+
+private:
+	std::function<void(const LogLine&)> _handler;
+	/* Contains the lines as Text-records. (See LogRecord.h) */
+	MessageQueue _queue;
+	/* Only used in the consumer-thread. */
+	LogRecordDecoder _recordDecoder;
+	LogReorderBuffer _reorderBuffer;
+	std::atomic<bool> _isRunning = false;
+	std::thread _consumerThread;
+	std::atomic<size_t> _maxDepth = 0;
+	/* Depth at which the next warning is logged. Doubled after each warning. */
+	size_t _depthWarningThreshold = 0;
+
+	void Consume();
+	void TakeRecord(const std::string& record);
+	void ReleaseReadyLines();
+	void UpdateDepth();
+};
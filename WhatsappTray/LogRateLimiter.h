@@ -0,0 +1,173 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Limits how many lines one call-site can log. Used by the log-macros of WhatsappTray and Hook.dll, which have one static LogRateLimiter per call-site.
+// TryAcquire() is a token-bucket: A call-site can log a burst of lines and after that only a few lines per second. It is checked before the line is formatted.
+// Collapse() replaces identical lines of a call-site with one line that tells how often it was repeated.
+// So a loop that logs the same line, or a flood of window-messages, costs little disk-space and I/O.
+// A limiter that knows its call-site is registered in a list, so the counts that are still pending when the call-site stops logging can be reported with TakePending().
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+struct LogRateLimit
+{
+	/* How many lines a call-site can log at once. */
+	uint32_t burst = 50;
+	/* How many lines per second a call-site can log after the burst. 0 disables the limit. */
+	uint32_t linesPerSecond = 20;
+	/* Identical lines are counted and reported after this time at the latest. 0 disables the collapsing. */
+	int64_t collapseIntervalNs = 10LL * 1000 * 1000 * 1000;
+};
+
+class LogRateLimiter
+{
+public:
+	LogRateLimiter() = default;
+	/**
+	 * @brief Registers the limiter, so ForEachRegistered() finds it. The strings have to live until the end of the process, like MODULE_NAME and __func__.
+	 *
+	 * @param level The log-level of the call-site. Only stored for the caller of TakePending().
+	 */
+	LogRateLimiter(const char* module, const char* function, int level) : _module(module), _function(function), _level(level)
+	{
+		_next = _first.load(std::memory_order_relaxed);
+		while (_first.compare_exchange_weak(_next, this, std::memory_order_release, std::memory_order_relaxed) == false) {
+		}
+	}
+	LogRateLimiter(const LogRateLimiter&) = delete;
+	LogRateLimiter& operator=(const LogRateLimiter&) = delete;
+
+	/**
+	 * @brief Calls handler(LogRateLimiter&) for every registered limiter. Limiters are never removed, because they are static.
+	 */
+	template<typename Handler>
+	static void ForEachRegistered(Handler handler)
+	{
+		for (LogRateLimiter* limiter = _first.load(std::memory_order_acquire); limiter != nullptr; limiter = limiter->_next) {
+			handler(*limiter);
+		}
+	}
+
+	const char* Module() const { return _module; }
+	const char* Function() const { return _function; }
+	int Level() const { return _level; }
+
+	/**
+	 * @brief Takes a token of the bucket.
+	 *
+	 * The bucket is stored as the time when it is full again, so one compare-exchange is enough.
+	 * @param now Nanoseconds of a monotonic clock.
+	 * @param suppressedCount The count of lines that were dropped before this one. Only set when true is returned.
+	 * @return False if the line has to be dropped.
+	 */
+	bool TryAcquire(int64_t now, const LogRateLimit& limit, uint32_t& suppressedCount)
+	{
+		suppressedCount = 0;
+		if (limit.linesPerSecond == 0) {
+			return true;
+		}
+
+		int64_t interval = 1000000000LL / limit.linesPerSecond;
+		int64_t tolerance = interval * (limit.burst > 0 ? limit.burst - 1 : 0);
+		int64_t fullTime = _fullTime.load(std::memory_order_relaxed);
+		for (;;) {
+			int64_t start = fullTime > now ? fullTime : now;
+			if (start - now > tolerance) {
+				_suppressedCount.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			if (_fullTime.compare_exchange_weak(fullTime, start + interval, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+
+		if (_suppressedCount.load(std::memory_order_relaxed) != 0) {
+			suppressedCount = _suppressedCount.exchange(0, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Checks if the text is the same as the last one of this call-site.
+	 *
+	 * @param repeatCount How often the last line was repeated without being written. When it is not 0, the caller has to report it.
+	 * @return False if the line must not be written, because it is a repetition.
+	 */
+	bool Collapse(const char* text, size_t length, int64_t now, const LogRateLimit& limit, uint32_t& repeatCount)
+	{
+		repeatCount = 0;
+		if (limit.collapseIntervalNs == 0) {
+			return true;
+		}
+
+		// FNV-1a
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < length; i++) {
+			hash = (hash ^ static_cast<uint8_t>(text[i])) * 1099511628211ull;
+		}
+
+		while (_lock.test_and_set(std::memory_order_acquire)) {
+		}
+
+		bool isNew = hash != _lastHash;
+		if (isNew) {
+			repeatCount = _repeatCount;
+			_lastHash = hash;
+			_repeatCount = 0;
+		} else {
+			if (_repeatCount == 0) {
+				_firstRepeatTime = now;
+			}
+			_repeatCount++;
+			// A line that repeats forever is still reported from time to time.
+			if (now - _firstRepeatTime >= limit.collapseIntervalNs) {
+				repeatCount = _repeatCount;
+				_repeatCount = 0;
+			}
+		}
+
+		_lock.clear(std::memory_order_release);
+		return isNew;
+	}
+
+	/**
+	 * @brief Takes the counts that were not reported yet, because the call-site did not log again.
+	 *
+	 * The last text stays stored, so the next identical line is still collapsed.
+	 * @return True if one of the counts is not 0.
+	 */
+	bool TakePending(uint32_t& suppressedCount, uint32_t& repeatCount)
+	{
+		suppressedCount = _suppressedCount.load(std::memory_order_relaxed) != 0 ? _suppressedCount.exchange(0, std::memory_order_relaxed) : 0;
+
+		while (_lock.test_and_set(std::memory_order_acquire)) {
+		}
+		repeatCount = _repeatCount;
+		_repeatCount = 0;
+		_lock.clear(std::memory_order_release);
+
+		return suppressedCount != 0 || repeatCount != 0;
+	}
+
+private:
+	/* The time when the bucket has all tokens again. */
+	std::atomic<int64_t> _fullTime = 0;
+	std::atomic<uint32_t> _suppressedCount = 0;
+
+	/* Protects the state of Collapse(). Is only held for a few instructions. */
+	std::atomic_flag _lock = ATOMIC_FLAG_INIT;
+	uint64_t _lastHash = 0;
+	uint32_t _repeatCount = 0;
+	int64_t _firstRepeatTime = 0;
+
+	const char* _module = nullptr;
+	const char* _function = nullptr;
+	int _level = 0;
+	LogRateLimiter* _next = nullptr;
+	static inline std::atomic<LogRateLimiter*> _first = nullptr;
+};
@@ -0,0 +1,248 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The records that the hook sends to WhatsappTray. Every frame contains one record.
+// The hook does not format its log-messages. Every LogString()-call-site is registered once with an id, that holds the format-string, module and function.
+// After that, only the id and the raw arguments are sent and WhatsappTray does the formatting. (See LogRecordDecoder.h)
+// Every record starts with [type uint8][producerId uint32][timestamp int64]. The timestamp is taken when the record is created, not when it is received.
+// NOTE: This file is used by Hook.dll and WhatsappTray. It must not depend on windows.h so it also builds on Linux.
+//       The values are written in host byte-order. All supported platforms are little-endian.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <type_traits>
+
+enum class LogRecordType : uint8_t
+{
+	/* [type][producerId][timestamp][level uint8][text] A message that was already formatted. */
+	Text = 1,
+	/* [type][producerId][timestamp][callSiteId][module\0][function\0][format\0] Sent once, before the first event of the call-site. */
+	CallSite = 2,
+	/* [type][producerId][timestamp][callSiteId][arguments] The arguments for the format-string of the call-site. */
+	Event = 3,
+};
+
+/* The level of the Text-records with which the hook reports dropped lines. It is the value of Loglevel::LOG_WARNING of WhatsappTray. */
+constexpr uint8_t logRecordWarningLevel = 4;
+
+enum class LogArgumentType : uint8_t
+{
+	Int32 = 1,
+	UInt32 = 2,
+	Int64 = 3,
+	UInt64 = 4,
+	Double = 5,
+	Pointer = 6,
+	/* [type][length uint32][bytes] */
+	String = 7,
+};
+
+/**
+ * @brief The static data of a log-call-site. One instance is created as static variable at every call-site.
+ */
+struct LogCallSite
+{
+	const char* module;
+	const char* function;
+	const char* format;
+	/* 0 until the call-site is registered. */
+	std::atomic<uint32_t> id;
+};
+
+/**
+ * @brief The clock of the timestamps in the records.
+ *
+ * On Windows steady_clock uses QueryPerformanceCounter(), which is the same in all processes. So the timestamps of the hook and WhatsappTray can be compared.
+ */
+using LogClock = std::chrono::steady_clock;
+
+/**
+ * @brief A log-line with the time and the process where it was created.
+ */
+struct LogLine
+{
+	/* Nanoseconds of LogClock. (See LogRecordWriter::Now()) */
+	int64_t timestamp = 0;
+	uint32_t producerId = 0;
+	/* The Loglevel of WhatsappTray. 0 when it is not known, like for the messages of the hook. */
+	uint8_t level = 0;
+	std::string text;
+};
+
+class LogRecordWriter
+{
+public:
+	/**
+	 * @brief The current time in nanoseconds of LogClock.
+	 */
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(LogClock::now().time_since_epoch()).count();
+	}
+
+	static void BeginText(std::string& record, uint32_t producerId, int64_t timestamp = Now(), uint8_t level = 0)
+	{
+		AppendValue(record, LogRecordType::Text);
+		AppendValue(record, producerId);
+		AppendValue(record, timestamp);
+		AppendValue(record, level);
+	}
+
+	static void BeginCallSite(std::string& record, uint32_t producerId, uint32_t callSiteId, const LogCallSite& callSite)
+	{
+		AppendValue(record, LogRecordType::CallSite);
+		AppendValue(record, producerId);
+		AppendValue(record, Now());
+		AppendValue(record, callSiteId);
+		record.append(callSite.module, strlen(callSite.module) + 1);
+		record.append(callSite.function, strlen(callSite.function) + 1);
+		record.append(callSite.format, strlen(callSite.format) + 1);
+	}
+
+	static void BeginEvent(std::string& record, uint32_t producerId, uint32_t callSiteId)
+	{
+		AppendValue(record, LogRecordType::Event);
+		AppendValue(record, producerId);
+		AppendValue(record, Now());
+		AppendValue(record, callSiteId);
+	}
+
+	static void AppendArguments(std::string& /*record*/) { }
+
+	template<typename T, typename ... Args>
+	static void AppendArguments(std::string& record, const T& value, const Args& ... args)
+	{
+		AppendArgument(record, value);
+		AppendArguments(record, args ...);
+	}
+
+	static void AppendArgument(std::string& record, const std::string& value)
+	{
+		AppendString(record, value.data(), value.size());
+	}
+
+	template<typename T>
+	static void AppendArgument(std::string& record, const T& value)
+	{
+		using ValueType = std::decay_t<T>;
+
+		if constexpr (std::is_array_v<T>) {
+			static_assert(std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>, "Unsupported type for a log-argument.");
+			AppendString(record, value, strlen(value));
+		} else if constexpr (std::is_pointer_v<ValueType> && std::is_same_v<std::remove_cv_t<std::remove_pointer_t<ValueType>>, char>) {
+			const char* text = value != nullptr ? value : "(null)";
+			AppendString(record, text, strlen(text));
+		} else if constexpr (std::is_pointer_v<ValueType>) {
+			// NOTE: value may also be a function. The copy turns it into a pointer.
+			ValueType pointer = value;
+			AppendValue(record, LogArgumentType::Pointer);
+			AppendValue(record, static_cast<uint64_t>((uintptr_t)pointer));
+		} else if constexpr (std::is_floating_point_v<ValueType>) {
+			AppendValue(record, LogArgumentType::Double);
+			AppendValue(record, static_cast<double>(value));
+		} else if constexpr (std::is_enum_v<ValueType>) {
+			AppendValue(record, LogArgumentType::Int64);
+			AppendValue(record, static_cast<int64_t>(value));
+		} else {
+			static_assert(std::is_integral_v<ValueType>, "Unsupported type for a log-argument.");
+
+			if constexpr (sizeof(ValueType) <= 4 && std::is_signed_v<ValueType>) {
+				AppendValue(record, LogArgumentType::Int32);
+				AppendValue(record, static_cast<int32_t>(value));
+			} else if constexpr (sizeof(ValueType) <= 4) {
+				AppendValue(record, LogArgumentType::UInt32);
+				AppendValue(record, static_cast<uint32_t>(value));
+			} else if constexpr (std::is_signed_v<ValueType>) {
+				AppendValue(record, LogArgumentType::Int64);
+				AppendValue(record, static_cast<int64_t>(value));
+			} else {
+				AppendValue(record, LogArgumentType::UInt64);
+				AppendValue(record, static_cast<uint64_t>(value));
+			}
+		}
+	}
+
+	template<typename T>
+	static void AppendValue(std::string& record, T value)
+	{
+		record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+private:
+	static void AppendString(std::string& record, const char* text, size_t size)
+	{
+		AppendValue(record, LogArgumentType::String);
+		AppendValue(record, static_cast<uint32_t>(size));
+		record.append(text, size);
+	}
+};
+
+/**
+ * @brief Reads the values of a record one after another. After a read past the end, IsValid() returns false and all further reads return 0.
+ */
+class LogRecordReader
+{
+public:
+	LogRecordReader(const char* data, size_t size) : _data(data), _size(size) { }
+
+	template<typename T>
+	T ReadValue()
+	{
+		T value{};
+		if (_size - _position < sizeof(T)) {
+			_isValid = false;
+			_position = _size;
+			return value;
+		}
+		memcpy(&value, _data + _position, sizeof(T));
+		_position += sizeof(T);
+		return value;
+	}
+
+	/**
+	 * @brief Reads a '\0'-terminated string.
+	 */
+	std::string ReadCString()
+	{
+		auto end = static_cast<const char*>(memchr(_data + _position, '\0', _size - _position));
+		if (end == nullptr) {
+			_isValid = false;
+			_position = _size;
+			return std::string();
+		}
+		std::string text(_data + _position, end);
+		_position += text.size() + 1;
+		return text;
+	}
+
+	/**
+	 * @brief Reads size bytes.
+	 */
+	std::string ReadBytes(size_t size)
+	{
+		if (_size - _position < size) {
+			_isValid = false;
+			_position = _size;
+			return std::string();
+		}
+		std::string bytes(_data + _position, size);
+		_position += size;
+		return bytes;
+	}
+
+	std::string ReadRemaining() { return ReadBytes(_size - _position); }
+
+	bool IsAtEnd() const { return _position >= _size; }
+	bool IsValid() const { return _isValid; }
+
+private:
+	const char* _data;
+	size_t _size;
+	size_t _position = 0;
+	bool _isValid = true;
+};
@@ -0,0 +1,211 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Turns the records from the hook back into text. (See LogRecord.h)
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include "LogFormat.h"
+#include "LogRecord.h"
+
+#include <map>
+#include <string>
+#include <utility>
+
+class LogRecordDecoder
+{
+public:
+	/**
+	 * @brief Decodes one record.
+	 *
+	 * @param line The log-line. Only set when true is returned.
+	 * @return True if the record contains a log-line. False for call-site-registrations and invalid records.
+	 */
+	bool Decode(const std::string& record, LogLine& line)
+	{
+		LogRecordReader reader(record.data(), record.size());
+		auto recordType = reader.ReadValue<LogRecordType>();
+		auto producerId = reader.ReadValue<uint32_t>();
+		line.timestamp = reader.ReadValue<int64_t>();
+		line.producerId = producerId;
+		line.level = 0;
+		std::string& text = line.text;
+
+		switch (recordType) {
+		case LogRecordType::Text: {
+			line.level = reader.ReadValue<uint8_t>();
+			text = reader.ReadRemaining();
+			return reader.IsValid();
+		}
+		case LogRecordType::CallSite: {
+			auto callSiteId = reader.ReadValue<uint32_t>();
+			CallSiteInfo callSite;
+			callSite.module = reader.ReadCString();
+			callSite.function = reader.ReadCString();
+			callSite.format = reader.ReadCString();
+			if (reader.IsValid()) {
+				_callSites[std::make_pair(producerId, callSiteId)] = callSite;
+			}
+			return false;
+		}
+		case LogRecordType::Event: {
+			auto callSiteId = reader.ReadValue<uint32_t>();
+			if (reader.IsValid() == false) {
+				return false;
+			}
+
+			auto callSite = _callSites.find(std::make_pair(producerId, callSiteId));
+			if (callSite == _callSites.end()) {
+				text = "<unknown call-site " + std::to_string(callSiteId) + " of producer " + std::to_string(producerId) + ">";
+				return true;
+			}
+
+			text = callSite->second.module + "::" + callSite->second.function + ": ";
+			FormatArguments(callSite->second.format, reader, text);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	/**
+	 * @brief Formats the printf-format-string with the arguments from the record.
+	 *
+	 * The length-modifiers in the format-string are ignored. The type of the argument in the record decides which type is passed to snprintf().
+	 * So a wrong format-string can not lead to reading garbage like it would with printf.
+	 */
+	static void FormatArguments(const std::string& format, LogRecordReader& reader, std::string& text)
+	{
+		size_t position = 0;
+		while (position < format.size()) {
+			auto specifierStart = format.find('%', position);
+			if (specifierStart == std::string::npos) {
+				text.append(format, position, std::string::npos);
+				break;
+			}
+			text.append(format, position, specifierStart - position);
+			position = specifierStart + 1;
+
+			if (position < format.size() && format[position] == '%') {
+				text.push_back('%');
+				position++;
+				continue;
+			}
+
+			// Flags, width and precision are kept. '*' is not supported, because the hook never uses it.
+			std::string specifier = "%";
+			while (position < format.size() && strchr("-+ #0123456789.", format[position]) != nullptr) {
+				specifier.push_back(format[position++]);
+			}
+			// Length-modifiers are dropped. (Also the MSVC-specific I64, I32 and I)
+			while (position < format.size() && strchr("hlLqjztI0123456789", format[position]) != nullptr) {
+				position++;
+			}
+
+			if (position >= format.size() || strchr("diouxXeEfFgGaAcsp", format[position]) == nullptr) {
+				// Not a valid specifier => take it over as it is.
+				text.append(format, specifierStart, position - specifierStart);
+				continue;
+			}
+
+			char conversion = format[position++];
+			if (reader.IsAtEnd()) {
+				text.append("<missing argument>");
+				continue;
+			}
+			AppendArgument(reader, specifier, conversion, text);
+		}
+	}
+
+private:
+	struct CallSiteInfo
+	{
+		std::string module;
+		std::string function;
+		std::string format;
+	};
+
+	/* The call-sites of all producers. Key is (producerId, callSiteId) */
+	std::map<std::pair<uint32_t, uint32_t>, CallSiteInfo> _callSites;
+
+	static void AppendArgument(LogRecordReader& reader, std::string specifier, char conversion, std::string& text)
+	{
+		bool isIntegerConversion = strchr("diouxX", conversion) != nullptr;
+		bool isFloatConversion = strchr("eEfFgGaA", conversion) != nullptr;
+
+		switch (reader.ReadValue<LogArgumentType>()) {
+		case LogArgumentType::Int32: {
+			auto value = reader.ReadValue<int32_t>();
+			if (isIntegerConversion || conversion == 'c') {
+				AppendFormatted(text, specifier + conversion, value);
+			} else if (isFloatConversion) {
+				AppendFormatted(text, specifier + conversion, static_cast<double>(value));
+			} else {
+				AppendFormatted(text, specifier + "d", value);
+			}
+		} break;
+		case LogArgumentType::UInt32: {
+			auto value = reader.ReadValue<uint32_t>();
+			if (isIntegerConversion || conversion == 'c') {
+				AppendFormatted(text, specifier + conversion, value);
+			} else if (isFloatConversion) {
+				AppendFormatted(text, specifier + conversion, static_cast<double>(value));
+			} else {
+				AppendFormatted(text, specifier + "u", value);
+			}
+		} break;
+		case LogArgumentType::Int64: {
+			auto value = static_cast<long long>(reader.ReadValue<int64_t>());
+			if (isIntegerConversion) {
+				AppendFormatted(text, specifier + "ll" + conversion, value);
+			} else if (isFloatConversion) {
+				AppendFormatted(text, specifier + conversion, static_cast<double>(value));
+			} else {
+				AppendFormatted(text, specifier + "lld", value);
+			}
+		} break;
+		case LogArgumentType::UInt64:
+		case LogArgumentType::Pointer: {
+			auto value = static_cast<unsigned long long>(reader.ReadValue<uint64_t>());
+			if (isIntegerConversion) {
+				AppendFormatted(text, specifier + "ll" + conversion, value);
+			} else if (isFloatConversion) {
+				AppendFormatted(text, specifier + conversion, static_cast<double>(value));
+			} else {
+				AppendFormatted(text, specifier + "llX", value);
+			}
+		} break;
+		case LogArgumentType::Double: {
+			auto value = reader.ReadValue<double>();
+			if (isFloatConversion) {
+				AppendFormatted(text, specifier + conversion, value);
+			} else {
+				AppendFormatted(text, specifier + "g", value);
+			}
+		} break;
+		case LogArgumentType::String: {
+			auto size = reader.ReadValue<uint32_t>();
+			auto value = reader.ReadBytes(size);
+			if (conversion == 's' && specifier.size() > 1) {
+				// Keep width and precision.
+				AppendFormatted(text, specifier + "s", value.c_str());
+			} else {
+				text.append(value);
+			}
+		} break;
+		default:
+			text.append("<invalid argument>");
+			// The type is unknown so the rest of the arguments can not be read anymore.
+			reader.ReadRemaining();
+			break;
+		}
+	}
+
+	template<typename T>
+	static void AppendFormatted(std::string& text, const std::string& specifier, T value)
+	{
+		AppendFormat(text, specifier.c_str(), value);
+	}
+};
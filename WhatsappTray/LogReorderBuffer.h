@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Brings the log-lines of WhatsappTray and of the hooked processes into the order in which they were created.
+// The lines of the hook arrive late, because of batching and the transport. So every line is held back for the reorder-window and the lines are released ordered by their origin-timestamp.
+// A line that arrives later than the window can not be put in order anymore. It is released immediately and counted.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include "LogRecord.h"
+
+#include <stdint.h>
+#include <chrono>
+#include <limits>
+#include <queue>
+#include <vector>
+
+class LogReorderBuffer
+{
+public:
+	/**
+	 * @param window How long a line is held back. Should be longer than the usual delay of the hook-messages.
+	 * @param maxLines When more lines are held back, the oldest are released before the window is over. Limits the memory.
+	 */
+	LogReorderBuffer(std::chrono::nanoseconds window = std::chrono::milliseconds(100), size_t maxLines = 16 * 1024)
+		: _window(window.count()), _maxLines(maxLines)
+	{
+	}
+
+	void Push(LogLine&& line)
+	{
+		int64_t orderTime = line.timestamp;
+		if (orderTime < _releasedUntil) {
+			_lateCount++;
+			// Sort it behind the lines that were already released. The line keeps its real timestamp.
+			orderTime = _releasedUntil;
+		}
+		_lines.push(Entry{ std::move(line), orderTime, _nextSequence++ });
+	}
+
+	/**
+	 * @brief Takes the oldest line, if its reorder-window is over.
+	 *
+	 * @param now The current time in nanoseconds of LogClock.
+	 * @return False if no line is ready.
+	 */
+	bool PopReady(int64_t now, LogLine& line)
+	{
+		if (_lines.empty() || (_lines.top().orderTime > now - _window && _lines.size() <= _maxLines)) {
+			return false;
+		}
+		return Pop(line);
+	}
+
+	/**
+	 * @brief Takes the oldest line without waiting for the window. Used to write out everything at the end.
+	 */
+	bool Pop(LogLine& line)
+	{
+		if (_lines.empty()) {
+			return false;
+		}
+
+		// top() is const, but the entry is removed right after. So moving the line out is safe.
+		auto& entry = const_cast<Entry&>(_lines.top());
+		if (entry.orderTime > _releasedUntil) {
+			_releasedUntil = entry.orderTime;
+		}
+		line = std::move(entry.line);
+		_lines.pop();
+		return true;
+	}
+
+	/**
+	 * @brief The time in nanoseconds of LogClock when the next line is ready.
+	 */
+	int64_t NextReleaseTime() const
+	{
+		return _lines.empty() ? (std::numeric_limits<int64_t>::max)() : _lines.top().orderTime + _window;
+	}
+
+	bool IsEmpty() const { return _lines.empty(); }
+
+	/**
+	 * @brief Returns the count of lines that arrived after the window since the last call and resets it.
+	 */
+	uint64_t TakeLateCount()
+	{
+		auto lateCount = _lateCount;
+		_lateCount = 0;
+		return lateCount;
+	}
+
+private:
+	struct Entry
+	{
+		LogLine line;
+		/* The timestamp of the line, or later if the line arrived after the window. */
+		int64_t orderTime;
+		/* Keeps the order of arrival for lines with the same timestamp. */
+		uint64_t sequence;
+	};
+
+	struct IsLater
+	{
+		bool operator()(const Entry& a, const Entry& b) const
+		{
+			return a.orderTime != b.orderTime ? a.orderTime > b.orderTime : a.sequence > b.sequence;
+		}
+	};
+
+	int64_t _window;
+	size_t _maxLines;
+	std::priority_queue<Entry, std::vector<Entry>, IsLater> _lines;
+	uint64_t _nextSequence = 0;
+	/* The timestamp of the newest line that was released. */
+	int64_t _releasedUntil = (std::numeric_limits<int64_t>::min)();
+	uint64_t _lateCount = 0;
+};
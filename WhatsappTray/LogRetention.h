@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Decides which log-files are deleted, so the log-folder does not grow forever. (See LogMaintenance.h)
+// The oldest files are deleted first until all files together fit into the budget. Files that are older than the maximum age are always deleted.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct LogRotationConfig
+{
+	/* A segment is sealed and a new one is started after this time, also when it is not full. */
+	std::chrono::minutes maxSegmentAge = std::chrono::hours(24);
+	/* The size on the disk of all log-files together. */
+	uint64_t retentionBytes = 200 * 1024 * 1024;
+	/* Older log-files are deleted. */
+	std::chrono::hours retentionAge = std::chrono::hours(30 * 24);
+};
+
+struct LogFileInfo
+{
+	std::string path;
+	/* The size on the disk. For a compressed file the compressed size. */
+	uint64_t size;
+	std::chrono::system_clock::time_point lastWriteTime;
+	/* The file the logger currently writes into. It is never deleted or compressed. */
+	bool isActive;
+	bool isCompressed;
+};
+
+/**
+ * @brief Returns the indices of the files that have to be deleted.
+ *
+ * @param files Sorted from the oldest to the newest.
+ */
+inline std::vector<size_t> SelectLogFilesToDelete(const std::vector<LogFileInfo>& files, const LogRotationConfig& config, std::chrono::system_clock::time_point now)
+{
+	uint64_t totalSize = 0;
+	for (const auto& file : files) {
+		totalSize += file.size;
+	}
+
+	std::vector<size_t> filesToDelete;
+	for (size_t i = 0; i < files.size(); i++) {
+		const auto& file = files[i];
+		if (file.isActive) {
+			continue;
+		}
+
+		bool isTooOld = now - file.lastWriteTime > config.retentionAge;
+		if (totalSize <= config.retentionBytes && isTooOld == false) {
+			continue;
+		}
+		filesToDelete.push_back(i);
+		totalSize -= file.size;
+	}
+	return filesToDelete;
+}
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// A preallocated piece of the log-file, that is mapped into memory. (See MappedLogFile.h)
+// Appending a line only reserves space by moving the tail with an atomic add and copies the line. There is no system-call and no flush.
+// The memory belongs to the page-cache of the OS, so the lines are kept when WhatsappTray crashes.
+// When a line does not fit anymore, the segment is full and the logger continues in a new one.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+constexpr size_t defaultLogSegmentSize = 4 * 1024 * 1024;
+
+class LogSegment
+{
+public:
+	LogSegment() = default;
+	LogSegment(char* memory, size_t capacity)
+		: _memory(memory), _capacity(capacity)
+	{
+	}
+
+	/**
+	 * @brief Copies the text into the segment.
+	 *
+	 * Can be called from multiple threads at the same time.
+	 * @return False if the segment is full. Then nothing is written.
+	 */
+	bool TryAppend(const char* text, size_t length)
+	{
+		size_t offset = _tail.fetch_add(length, std::memory_order_relaxed);
+		if (offset + length > _capacity) {
+			// All later reservations start behind this one, so the first failed offset is where the data ends.
+			size_t firstFailedOffset = _firstFailedOffset.load(std::memory_order_relaxed);
+			while (offset < firstFailedOffset && _firstFailedOffset.compare_exchange_weak(firstFailedOffset, offset, std::memory_order_relaxed) == false) {
+			}
+			return false;
+		}
+
+		memcpy(_memory + offset, text, length);
+		return true;
+	}
+
+	/**
+	 * @brief The count of bytes that were written.
+	 *
+	 * NOTE: Only exact when no TryAppend() is running at the same time.
+	 */
+	size_t UsedSize() const
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		size_t firstFailedOffset = _firstFailedOffset.load(std::memory_order_relaxed);
+		return tail < firstFailedOffset ? tail : firstFailedOffset;
+	}
+
+	size_t Capacity() const { return _capacity; }
+
+private:
+	char* _memory = nullptr;
+	size_t _capacity = 0;
+	std::atomic<size_t> _tail = 0;
+	std::atomic<size_t> _firstFailedOffset = SIZE_MAX;
+};
@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The interface for the ways WhatsappTray can receive the log-messages of the hook.
+// All transports carry the same byte-stream of frames (See MessageFraming.h) with one record per frame (See LogRecord.h).
+// Implementations: WinSockServer, NamedPipeServer, SharedMemoryServer
+
+#pragma once
+
+#include "LogRecordDecoder.h"
+
+#include <functional>
+#include <string>
+
+class LogServer
+{
+public:
+	virtual ~LogServer() = default;
+
+	/**
+	 * @brief Receives the log-messages until Stop() is called. Should run in its own thread.
+	 *
+	 * @return False if the server could not be started.
+	 */
+	virtual bool Run() = 0;
+
+	/**
+	 * @brief Lets Run() return. Can be called from any thread.
+	 */
+	virtual void Stop() = 0;
+
+	void NotifyOnNewMessage(const std::function<void(const LogLine&)>& messageReceivedEvent) { _messageReceivedEvent = messageReceivedEvent; }
+
+protected:
+	/**
+	 * @brief Turns the record into a log-line and forwards it. Only called from the thread of the server.
+	 */
+	void ForwardRecord(const std::string& record)
+	{
+		if (_messageReceivedEvent && _recordDecoder.Decode(record, _logLine)) {
+			_messageReceivedEvent(_logLine);
+		}
+	}
+
+	/**
+	 * @brief Forwards a line that WhatsappTray created itself, for example about lost messages. It gets the current time.
+	 */
+	void ForwardLine(const std::string& text, uint32_t producerId)
+	{
+		if (_messageReceivedEvent) {
+			_logLine.timestamp = LogRecordWriter::Now();
+			_logLine.producerId = producerId;
+			_logLine.text = text;
+			_messageReceivedEvent(_logLine);
+		}
+	}
+
+private:
+	std::function<void(const LogLine&)> _messageReceivedEvent = NULL;
+	/* Every server has its own decoder, because the hook registers its call-sites on the transport it uses. */
+	LogRecordDecoder _recordDecoder;
+	LogLine _logLine;
+};
@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Creates the timestamp in front of every log-line, for example "13:37:42.123".
+// The part up to the seconds only changes once per second, so it is formatted once and cached. For every line only the milliseconds are patched in.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+
+class LogTimestampFormatter
+{
+public:
+	/**
+	 * @param formatString The format for strftime() up to the seconds. The milliseconds are appended after a '.'.
+	 */
+	LogTimestampFormatter(const char* formatString = "%H:%M:%S")
+		: _formatString(formatString)
+	{
+	}
+
+	/**
+	 * @brief Appends the timestamp to text.
+	 *
+	 * NOTE: Not thread-safe. Use one formatter per thread.
+	 */
+	void AppendTo(std::string& text, std::chrono::system_clock::time_point time)
+	{
+		using namespace std::chrono;
+
+		auto milliseconds = duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+		// Round towards negative infinity, so times before 1970 also get the right second.
+		int64_t second = milliseconds / 1000 - (milliseconds % 1000 < 0 ? 1 : 0);
+		uint32_t millisecond = static_cast<uint32_t>(milliseconds - second * 1000);
+
+		if (second != _cachedSecond) {
+			FormatSecond(second);
+		}
+
+		_prefix[_prefixLength + 1] = static_cast<char>('0' + millisecond / 100);
+		_prefix[_prefixLength + 2] = static_cast<char>('0' + millisecond / 10 % 10);
+		_prefix[_prefixLength + 3] = static_cast<char>('0' + millisecond % 10);
+		text.append(_prefix, _prefixLength + 4);
+	}
+
+private:
+	const char* _formatString;
+	int64_t _cachedSecond = INT64_MIN;
+	/* The formatted second, followed by ".mmm". */
+	char _prefix[64] = {};
+	size_t _prefixLength = 0;
+
+	void FormatSecond(int64_t second)
+	{
+		time_t timer = static_cast<time_t>(second);
+		struct tm localTime;
+#ifdef _WIN32
+		localtime_s(&localTime, &timer);
+#else
+		localtime_r(&timer, &localTime);
+#endif
+
+		// Leave room for ".mmm".
+		_prefixLength = strftime(_prefix, sizeof(_prefix) - 4, _formatString, &localTime);
+		_prefix[_prefixLength] = '.';
+		_cachedSecond = second;
+	}
+};
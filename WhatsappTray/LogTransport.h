@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The interface for the ways the hook can send its log-messages to WhatsappTray.
+// All transports carry the same byte-stream of frames (See MessageFraming.h), so WhatsappTray handles them all the same way.
+// Implementations: TcpClient, NamedPipeClient, SharedMemoryClient
+
+#pragma once
+
+#include <stddef.h>
+#include <chrono>
+
+class LogTransport
+{
+public:
+	virtual ~LogTransport() = default;
+
+	/**
+	 * @brief Prepares the transport. Called once from the message-processing thread before anything is sent.
+	 *
+	 * @return False if the transport can not be used, for example because WhatsappTray does not provide it. Then the next transport is tried.
+	 */
+	virtual bool Open() = 0;
+
+	/**
+	 * @brief Establishes the connection to WhatsappTray, if there is none.
+	 *
+	 * @return True if there is a connection afterwards.
+	 */
+	virtual bool Connect() = 0;
+
+	/**
+	 * @brief False if there is no connection or the server already closed it, for example because WhatsappTray was restarted.
+	 *
+	 * Checked before every batch, so a batch is not sent into a connection that is already closed.
+	 */
+	virtual bool IsConnected() const = 0;
+
+	/**
+	 * @brief Limits how long one Connect() or Send() may block. Also when a Send() needs multiple writes, they take this long together.
+	 *
+	 * So a WhatsappTray that does not read anymore can not block the hook, especially not while WhatsApp exits.
+	 */
+	virtual void SetTimeout(std::chrono::milliseconds timeout) = 0;
+
+	/**
+	 * @brief Sends a batch of frames over the connection. Either all frames are sent or it is reported as failure.
+	 *
+	 * When sending fails, the connection is closed, so the next Connect() establishes a new one.
+	 */
+	virtual bool Send(const char data[], size_t size) = 0;
+
+	virtual void Close() = 0;
+
+	/**
+	 * @brief The name of the transport for log-messages.
+	 */
+	virtual const char* Name() const = 0;
+};
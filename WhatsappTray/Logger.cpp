@@ -5,15 +5,125 @@
 #include "Logger.h"
 
 #include "Helper.h"
+#include "LogTimestampFormatter.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <chrono>
-
+#include <exception>
+
+SegmentedLog<MappedLogFile> Logger::logSegments(Logger::OpenLogSegment);
+std::string Logger::logSegmentBasePath;
+size_t Logger::logSegmentSize = defaultLogSegmentSize;
+int Logger::logSegmentCount = 0;
+std::mutex Logger::activeLogFilePathMutex;
+std::string Logger::activeLogFilePath;
+LogFileWriterConfig Logger::fileWriterConfig;
+bool Logger::binaryJournal = false;
+LogFlightRecorder Logger::flightRecorder;
+Loglevel Logger::loglevelToRecord = Loglevel::LOG_NONE;
+LogRateLimit Logger::rateLimit;
 std::ofstream Logger::logFile;
-Loglevel Logger::loglevelToLog = Loglevel::LOG_ERROR;
+LogFileWriter Logger::fileWriter;
+LogMaintenance Logger::logMaintenance;
+Loglevel Logger::loglevelToLog = Loglevel::LOG_INFO;
 bool Logger::isSetupDone = false;
+std::atomic<void(*)(const ::LogLine&)> Logger::lineSink = nullptr;
+
+namespace
+{
+
+/* Everything that the dump after a crash needs is created in PrepareCrashDump().
+ * The heap of a crashed process may be corrupt or its lock may be held by the crashed thread, so the dump must not allocate or lock. */
+char crashDumpPath[MAX_PATH] = {};
+size_t crashDumpPathPrefixLength = 0;
+char crashDumpBuffer[64 * 1024];
+/* Only the first crashing thread writes the dump. */
+std::atomic_flag isCrashDumpStarted = ATOMIC_FLAG_INIT;
+
+/**
+ * @brief Collects the text of the dump after a crash in crashDumpBuffer and writes it into the file when the buffer is full.
+ */
+class CrashDumpWriter
+{
+public:
+	explicit CrashDumpWriter(HANDLE file) : _file(file) { }
+	~CrashDumpWriter() { Flush(); }
+
+	void Append(const char* text, size_t length)
+	{
+		while (length > 0) {
+			if (_size == sizeof(crashDumpBuffer)) {
+				Flush();
+			}
+			size_t part = (std::min)(length, sizeof(crashDumpBuffer) - _size);
+			memcpy(crashDumpBuffer + _size, text, part);
+			_size += part;
+			text += part;
+			length -= part;
+		}
+	}
+
+	void Append(const char* text) { Append(text, strlen(text)); }
+
+	void AppendNumber(uint64_t value, uint32_t base = 10, int minDigits = 1)
+	{
+		char digits[24];
+		int count = 0;
+		do {
+			digits[count++] = "0123456789ABCDEF"[value % base];
+			value /= base;
+		} while (value > 0 || count < minDigits);
+		while (count > 0) {
+			Append(&digits[--count], 1);
+		}
+	}
+
+	/**
+	 * @brief "HH:MM:SS.mmm" in local time.
+	 */
+	void AppendTime(const FILETIME& utcTime)
+	{
+		FILETIME localFileTime;
+		SYSTEMTIME localTime;
+		if (FileTimeToLocalFileTime(&utcTime, &localFileTime) == FALSE || FileTimeToSystemTime(&localFileTime, &localTime) == FALSE) {
+			Append("??:??:??.???");
+			return;
+		}
+		AppendNumber(localTime.wHour, 10, 2);
+		Append(":");
+		AppendNumber(localTime.wMinute, 10, 2);
+		Append(":");
+		AppendNumber(localTime.wSecond, 10, 2);
+		Append(".");
+		AppendNumber(localTime.wMilliseconds, 10, 3);
+	}
+
+	void Flush()
+	{
+		if (_size > 0) {
+			DWORD written = 0;
+			WriteFile(_file, crashDumpBuffer, static_cast<DWORD>(_size), &written, NULL);
+			_size = 0;
+		}
+	}
+
+private:
+	HANDLE _file;
+	size_t _size = 0;
+};
+
+/**
+ * @brief The notices about dropped and repeated lines are written at least as warning, so they are not hidden when only warnings are written.
+ */
+Loglevel NoticeLevel(Loglevel loglevel)
+{
+	return (std::min)(loglevel, Loglevel::LOG_WARNING);
+}
+
+}
 
 Logger::Logger()
 {
@@ -26,7 +136,7 @@ Logger::~Logger()
 /**
  * Setup the logging.
  */
-void Logger::Setup()
+void Logger::Setup(const LoggerConfig& config)
 {
 	if (isSetupDone == true) {
 		OutputDebugStringA("ERROR: The setup for the logger was already done.\n");
@@ -41,7 +151,7 @@ void Logger::Setup()
 	auto timeString = Logger::GetTimeString("%Y-%m-%d_%H#%M#%S");
 
 	std::string logPath = Helper::GetApplicationDirectory() + "log\\";
-	std::string logFileName = std::string("Log_") + timeString + std::string(".txt");
+	std::string logFileName = std::string("Log_") + timeString;
 
 	// Create log-folder
 	if (CreateDirectory(logPath.c_str(), NULL) == false && ERROR_ALREADY_EXISTS != GetLastError()) {
@@ -49,18 +159,280 @@ void Logger::Setup()
 		return;
 	}
 
-	OutputDebugStringA((std::string("Log to ") + logPath + logFileName + "\n").c_str());
+	logSegmentBasePath = logPath + logFileName;
+	logSegmentSize = config.segmentSize;
+	logSegmentCount = 0;
+	fileWriterConfig = config.writerConfig;
+	binaryJournal = config.binaryJournal;
+	flightRecorder.Setup(config.flightRecorderSlots);
+	rateLimit = config.rateLimit;
+	loglevelToRecord = flightRecorder.IsEnabled() ? Loglevel::LOG_DEBUG : Loglevel::LOG_NONE;
+
+	OutputDebugStringA((std::string("Log to ") + NextLogFilePath() + "\n").c_str());
+
+	// Continues with the fallback-file, if the segment can not be created.
+	logSegments.Open();
+	logMaintenance.Start(logPath, config.rotationConfig);
+
+	isSetupDone = true;
+
+	if (flightRecorder.IsEnabled()) {
+		PrepareCrashDump();
+		SetUnhandledExceptionFilter(UnhandledExceptionFilter);
+		std::set_terminate(TerminateHandler);
+	}
+}
+
+/**
+ * @brief Creates the start of the path for DumpFlightRecorderAfterCrash(), while the process can still allocate.
+ */
+void Logger::PrepareCrashDump()
+{
+	std::string pathPrefix = logSegmentBasePath + "_FlightRecorder_Crash_";
+	// Leave room for "HH#MM#SS.txt".
+	if (pathPrefix.size() + 13 > sizeof(crashDumpPath)) {
+		OutputDebugStringA("ERROR: The path of the log is too long for the flight-recorder-dump after a crash.\n");
+		crashDumpPathPrefixLength = 0;
+		return;
+	}
+	memcpy(crashDumpPath, pathPrefix.c_str(), pathPrefix.size() + 1);
+	crashDumpPathPrefixLength = pathPrefix.size();
+}
+
+std::string Logger::NextLogFilePath()
+{
+	const char* extension = binaryJournal ? logJournalExtension : ".txt";
+	if (logSegmentCount == 0) {
+		return logSegmentBasePath + extension;
+	}
+	return logSegmentBasePath + "_" + std::to_string(logSegmentCount) + extension;
+}
+
+/**
+ * @brief The start of every journal-file. It allows the decoder to turn the timestamps of the records into the time of day.
+ */
+std::string Logger::CreateJournalFileHeader()
+{
+	auto unixTime = std::chrono::system_clock::now().time_since_epoch();
+	std::string header;
+	LogJournalWriter::AppendFileHeader(header, LogRecordWriter::Now(), std::chrono::duration_cast<std::chrono::nanoseconds>(unixTime).count());
+	return header;
+}
+
+/**
+ * @brief Opens the next file of logSegments. When that fails, the logger continues with the fallback-file.
+ *
+ * NOTE: Only called by logSegments, which holds its exclusive lock meanwhile.
+ * @param minimumSize The new segment gets at least this size, so also a very long line fits.
+ */
+bool Logger::OpenLogSegment(MappedLogFile& file, size_t minimumSize)
+{
+	// Open() closes and seals the full segment first.
+	auto path = NextLogFilePath();
+	std::string journalHeader = binaryJournal ? CreateJournalFileHeader() : std::string();
+	if (file.Open(path, (std::max)(logSegmentSize, minimumSize + journalHeader.size())) == false) {
+		OutputDebugStringA("ERROR: The log-segment could not be created. Continue without memory-mapping.\n");
+		OpenFallbackLogFile();
+		return false;
+	}
+	if (binaryJournal) {
+		file.TryAppend(journalHeader.data(), journalHeader.size());
+	}
+	logSegmentCount++;
+	{
+		std::lock_guard<std::mutex> lock(activeLogFilePathMutex);
+		activeLogFilePath = path;
+	}
+
+	// Compress the sealed segment.
+	if (logSegmentCount > 1) {
+		logMaintenance.WakeUp();
+	}
+	return true;
+}
 
-	logFile.open((logPath + logFileName).c_str(), std::ofstream::out);
+/**
+ * @brief Continues with a normal file, when no segment can be mapped.
+ *
+ * NOTE: Only called by OpenLogSegment(), so no line is appended meanwhile.
+ */
+void Logger::OpenFallbackLogFile()
+{
+	std::string path = NextLogFilePath();
+	{
+		std::lock_guard<std::mutex> lock(activeLogFilePathMutex);
+		activeLogFilePath = path;
+	}
+	// Binary like the mapped segments, so the lines end with "\n" in both and not with "\r\n" only in this one.
+	logFile.open(path.c_str(), std::ofstream::out | std::ofstream::binary);
 	if ((logFile.rdstate() & std::ofstream::failbit) != 0) {
 		OutputDebugStringA("ERROR: Logfile could not be created!\n");
 	}
+	logSegmentCount++;
+	fileWriter.Start(logFile, fileWriterConfig);
+	if (binaryJournal) {
+		fileWriter.Append(CreateJournalFileHeader());
+	}
+}
 
-	isSetupDone = true;
+void Logger::AppendToLogFile(const std::string& text)
+{
+	// Without a segment, the fallback-file is used.
+	if (logSegments.Append(text.data(), text.size()) == false) {
+		fileWriter.Append(text);
+	}
+}
+
+std::string Logger::ActiveLogFilePath()
+{
+	std::lock_guard<std::mutex> lock(activeLogFilePathMutex);
+	return activeLogFilePath;
+}
+
+void Logger::RotateLogSegmentIfOlderThan(std::chrono::minutes maxAge)
+{
+	logSegments.RotateIfOlderThan(maxAge);
+}
+
+std::string Logger::DumpFlightRecorder(const char* reason)
+{
+	if (isSetupDone == false || flightRecorder.IsEnabled() == false) {
+		return std::string();
+	}
+
+	// Like in the journal, the timestamps of the clock are turned into the time of day with one pair of now-values.
+	auto clockNow = LogClock::now();
+	auto systemNow = std::chrono::system_clock::now();
+
+	std::string dump;
+	AppendFormat(dump, "Flight-recorder of process %lu: %s\n", GetCurrentProcessId(), reason);
+	// The lines of the hook have no level of WhatsappTray. (See Logger::RecordLine())
+	const char* const levelNames[] = { "HOOK", "APP", "FATAL", "ERROR", "WARNING", "INFO", "DEBUG" };
+	LogTimestampFormatter timestampFormatter("%H:%M:%S");
+	flightRecorder.Visit([&](const LogFlightRecorder::Entry& entry) {
+		auto age = clockNow - LogClock::time_point(std::chrono::nanoseconds(entry.timestamp));
+		timestampFormatter.AppendTo(dump, systemNow - std::chrono::duration_cast<std::chrono::system_clock::duration>(age));
+		AppendFormat(dump, " %-7s - ", entry.level < sizeof(levelNames) / sizeof(levelNames[0]) ? levelNames[entry.level] : "?");
+		dump.append(entry.text, entry.length);
+		if (entry.length == 0 || entry.text[entry.length - 1] != '\n') {
+			dump.push_back('\n');
+		}
+	});
+
+	// The name starts with the one of the session, so the log-maintenance also deletes it.
+	std::string path = logSegmentBasePath + "_FlightRecorder_" + GetTimeString("%H#%M#%S") + ".txt";
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		OutputDebugStringA("ERROR: The flight-recorder could not be written.\n");
+		return std::string();
+	}
+	DWORD written = 0;
+	WriteFile(file, dump.data(), static_cast<DWORD>(dump.size()), &written, NULL);
+	FlushFileBuffers(file);
+	CloseHandle(file);
+	return path;
+}
+
+/**
+ * @brief Writes the lines of the flight-recorder into "<session>_FlightRecorder_Crash_<time>.txt" after a crash.
+ *
+ * Only uses the memory that was prepared in PrepareCrashDump() and takes no lock, so it also works when the crashed thread held the lock of the heap or the log.
+ * @param exceptionRecord Written into the first line, if not NULL.
+ */
+void Logger::DumpFlightRecorderAfterCrash(const char* reason, const EXCEPTION_RECORD* exceptionRecord)
+{
+	if (flightRecorder.IsEnabled() == false || crashDumpPathPrefixLength == 0 || isCrashDumpStarted.test_and_set()) {
+		return;
+	}
+
+	// Like in DumpFlightRecorder(), the timestamps of the clock are turned into the time of day with one pair of now-values.
+	int64_t clockNow = LogRecordWriter::Now();
+	FILETIME systemNow;
+	GetSystemTimeAsFileTime(&systemNow);
+	ULARGE_INTEGER systemNowValue;
+	systemNowValue.LowPart = systemNow.dwLowDateTime;
+	systemNowValue.HighPart = systemNow.dwHighDateTime;
+
+	SYSTEMTIME localNow;
+	GetLocalTime(&localNow);
+	char* pathEnd = crashDumpPath + crashDumpPathPrefixLength;
+	const WORD timeParts[] = { localNow.wHour, localNow.wMinute, localNow.wSecond };
+	for (int i = 0; i < 3; i++) {
+		*pathEnd++ = static_cast<char>('0' + timeParts[i] / 10);
+		*pathEnd++ = static_cast<char>('0' + timeParts[i] % 10);
+		*pathEnd++ = i < 2 ? '#' : '.';
+	}
+	memcpy(pathEnd, "txt", 4);
+
+	HANDLE file = CreateFileA(crashDumpPath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		OutputDebugStringA("ERROR: The flight-recorder could not be written after the crash.\n");
+		return;
+	}
+
+	{
+		CrashDumpWriter writer(file);
+		writer.Append("Flight-recorder of process ");
+		writer.AppendNumber(GetCurrentProcessId());
+		writer.Append(": ");
+		writer.Append(reason);
+		if (exceptionRecord != NULL) {
+			writer.Append(" 0x");
+			writer.AppendNumber(exceptionRecord->ExceptionCode, 16, 8);
+			writer.Append(" at 0x");
+			writer.AppendNumber(reinterpret_cast<uintptr_t>(exceptionRecord->ExceptionAddress), 16);
+		}
+		writer.Append("\n");
+
+		const char* const levelNames[] = { "HOOK   ", "APP    ", "FATAL  ", "ERROR  ", "WARNING", "INFO   ", "DEBUG  " };
+		flightRecorder.Visit([&](const LogFlightRecorder::Entry& entry) {
+			// FILETIME counts in 100ns.
+			ULARGE_INTEGER entryTime;
+			entryTime.QuadPart = systemNowValue.QuadPart - static_cast<uint64_t>((std::max)(clockNow - entry.timestamp, int64_t(0)) / 100);
+			FILETIME entryFileTime;
+			entryFileTime.dwLowDateTime = entryTime.LowPart;
+			entryFileTime.dwHighDateTime = entryTime.HighPart;
+			writer.AppendTime(entryFileTime);
+			writer.Append(" ");
+			writer.Append(entry.level < sizeof(levelNames) / sizeof(levelNames[0]) ? levelNames[entry.level] : "?      ");
+			writer.Append(" - ");
+			writer.Append(entry.text, entry.length);
+			if (entry.length == 0 || entry.text[entry.length - 1] != '\n') {
+				writer.Append("\n");
+			}
+		});
+	}
+	FlushFileBuffers(file);
+	CloseHandle(file);
+}
+
+LONG WINAPI Logger::UnhandledExceptionFilter(EXCEPTION_POINTERS* exceptionInfo)
+{
+	auto exceptionRecord = exceptionInfo->ExceptionRecord;
+	// Save the flight-recorder first. Logging the line allocates and locks, which may not work anymore in the crashed process.
+	DumpFlightRecorderAfterCrash("Unhandled exception", exceptionRecord);
+
+	LogFormatBuffer reason;
+	reason.AppendFormat("Unhandled exception 0x%08lX at %p\n", exceptionRecord->ExceptionCode, exceptionRecord->ExceptionAddress);
+	ProcessLog(Loglevel::LOG_FATAL, reason.Data(), true);
+
+	// Let Windows report the crash as usual.
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+void Logger::TerminateHandler()
+{
+	DumpFlightRecorderAfterCrash("std::terminate() was called. Probably an exception was not caught.", NULL);
+	ProcessLog(Loglevel::LOG_FATAL, "std::terminate() was called. Probably an exception was not caught.\n", true);
+	abort();
 }
 
 void Logger::ReleaseInstance()
 {
+	logMaintenance.Stop();
+	ReportPendingRateLimits();
+	logSegments.Close();
+	fileWriter.Stop();
 	if (logFile.is_open()) {
 		logFile.close();
 	}
@@ -68,6 +440,38 @@ void Logger::ReleaseInstance()
 	isSetupDone = false;
 }
 
+void Logger::Flush()
+{
+	ReportPendingRateLimits();
+	if (logSegments.Flush()) {
+		return;
+	}
+	fileWriter.Flush();
+}
+
+void Logger::ReportPendingRateLimits()
+{
+	LogRateLimiter::ForEachRegistered([](LogRateLimiter& rateLimiter) {
+		uint32_t suppressedCount = 0;
+		uint32_t repeatCount = 0;
+		if (rateLimiter.TakePending(suppressedCount, repeatCount) == false) {
+			return;
+		}
+
+		Loglevel loglevel = NoticeLevel(static_cast<Loglevel>(rateLimiter.Level()));
+		if (suppressedCount > 0) {
+			LogFormatBuffer notice;
+			notice.AppendFormat("%s::%s: %u lines were dropped because of the rate-limit.\n", rateLimiter.Module(), rateLimiter.Function(), suppressedCount);
+			ProcessLog(loglevel, notice.Data());
+		}
+		if (repeatCount > 0) {
+			LogFormatBuffer notice;
+			notice.AppendFormat("%s::%s: The last line was repeated %u times.\n", rateLimiter.Module(), rateLimiter.Function(), repeatCount);
+			ProcessLog(loglevel, notice.Data());
+		}
+	});
+}
+
 bool Logger::App(std::string text, ...)
 {
 	va_list argptr;
@@ -78,41 +482,63 @@ bool Logger::App(std::string text, ...)
 }
 bool Logger::Fatal(std::string text, ...)
 {
+	if (IsEnabled(Loglevel::LOG_FATAL) == false) {
+		return false;
+	}
+
 	va_list argptr;
 	va_start(argptr, text);
-	auto returnValue = LogVariadic(Loglevel::LOG_APP, text + "\n", argptr);
+	// The process may die right after a fatal error, so the line is written immediately.
+	auto returnValue = LogVariadic(Loglevel::LOG_FATAL, text + "\n", argptr, true);
 	va_end(argptr);
+	DumpFlightRecorder("Fatal error");
 	return returnValue;
 }
 bool Logger::Error(std::string text, ...)
 {
+	if (IsEnabled(Loglevel::LOG_ERROR) == false) {
+		return false;
+	}
+
 	va_list argptr;
 	va_start(argptr, text);
-	auto returnValue = LogVariadic(Loglevel::LOG_APP, text + "\n", argptr);
+	auto returnValue = LogVariadic(Loglevel::LOG_ERROR, text + "\n", argptr);
 	va_end(argptr);
 	return returnValue;
 }
 bool Logger::Warning(std::string text, ...)
 {
+	if (IsEnabled(Loglevel::LOG_WARNING) == false) {
+		return false;
+	}
+
 	va_list argptr;
 	va_start(argptr, text);
-	auto returnValue = LogVariadic(Loglevel::LOG_APP, text + "\n", argptr);
+	auto returnValue = LogVariadic(Loglevel::LOG_WARNING, text + "\n", argptr);
 	va_end(argptr);
 	return returnValue;
 }
 bool Logger::Info(std::string text, ...)
 {
+	if (IsEnabled(Loglevel::LOG_INFO) == false) {
+		return false;
+	}
+
 	va_list argptr;
 	va_start(argptr, text);
-	auto returnValue = LogVariadic(Loglevel::LOG_APP, text + "\n", argptr);
+	auto returnValue = LogVariadic(Loglevel::LOG_INFO, text + "\n", argptr);
 	va_end(argptr);
 	return returnValue;
 }
 bool Logger::Debug(std::string text, ...)
 {
+	if (IsEnabled(Loglevel::LOG_DEBUG) == false) {
+		return false;
+	}
+
 	va_list argptr;
 	va_start(argptr, text);
-	auto returnValue = LogVariadic(Loglevel::LOG_APP, text + "\n", argptr);
+	auto returnValue = LogVariadic(Loglevel::LOG_DEBUG, text + "\n", argptr);
 	va_end(argptr);
 	return returnValue;
 }
@@ -137,42 +563,101 @@ bool Logger::Log(Loglevel loglevel, std::string text, ...)
 	return returnvalue;
 }
 
-bool Logger::LogVariadic(Loglevel loglevel, std::string logFormatString, va_list argptr)
+void Logger::LogFunction(Loglevel loglevel, LogRateLimiter& rateLimiter, const char* module, const char* function, const char* format, ...)
+{
+	// Checked before formatting, so a flood of lines only costs the check.
+	// Errors are never dropped, because they are the lines that are needed to find the cause of a flood.
+	int64_t now = LogRecordWriter::Now();
+	uint32_t suppressedCount = 0;
+	if (loglevel > Loglevel::LOG_ERROR && rateLimiter.TryAcquire(now, rateLimit, suppressedCount) == false) {
+		return;
+	}
+	if (suppressedCount > 0) {
+		LogFormatBuffer notice;
+		notice.AppendFormat("%s::%s: %u lines were dropped because of the rate-limit.\n", module, function, suppressedCount);
+		ProcessLog(NoticeLevel(loglevel), notice.Data());
+	}
+
+	LogFormatBuffer logText;
+	logText.Append(module);
+	logText.Append("::");
+	logText.Append(function);
+	logText.Append(": ");
+
+	va_list argptr;
+	va_start(argptr, format);
+	logText.AppendFormatV(format, argptr);
+	va_end(argptr);
+
+	uint32_t repeatCount = 0;
+	bool isNew = rateLimiter.Collapse(logText.Data(), logText.Size(), now, rateLimit, repeatCount);
+	if (repeatCount > 0) {
+		LogFormatBuffer notice;
+		notice.AppendFormat("%s::%s: The last line was repeated %u times.\n", module, function, repeatCount);
+		ProcessLog(NoticeLevel(loglevel), notice.Data());
+	}
+	if (isNew == false) {
+		return;
+	}
+
+	logText.Append("\n");
+	ProcessLog(loglevel, logText.Data());
+}
+
+bool Logger::LogVariadic(Loglevel loglevel, std::string logFormatString, va_list argptr, bool writeThrough)
 {
-	const size_t buffersize = 5000;
-	char logStringBuffer[buffersize];
-	auto count = vsnprintf(logStringBuffer, buffersize, logFormatString.c_str(), argptr);
+	// Check before formatting, so a disabled line does not cost the formatting.
+	if (IsEnabled(loglevel) == false) {
+		return false;
+	}
 
-	if (count > buffersize) {
-		OutputDebugStringA("Error: The buffer was to small for the logstring. It has to be adusted in the code if that happens.");
-		std::cerr << "Error: The buffer was to small for the logstring. It has to be adusted in the code if that happens.";
+	LogFormatBuffer logText;
+	if (logText.AppendFormatV(logFormatString.c_str(), argptr) == false) {
+		OutputDebugStringA("Error: The format-string of the log-line is invalid.\n");
+		return false;
 	}
 
-	ProcessLog(loglevel, logStringBuffer);
+	ProcessLog(loglevel, logText.Data(), writeThrough);
 
 	return true;
 }
 
-void Logger::ProcessLog(const Loglevel loglevel, const char* logTextBuffer)
+/**
+ * @param writeThrough Skips the sink and the buffer and writes the line into the file before returning.
+ *                     Lines that are still held back in the sink are written after this line.
+ */
+void Logger::ProcessLog(const Loglevel loglevel, const char* logTextBuffer, bool writeThrough)
 {
 	if (isSetupDone == false) {
 		OutputDebugStringA("ERROR: Logger setup was not done!\n");
 		return;
 	}
 
-	std::string logText = "";
-	// Append timestamp
-	auto timeString = Logger::GetTimeString("%H:%M:%S", true);
-	logText.append(timeString + " - ");
+	// The time of the origin is taken here. The timestamp is added to the text when the line is written.
+	int64_t timestamp = LogRecordWriter::Now();
+	flightRecorder.Record(timestamp, static_cast<uint8_t>(loglevel), logTextBuffer);
 
-	// Append loglevel
-	switch (loglevel) {
-	case Loglevel::LOG_APP: break;
-	case Loglevel::LOG_FATAL: logText = "FATAL: "; break;
-	case Loglevel::LOG_ERROR: logText = "ERROR: "; break;
-	case Loglevel::LOG_WARNING: logText = "WARNING: "; break;
-	case Loglevel::LOG_INFO: logText = "INFO: "; break;
-	case Loglevel::LOG_DEBUG: logText = "DEBUG: "; break;
+	// If the loglevel is above the maximum, the line is only kept by the flight-recorder.
+	if (loglevel > Logger::loglevelToLog) {
+		return;
+	}
+
+	::LogLine logLine;
+	logLine.timestamp = timestamp;
+	logLine.producerId = GetCurrentProcessId();
+	logLine.level = static_cast<uint8_t>(loglevel);
+
+	std::string& logText = logLine.text;
+	// Append loglevel. Info is the normal case and has no prefix. The journal has the level in the record-header.
+	if (binaryJournal == false) {
+		switch (loglevel) {
+		case Loglevel::LOG_APP: break;
+		case Loglevel::LOG_FATAL: logText = "FATAL: "; break;
+		case Loglevel::LOG_ERROR: logText = "ERROR: "; break;
+		case Loglevel::LOG_WARNING: logText = "WARNING: "; break;
+		case Loglevel::LOG_INFO: break;
+		case Loglevel::LOG_DEBUG: logText = "DEBUG: "; break;
+		}
 	}
 	logText.append(logTextBuffer);
 
@@ -182,21 +667,57 @@ void Logger::ProcessLog(const Loglevel loglevel, const char* logTextBuffer)
 	OutputDebugStringW(wideLogText.c_str());
 #endif
 
-	// If the loglevel is above the maximum, nothing shall be loged.
-	if (loglevel > Logger::loglevelToLog) {
+	if (writeThrough) {
+		WriteLine(logLine);
+		Flush();
 		return;
 	}
 
-	logFile << logText;
-	logFile.flush();
+	auto sink = lineSink.load();
+	if (sink != nullptr) {
+		sink(logLine);
+		return;
+	}
+
+	WriteLine(logLine);
+}
+
+/**
+ * @brief Writes the line with the time when it was created into the log-file.
+ */
+void Logger::WriteLine(const ::LogLine& logLine)
+{
+	if (isSetupDone == false) {
+		return;
+	}
+
+	// WriteLine() is called by the log-consumer and by the UI-thread, so every thread has its own formatter and buffer.
+	static thread_local std::string line;
+	line.clear();
+
+	if (binaryJournal) {
+		// The record keeps the timestamp of the clock. The decoder turns it into the time of day with the file-header.
+		LogJournalWriter::AppendRecord(line, logLine);
+		AppendToLogFile(line);
+		return;
+	}
+
+	// The timestamp is from the monotonic clock, so the difference to now tells the wall-clock-time.
+	auto age = LogClock::now() - LogClock::time_point(std::chrono::nanoseconds(logLine.timestamp));
+	auto time = std::chrono::system_clock::now() - std::chrono::duration_cast<std::chrono::system_clock::duration>(age);
+
+	static thread_local LogTimestampFormatter timestampFormatter("%H:%M:%S");
+	timestampFormatter.AppendTo(line, time);
+	line.append(" - ");
+	line.append(logLine.text);
+	AppendToLogFile(line);
 }
 
-std::string Logger::GetTimeString(const char* formatString, bool withMilliseconds)
+std::string Logger::GetTimeString(const char* formatString, bool withMilliseconds, std::chrono::system_clock::time_point time)
 {
 	using namespace std::chrono;
 
-	// Get current time
-	auto now = system_clock::now();
+	auto now = time;
 
 	// Get number of milliseconds for the current second
 	// (remainder after division into seconds)
@@ -2,11 +2,44 @@
 /* Copyright(C) 1998 - 2018 WhatsappTray Sebastian Amann */
 
 #pragma once
+#include "LogFileWriter.h"
+#include "LogFlightRecorder.h"
+#include "LogFormat.h"
+#include "LogJournal.h"
+#include "LogMaintenance.h"
+#include "LogRateLimiter.h"
+#include "LogRecord.h"
+#include "MappedLogFile.h"
+#include "SegmentedLog.h"
+
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
 
-#define LogInfo(logString, ...) Logger::Info(MODULE_NAME + std::string("::") + std::string(__func__) + ": " + string_format(logString, __VA_ARGS__))
-#define LogError(logString, ...) Logger::Error(MODULE_NAME + std::string("::") + std::string(__func__) + ": " + string_format(logString, __VA_ARGS__))
+/**
+ * Levels above this are removed by the compiler. Can be overridden in the project-settings.
+ * All builds contain the debug-lines, so the flight-recorder gets them also in release-builds. Whether they are formatted is decided at runtime by Logger::IsEnabled(). (See LogFlightRecorder.h)
+ */
+#ifndef LOGGER_COMPILED_LEVEL
+#define LOGGER_COMPILED_LEVEL Loglevel::LOG_DEBUG
+#endif
+
+/**
+ * The level is checked before the arguments are evaluated and formatted. A disabled line only costs one compare.
+ * Every call-site has its own rate-limit and collapses identical lines. (See LogRateLimiter.h)
+ */
+#define LogIfEnabled(level, ...) do { if constexpr (level <= LOGGER_COMPILED_LEVEL) { if (Logger::IsEnabled(level)) { LOG_CHECK_FORMAT(__VA_ARGS__); static LogRateLimiter logRateLimiter(MODULE_NAME, __func__, static_cast<int>(level)); Logger::LogFunction(level, logRateLimiter, MODULE_NAME, __func__, __VA_ARGS__); } } } while (0)
+
+/**
+ * The first argument is the format-string. It is passed inside of __VA_ARGS__, so a line without arguments also builds with GCC and Clang.
+ */
+#define LogError(...) LogIfEnabled(Loglevel::LOG_ERROR, __VA_ARGS__)
+#define LogWarning(...) LogIfEnabled(Loglevel::LOG_WARNING, __VA_ARGS__)
+#define LogInfo(...) LogIfEnabled(Loglevel::LOG_INFO, __VA_ARGS__)
+#define LogDebug(...) LogIfEnabled(Loglevel::LOG_DEBUG, __VA_ARGS__)
 
 enum class Loglevel
 {
@@ -18,6 +51,23 @@ enum class Loglevel
 	LOG_INFO,
 	LOG_DEBUG,
 };
+static_assert(static_cast<uint8_t>(Loglevel::LOG_WARNING) == logRecordWarningLevel, "The hook writes its notices with the value of LOG_WARNING.");
+struct LoggerConfig
+{
+	/* The size of the memory-mapped log-files. When one is full, the next one is created. */
+	size_t segmentSize = defaultLogSegmentSize;
+	/* How often the buffered lines are written, if the log-file can not be mapped into memory. */
+	LogFileWriterConfig writerConfig;
+	/* When the segments are rotated and how much disk-space all log-files may use. */
+	LogRotationConfig rotationConfig;
+	/* Writes the binary journal instead of text. (See LogJournal.h) */
+	bool binaryJournal = false;
+	/* How many of the last lines of all levels are kept in memory. 0 disables the flight-recorder. (See "--noFlightRecorder")
+	 * While it is enabled, the debug-lines are formatted for it, also when they are not written into the log-file. */
+	size_t flightRecorderSlots = defaultLogFlightRecorderSlots;
+	/* The limit for every call-site of the log-macros. */
+	LogRateLimit rateLimit;
+};
 
 class Logger
 {
@@ -25,18 +75,81 @@ private:
 	Logger();
 	~Logger();
 
+	/* The lines are appended to the mapped segments. logFile and fileWriter are only used if a segment could not be created. */
+	static SegmentedLog<MappedLogFile> logSegments;
+	/* The path of the log-files without ".txt". The following segments get "_<number>" appended. */
+	static std::string logSegmentBasePath;
+	static size_t logSegmentSize;
+	static int logSegmentCount;
+	static std::mutex activeLogFilePathMutex;
+	static std::string activeLogFilePath;
+	static LogFileWriterConfig fileWriterConfig;
+	static bool binaryJournal;
+	/* The last lines of all levels. Written by DumpFlightRecorder(). */
+	static LogFlightRecorder flightRecorder;
+	/* Lines up to this level are recorded, also if they are not logged. */
+	static Loglevel loglevelToRecord;
+	static LogRateLimit rateLimit;
+
 	static std::ofstream logFile;
+	/* Writes into logFile in its own thread. NOTE: Declared after logFile, so it is destroyed first and still can write at the end. */
+	static LogFileWriter fileWriter;
+	/* Rotates, compresses and deletes the log-files. NOTE: Declared last, so its thread is stopped first. */
+	static LogMaintenance logMaintenance;
 
 	bool Log(Loglevel loglevel, std::string text, ...);
-	static bool LogVariadic(Loglevel loglevel, std::string text, va_list vadriaicList);
-	static void ProcessLog(const Loglevel loglevel, const char* logTextBuffer);
-	static std::string GetTimeString(const char* formatString, bool withMilliseconds = false);
+	static bool LogVariadic(Loglevel loglevel, std::string text, va_list vadriaicList, bool writeThrough = false);
+	static void ProcessLog(const Loglevel loglevel, const char* logTextBuffer, bool writeThrough = false);
+	static std::string GetTimeString(const char* formatString, bool withMilliseconds = false, std::chrono::system_clock::time_point time = std::chrono::system_clock::now());
+	static void AppendToLogFile(const std::string& text);
+	static std::string NextLogFilePath();
+	static bool OpenLogSegment(MappedLogFile& file, size_t minimumSize);
+	static void OpenFallbackLogFile();
+	static std::string CreateJournalFileHeader();
+	static LONG WINAPI UnhandledExceptionFilter(EXCEPTION_POINTERS* exceptionInfo);
+	static void TerminateHandler();
+	static void PrepareCrashDump();
+	static void DumpFlightRecorderAfterCrash(const char* reason, const EXCEPTION_RECORD* exceptionRecord);
+
+	/* When set, the lines are handed over instead of written. (See SetLineSink())
+	 * NOTE: ::LogLine is the struct. Logger::LogLine() is a function. */
+	static std::atomic<void(*)(const ::LogLine&)> lineSink;
 
 public:
+	/* Lines with a higher level are not formatted. Should only be changed at startup. */
 	static Loglevel loglevelToLog;
 	static bool isSetupDone;
-	static void Setup();
+	static void Setup(const LoggerConfig& config = LoggerConfig());
+	/**
+	 * @brief Writes the buffered lines and closes the log-file.
+	 */
 	static void ReleaseInstance();
+	/**
+	 * @brief Writes the buffered lines to the disk and waits until they are written.
+	 */
+	static void Flush();
+	/**
+	 * @brief Writes the rate-limit- and repeat-counts that the call-sites still hold, because they did not log again.
+	 *
+	 * Called by Flush(), ReleaseInstance() and periodically by the log-maintenance.
+	 */
+	static void ReportPendingRateLimits();
+	/**
+	 * @brief The log-file that is currently written.
+	 */
+	static std::string ActiveLogFilePath();
+	/**
+	 * @brief Seals the current segment and starts a new one, if the current one was opened before maxAge.
+	 */
+	static void RotateLogSegmentIfOlderThan(std::chrono::minutes maxAge);
+	/**
+	 * @brief Writes the lines of the flight-recorder into a new file next to the log-files.
+	 *
+	 * Called on a fatal error, on an unhandled exception and from the tray-menu.
+	 * @param reason Written into the first line of the file.
+	 * @return The path of the file. Empty if nothing was written.
+	 */
+	static std::string DumpFlightRecorder(const char* reason);
 	static bool App(std::string text, ...);
 	static bool Fatal(std::string text, ...);
 	static bool Error(std::string text, ...);
@@ -44,4 +157,37 @@ public:
 	static bool Info(std::string text, ...);
 	static bool Debug(std::string text, ...);
 	static bool LogLine(Loglevel loglevel, std::string text, ...);
+	/**
+	 * @brief Writes "<module>::<function>: <formatted text>". Used by LogInfo() and the other macros, which already checked the level.
+	 *
+	 * @param rateLimiter The one of the call-site. Lines above the rate-limit and repeated lines are counted instead of written.
+	 *                    Errors and more severe lines are never dropped by the rate-limit, only identical ones are collapsed.
+	 */
+	static void LogFunction(Loglevel loglevel, LogRateLimiter& rateLimiter, const char* module, const char* function, const char* format, ...);
+
+	static bool IsFlightRecorderEnabled() { return flightRecorder.IsEnabled(); }
+	/**
+	 * @brief Copies a line that did not go through ProcessLog() into the flight-recorder, like the lines of the hook.
+	 *
+	 * No lock and no allocation. Does nothing if the flight-recorder is disabled.
+	 */
+	static void RecordLine(const ::LogLine& logLine) { flightRecorder.Record(logLine.timestamp, logLine.level, logLine.text.c_str()); }
+
+	/**
+	 * @brief True if the line is logged or recorded by the flight-recorder.
+	 */
+	static bool IsEnabled(Loglevel loglevel) { return loglevel <= loglevelToLog || loglevel <= loglevelToRecord; }
+
+	/**
+	 * @brief Lets all lines go through sink instead of writing them directly. The sink brings them in order with the lines of the hook and then calls WriteLine().
+	 *
+	 * nullptr writes the lines directly again.
+	 */
+	static void SetLineSink(void(*sink)(const ::LogLine&)) { lineSink = sink; }
+	/**
+	 * @brief Copies the line into the mapped log-file. Does not wait for the disk.
+	 *
+	 * In the binary journal the line is written as record, else as text with the time of day in front.
+	 */
+	static void WriteLine(const ::LogLine& logLine);
 };
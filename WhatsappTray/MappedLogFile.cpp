@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Implementation for the memory-mapped log-file.
+// NOTE: The logger uses this class, so errors can only be reported with OutputDebugStringA().
+
+#include "stdafx.h"
+#include "MappedLogFile.h"
+
+MappedLogFile::~MappedLogFile()
+{
+	Close();
+}
+
+bool MappedLogFile::Open(const std::string& path, size_t size)
+{
+	Close();
+
+	_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_file == INVALID_HANDLE_VALUE) {
+		OutputDebugStringA("ERROR: The log-segment could not be created.\n");
+		return false;
+	}
+
+	// The mapping sets the size of the file, so the whole segment is allocated up front.
+	ULARGE_INTEGER mappingSize;
+	mappingSize.QuadPart = size;
+	_fileMapping = CreateFileMappingA(_file, NULL, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, NULL);
+	if (_fileMapping == NULL) {
+		OutputDebugStringA("ERROR: The log-segment could not be mapped.\n");
+		Close();
+		return false;
+	}
+
+	_memory = static_cast<char*>(MapViewOfFile(_fileMapping, FILE_MAP_WRITE, 0, 0, size));
+	if (_memory == NULL) {
+		OutputDebugStringA("ERROR: The view of the log-segment could not be created.\n");
+		Close();
+		return false;
+	}
+
+	_segment = std::make_unique<LogSegment>(_memory, size);
+	return true;
+}
+
+void MappedLogFile::Close()
+{
+	size_t usedSize = _segment != nullptr ? _segment->UsedSize() : 0;
+	_segment.reset();
+
+	if (_memory != NULL) {
+		UnmapViewOfFile(_memory);
+		_memory = NULL;
+	}
+	if (_fileMapping != NULL) {
+		CloseHandle(_fileMapping);
+		_fileMapping = NULL;
+	}
+	if (_file != INVALID_HANDLE_VALUE) {
+		// Seal the segment. The file only contains the lines and not the zeros behind them.
+		LARGE_INTEGER fileSize;
+		fileSize.QuadPart = static_cast<LONGLONG>(usedSize);
+		if (SetFilePointerEx(_file, fileSize, NULL, FILE_BEGIN) == FALSE || SetEndOfFile(_file) == FALSE) {
+			OutputDebugStringA("ERROR: The log-segment could not be cut to the used size.\n");
+		}
+		CloseHandle(_file);
+		_file = INVALID_HANDLE_VALUE;
+	}
+}
+
+void MappedLogFile::Flush()
+{
+	if (_memory == NULL) {
+		return;
+	}
+	FlushViewOfFile(_memory, 0);
+	FlushFileBuffers(_file);
+}
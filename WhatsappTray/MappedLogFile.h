@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+#pragma once
+
+#include "LogSegment.h"
+
+#include <windows.h>
+#include <memory>
+#include <string>
+
+/**
+ * @brief A log-file with a fixed size, that is mapped into memory. The lines are appended through a LogSegment.
+ *
+ * When the file is closed, it is cut to the size that was used. After a crash the rest of the file stays filled with zeros.
+ */
+class MappedLogFile
+{
+public:
+	~MappedLogFile();
+
+	/**
+	 * @brief Creates the file with the given size and maps it.
+	 */
+	bool Open(const std::string& path, size_t size);
+	/**
+	 * @brief Unmaps the file and cuts off the part that was not used.
+	 */
+	void Close();
+
+	/**
+	 * @return False if the line does not fit anymore. (See LogSegment::TryAppend())
+	 */
+	bool TryAppend(const char* text, size_t length) { return _segment->TryAppend(text, length); }
+	/**
+	 * @brief Writes the mapped memory to the disk and waits for it. Only needed to keep the lines when the system goes down, a crash of WhatsappTray does not lose them.
+	 */
+	void Flush();
+
+private:
+	HANDLE _file = INVALID_HANDLE_VALUE;
+	HANDLE _fileMapping = NULL;
+	char* _memory = NULL;
+	std::unique_ptr<LogSegment> _segment;
+};
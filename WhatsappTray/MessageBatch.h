@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Collects multiple log-messages as frames into one buffer, so they can be sent with one send()-call.
+// NOTE: This file must not depend on Winsock or windows.h so the batching can be used and checked without sockets.
+
+#pragma once
+
+#include "MessageFraming.h"
+
+#include <chrono>
+#include <string>
+
+struct MessageBatchConfig
+{
+	/* The batch is sent when it contains this many bytes. */
+	size_t maxBytes = 64 * 1024;
+	/* The batch is sent when it contains this many messages. */
+	size_t maxMessages = 256;
+	/* The batch is sent at the latest this long after the first message was added. This limits the latency when there is not much traffic. */
+	std::chrono::milliseconds flushInterval = std::chrono::milliseconds(5);
+};
+
+class MessageBatch
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	MessageBatch(const MessageBatchConfig& config = MessageBatchConfig()) : _config(config) { }
+
+	/**
+	 * @brief Adds the message as frame to the batch.
+	 *
+	 * @param now The current time. Used to start the flush-deadline with the first message.
+	 */
+	void Add(const char* message, size_t messageSize, Clock::time_point now)
+	{
+		if (_messageCount == 0) {
+			_deadline = now + _config.flushInterval;
+		}
+		MessageFraming::AppendFrame(_data, message, messageSize);
+		_messageCount++;
+	}
+
+	void Add(const std::string& message, Clock::time_point now) { Add(message.data(), message.size(), now); }
+
+	/**
+	 * @brief True if no more messages should be added and the batch should be sent now.
+	 */
+	bool IsFull() const { return _data.size() >= _config.maxBytes || _messageCount >= _config.maxMessages; }
+	bool IsEmpty() const { return _messageCount == 0; }
+
+	/**
+	 * @brief True if the batch is full or the flush-deadline is reached.
+	 */
+	bool ShouldFlush(Clock::time_point now) const { return IsEmpty() == false && (IsFull() || now >= _deadline); }
+
+	/**
+	 * @brief The time until the deadline is reached. Zero if it is already reached.
+	 */
+	Clock::duration TimeUntilDeadline(Clock::time_point now) const { return now >= _deadline ? Clock::duration::zero() : _deadline - now; }
+
+	const std::string& Data() const { return _data; }
+	size_t MessageCount() const { return _messageCount; }
+
+	/**
+	 * @brief Removes all messages. The allocated memory is kept for the next batch.
+	 */
+	void Clear()
+	{
+		_data.clear();
+		_messageCount = 0;
+	}
+
+private:
+	MessageBatchConfig _config;
+	std::string _data;
+	size_t _messageCount = 0;
+	Clock::time_point _deadline;
+};
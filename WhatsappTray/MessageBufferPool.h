@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Recycles the buffers of the log-messages of the hook, so logging does not allocate on the heap of WhatsApp once the pool is warmed up.
+// A producer takes a buffer, writes the record into it and moves it into the message-buffer. After the consumer has copied the record into the batch, it returns the buffer.
+// The free-list is a MessageQueue of empty strings. Moving a std::string between the slots only moves the pointer, so the allocated memory is kept.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include "MessageQueue.h"
+
+#include <string>
+
+struct MessageBufferPoolConfig
+{
+	/* Count of buffers that are kept. They are allocated up front. When more messages are on the way at the same time, the additional buffers are allocated and freed again. */
+	size_t bufferCount = 256;
+	/* The capacity of every buffer. Big enough for almost all records. Buffers that had to grow are not kept, so the memory of the pool stays fixed. */
+	size_t bufferCapacity = 256;
+};
+
+class MessageBufferPool
+{
+public:
+	MessageBufferPool(const MessageBufferPoolConfig& config = MessageBufferPoolConfig())
+	{
+		Configure(config);
+	}
+
+	/**
+	 * @brief Allocates the buffers.
+	 *
+	 * NOTE: Must not be called while other threads use the pool.
+	 */
+	void Configure(const MessageBufferPoolConfig& config)
+	{
+		_config = config;
+
+		MessageQueueConfig queueConfig;
+		queueConfig.capacity = config.bufferCount;
+		queueConfig.fullPolicy = QueueFullPolicy::DropNewest;
+		// Take() and Return() are called for every message of the hook. Nobody looks at how long a free buffer waited.
+		queueConfig.collectStatistics = false;
+		_freeBuffers.Configure(queueConfig);
+
+		for (size_t i = 0; i < config.bufferCount; i++) {
+			std::string buffer;
+			buffer.reserve(config.bufferCapacity);
+			// reserve() may round up, so remember the real capacity. It is used to recognize the buffers of the pool.
+			_bufferCapacity = buffer.capacity();
+			_freeBuffers.Enqueue(std::move(buffer));
+		}
+	}
+
+	/**
+	 * @brief Returns an empty buffer. Only allocates when the pool is empty.
+	 *
+	 * Can be called from any thread.
+	 */
+	std::string Take()
+	{
+		std::string buffer;
+		if (_freeBuffers.TryDequeue(buffer) == false) {
+			buffer.reserve(_config.bufferCapacity);
+		}
+		return buffer;
+	}
+
+	/**
+	 * @brief Puts the buffer back into the pool. Buffers that did not come from the pool or had to grow are freed.
+	 *
+	 * Can be called from any thread. Also with a moved-from string, then nothing happens.
+	 */
+	void Return(std::string&& buffer)
+	{
+		if (buffer.capacity() != _bufferCapacity) {
+			return;
+		}
+
+		buffer.clear();
+		// If the pool is already full, the buffer is freed when it goes out of scope.
+		_freeBuffers.Enqueue(std::move(buffer));
+	}
+
+private:
+	MessageBufferPoolConfig _config;
+	size_t _bufferCapacity = 0;
+	MessageQueue _freeBuffers;
+};
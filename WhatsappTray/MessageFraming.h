@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Framing for the log-messages that are sent from the hook to WhatsappTray.
+// Every message is sent as a frame: a 4 byte little-endian length followed by the payload.
+// This way the hook can keep one connection open and send as many messages as it wants without waiting for an answer.
+// NOTE: This file is used by Hook.dll and WhatsappTray. It must not depend on Winsock or windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+constexpr size_t frameHeaderSize = 4;
+/* Frames bigger than this are treated as corrupt stream. */
+constexpr uint32_t frameMaxPayloadSize = 1024 * 1024;
+
+class MessageFraming
+{
+public:
+	/**
+	 * @brief Appends the payload as frame to the buffer.
+	 */
+	static void AppendFrame(std::string& buffer, const char* payload, size_t payloadSize)
+	{
+		uint32_t size = static_cast<uint32_t>(payloadSize);
+		char header[frameHeaderSize] = {
+			static_cast<char>(size & 0xFF),
+			static_cast<char>((size >> 8) & 0xFF),
+			static_cast<char>((size >> 16) & 0xFF),
+			static_cast<char>((size >> 24) & 0xFF),
+		};
+		buffer.append(header, frameHeaderSize);
+		buffer.append(payload, payloadSize);
+	}
+
+	static uint32_t ReadFrameSize(const char* header)
+	{
+		auto bytes = reinterpret_cast<const unsigned char*>(header);
+		return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) | (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	}
+};
+
+/**
+ * @brief Collects the bytes of a stream and splits them into frames.
+ *
+ * The bytes can come in arbitrary chunks, for example a frame split over multiple recv()-calls or multiple frames in one recv()-call.
+ */
+class FrameReader
+{
+public:
+	void Append(const char* data, size_t size)
+	{
+		// Drop the already consumed bytes before the buffer grows, so the buffer does not grow forever.
+		if (_readPosition > 0 && _readPosition == _buffer.size()) {
+			_buffer.clear();
+			_readPosition = 0;
+		} else if (_readPosition > 64 * 1024) {
+			_buffer.erase(0, _readPosition);
+			_readPosition = 0;
+		}
+		_buffer.append(data, size);
+	}
+
+	/**
+	 * @brief Gets the next complete frame.
+	 *
+	 * @return True if a frame was written into frame. False if there is no complete frame yet or the stream is corrupt. (See HasError())
+	 */
+	bool NextFrame(std::string& frame)
+	{
+		if (_hasError || _buffer.size() - _readPosition < frameHeaderSize) {
+			return false;
+		}
+
+		uint32_t payloadSize = MessageFraming::ReadFrameSize(_buffer.data() + _readPosition);
+		if (payloadSize > frameMaxPayloadSize) {
+			_hasError = true;
+			return false;
+		}
+
+		if (_buffer.size() - _readPosition - frameHeaderSize < payloadSize) {
+			return false;
+		}
+
+		frame.assign(_buffer, _readPosition + frameHeaderSize, payloadSize);
+		_readPosition += frameHeaderSize + payloadSize;
+		return true;
+	}
+
+	bool HasError() const { return _hasError; }
+
+	/**
+	 * @brief The count of the bytes that were not returned as frame yet. Not 0 while only a part of a frame was received.
+	 */
+	size_t PendingSize() const { return _buffer.size() - _readPosition; }
+
+	/**
+	 * @brief Drops all bytes that were not returned as frame yet and clears the error, so the reader can continue at a new frame-boundary.
+	 *
+	 * @return The count of the dropped bytes.
+	 */
+	size_t Reset()
+	{
+		size_t droppedBytes = PendingSize();
+		_buffer.clear();
+		_readPosition = 0;
+		_hasError = false;
+		return droppedBytes;
+	}
+
+private:
+	std::string _buffer;
+	size_t _readPosition = 0;
+	bool _hasError = false;
+};
@@ -0,0 +1,411 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The buffer between the threads that log in the hook and the thread that sends the messages to WhatsappTray.
+// The buffer has a fixed capacity, so the hook can never let the memory of WhatsApp grow without limit, for example when WhatsappTray is not listening.
+// Multiple threads log at the same time (The init-thread, the UI-thread of WhatsApp in the window-proc, async-tasks), so Enqueue() is lock-free.
+// A producer never waits for another producer. Only the consumer sleeps on a condition-variable when the queue is empty.
+// With QueueFullPolicy::Block a producer also sleeps on a condition-variable until the consumer made room, so a blocked UI-thread does not burn the CPU that the consumer needs.
+// The ring is the bounded multi-producer/multi-consumer queue of Dmitry Vyukov: Every slot has a sequence-number that tells if it is free or filled.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+enum class QueueFullPolicy
+{
+	/* The new message is dropped. */
+	DropNewest,
+	/* The oldest message in the queue is dropped to make room for the new one. */
+	DropOldest,
+	/* The producer sleeps up to blockTimeout until there is free space. If there is still no space, the new message is dropped. */
+	Block,
+};
+
+struct MessageQueueConfig
+{
+	/* Maximum count of messages in the queue. Rounded up to a power of two. */
+	size_t capacity = 4096;
+	/* Maximum count of bytes of all messages in the queue. When multiple threads enqueue at the same time, it can be exceeded by a few messages. */
+	size_t maxBytes = 4 * 1024 * 1024;
+	QueueFullPolicy fullPolicy = QueueFullPolicy::DropOldest;
+	std::chrono::milliseconds blockTimeout = std::chrono::milliseconds(10);
+	/* Measure how long the messages wait in the queue. (See MessageQueueStatistics) Costs two reads of the clock per message, so queues that nobody inspects turn it off. */
+	bool collectStatistics = true;
+	/* Optional. Gets the messages that DropOldest removes, so their memory can be reused instead of being freed. Called by the producer that removed them. */
+	std::function<void(std::string&& message)> evictedMessageHandler;
+};
+
+/* How long the messages waited in the queue. Only counts the messages that were taken by the consumer, not the dropped ones. */
+struct MessageQueueStatistics
+{
+	size_t maxSize = 0;
+	uint64_t dequeuedCount = 0;
+	std::chrono::microseconds totalWait = std::chrono::microseconds(0);
+	std::chrono::microseconds maxWait = std::chrono::microseconds(0);
+};
+
+class MessageQueue
+{
+public:
+	MessageQueue(const MessageQueueConfig& config = MessageQueueConfig())
+	{
+		Configure(config);
+	}
+
+	/**
+	 * @brief Sets the limits. Removes all messages that are still in the queue.
+	 *
+	 * NOTE: Must not be called while other threads use the queue.
+	 */
+	void Configure(const MessageQueueConfig& config)
+	{
+		_config = config;
+
+		size_t capacity = 1;
+		while (capacity < config.capacity) {
+			capacity *= 2;
+		}
+		_mask = capacity - 1;
+
+		_slots.reset(new Slot[capacity]);
+		for (size_t i = 0; i < capacity; i++) {
+			_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		_enqueuePosition.store(0, std::memory_order_relaxed);
+		_dequeuePosition.store(0, std::memory_order_relaxed);
+		_bytes.store(0, std::memory_order_relaxed);
+		_wakeUp.store(false, std::memory_order_relaxed);
+		_maxSize.store(0, std::memory_order_relaxed);
+		_dequeuedCount.store(0, std::memory_order_relaxed);
+		_totalWaitUs.store(0, std::memory_order_relaxed);
+		_maxWaitUs.store(0, std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Adds the message to the queue. What happens when the queue is full depends on the QueueFullPolicy.
+	 *
+	 * Can be called from any thread.
+	 * @return False if a message had to be dropped.
+	 */
+	bool Enqueue(std::string&& message)
+	{
+		if (message.size() > _config.maxBytes) {
+			_droppedCount++;
+			return false;
+		}
+
+		bool nothingDropped = true;
+		auto deadline = std::chrono::steady_clock::time_point();
+		// The queue can only stay full that long, if the other producers keep filling it. Then the new message is dropped.
+		for (size_t attempt = 0; TryEnqueue(message) == false; attempt++) {
+			switch (_config.fullPolicy) {
+			case QueueFullPolicy::DropNewest: {
+				_droppedCount++;
+				return false;
+			}
+			case QueueFullPolicy::DropOldest: {
+				std::string oldestMessage;
+				if (attempt > _mask || TryTake(oldestMessage, nullptr) == false) {
+					_droppedCount++;
+					return false;
+				}
+				_droppedCount++;
+				nothingDropped = false;
+				if (_config.evictedMessageHandler) {
+					_config.evictedMessageHandler(std::move(oldestMessage));
+				}
+			} break;
+			case QueueFullPolicy::Block: {
+				if (attempt == 0) {
+					deadline = std::chrono::steady_clock::now() + _config.blockTimeout;
+				}
+				if (WaitForSpace(message.size(), deadline) == false) {
+					_droppedCount++;
+					return false;
+				}
+			} break;
+			}
+		}
+
+		if (_config.collectStatistics) {
+			StoreMax(_maxSize, Size());
+		}
+
+		// Only lock when the consumer sleeps. This is only the case for the first message after the queue was empty.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_consumerWaiting.exchange(false)) {
+			std::lock_guard<std::mutex> lock(_waitMutex);
+			_notEmpty.notify_one();
+		}
+
+		return nothingDropped;
+	}
+
+	/**
+	 * @brief Waits until there is a message or WakeUp() is called. Must only be called by the one consumer.
+	 *
+	 * @return False if there was no message.
+	 */
+	bool WaitDequeue(std::string& message)
+	{
+		return WaitDequeueUntil(message, std::chrono::steady_clock::time_point::max());
+	}
+
+	/**
+	 * @brief Waits until there is a message, WakeUp() is called or the timeout is reached. Must only be called by the one consumer.
+	 *
+	 * @return False if there was no message.
+	 */
+	bool WaitDequeueTimed(std::string& message, std::chrono::microseconds timeout)
+	{
+		return WaitDequeueUntil(message, std::chrono::steady_clock::now() + timeout);
+	}
+
+	/**
+	 * @brief Takes the oldest message without waiting.
+	 *
+	 * @return False if there was no message.
+	 */
+	bool TryDequeue(std::string& message)
+	{
+		std::chrono::steady_clock::time_point enqueueTime;
+		if (TryTake(message, &enqueueTime) == false) {
+			return false;
+		}
+		if (_config.collectStatistics == false) {
+			return true;
+		}
+
+		auto waitUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - enqueueTime).count());
+		_dequeuedCount.fetch_add(1, std::memory_order_relaxed);
+		_totalWaitUs.fetch_add(waitUs, std::memory_order_relaxed);
+		StoreMax(_maxWaitUs, waitUs);
+		return true;
+	}
+
+	/**
+	 * @brief Waits until WakeUp() is called or the timeout is reached. The messages stay in the queue. Must only be called by the one consumer.
+	 *
+	 * Used when the consumer can not take more messages at the moment.
+	 * @return True if WakeUp() was called.
+	 */
+	bool WaitForWakeUp(std::chrono::microseconds timeout)
+	{
+		std::unique_lock<std::mutex> lock(_waitMutex);
+		_notEmpty.wait_for(lock, timeout, [&]() { return _wakeUp.load(); });
+		return _wakeUp.exchange(false);
+	}
+
+	/**
+	 * @brief Lets one waiting WaitDequeue()/WaitDequeueTimed()/WaitForWakeUp() return, also when there is no message.
+	 */
+	void WakeUp()
+	{
+		_wakeUp.store(true);
+		std::lock_guard<std::mutex> lock(_waitMutex);
+		_notEmpty.notify_one();
+	}
+
+	/**
+	 * @brief The count of messages in the queue. Only a snapshot when other threads use the queue.
+	 */
+	size_t Size() const
+	{
+		return _enqueuePosition.load(std::memory_order_relaxed) - _dequeuePosition.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Returns the count of dropped messages since the last call and resets it.
+	 */
+	uint64_t TakeDroppedCount() { return _droppedCount.exchange(0); }
+
+	/**
+	 * @brief Adds messages that were lost after they left the queue, for example because sending failed.
+	 */
+	void AddDroppedCount(uint64_t count) { _droppedCount += count; }
+
+	MessageQueueStatistics Statistics() const
+	{
+		MessageQueueStatistics statistics;
+		statistics.maxSize = static_cast<size_t>(_maxSize.load(std::memory_order_relaxed));
+		statistics.dequeuedCount = _dequeuedCount.load(std::memory_order_relaxed);
+		statistics.totalWait = std::chrono::microseconds(_totalWaitUs.load(std::memory_order_relaxed));
+		statistics.maxWait = std::chrono::microseconds(_maxWaitUs.load(std::memory_order_relaxed));
+		return statistics;
+	}
+
+private:
+	struct Slot
+	{
+		/* == position: free for the producer of that position. == position + 1: filled for the consumer of that position. */
+		std::atomic<size_t> sequence;
+		std::string message;
+		std::chrono::steady_clock::time_point enqueueTime;
+	};
+
+	MessageQueueConfig _config;
+	std::unique_ptr<Slot[]> _slots;
+	size_t _mask = 0;
+	/* Producers and consumer on separate cache-lines so they do not slow each other down. */
+	alignas(64) std::atomic<size_t> _enqueuePosition = 0;
+	alignas(64) std::atomic<size_t> _dequeuePosition = 0;
+	std::atomic<size_t> _bytes = 0;
+	std::atomic<uint64_t> _droppedCount = 0;
+	/* Only for the statistics. */
+	std::atomic<uint64_t> _maxSize = 0;
+	std::atomic<uint64_t> _dequeuedCount = 0;
+	std::atomic<uint64_t> _totalWaitUs = 0;
+	std::atomic<uint64_t> _maxWaitUs = 0;
+
+	/* Only used to let the consumer sleep. Producers only lock it when _consumerWaiting is set. */
+	std::mutex _waitMutex;
+	std::condition_variable _notEmpty;
+	std::atomic<bool> _consumerWaiting = false;
+	std::atomic<bool> _wakeUp = false;
+
+	/* Only used to let the producers sleep with QueueFullPolicy::Block. Separate from _waitMutex, because the consumer holds that one while it takes messages. */
+	std::mutex _blockMutex;
+	std::condition_variable _notFull;
+	std::atomic<uint32_t> _blockedProducerCount = 0;
+
+	/**
+	 * @brief Puts the message into the next free slot.
+	 *
+	 * @return False if the queue is full. The message is not moved in that case.
+	 */
+	bool TryEnqueue(std::string& message)
+	{
+		if (_bytes.load(std::memory_order_relaxed) + message.size() > _config.maxBytes) {
+			return false;
+		}
+
+		size_t position = _enqueuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Slot& slot = _slots[position & _mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+			if (difference == 0) {
+				if (_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					_bytes.fetch_add(message.size(), std::memory_order_relaxed);
+					slot.message = std::move(message);
+					if (_config.collectStatistics) {
+						slot.enqueueTime = std::chrono::steady_clock::now();
+					}
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = _enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * @brief Takes the oldest message without waiting. Used by the consumer and by producers that drop the oldest message.
+	 *
+	 * @param enqueueTime Gets the time when the message was enqueued. Can be nullptr.
+	 * @return False if there was no message.
+	 */
+	bool TryTake(std::string& message, std::chrono::steady_clock::time_point* enqueueTime)
+	{
+		size_t position = _dequeuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Slot& slot = _slots[position & _mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+			if (difference == 0) {
+				if (_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					message = std::move(slot.message);
+					slot.message.clear();
+					if (enqueueTime != nullptr) {
+						*enqueueTime = slot.enqueueTime;
+					}
+					_bytes.fetch_sub(message.size(), std::memory_order_relaxed);
+					// Free the slot for the round after the next.
+					slot.sequence.store(position + _mask + 1, std::memory_order_release);
+
+					// Only lock when a producer sleeps. Like in Enqueue(), either the producer sees the free slot or this check sees the producer.
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if (_blockedProducerCount.load(std::memory_order_relaxed) > 0) {
+						std::lock_guard<std::mutex> lock(_blockMutex);
+						_notFull.notify_all();
+					}
+					return true;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = _dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * @brief Sleeps until a message was taken or the deadline is reached.
+	 *
+	 * @return False if the deadline is reached and there is still no space for the message.
+	 */
+	bool WaitForSpace(size_t messageSize, std::chrono::steady_clock::time_point deadline)
+	{
+		auto hasSpace = [&]() { return Size() <= _mask && _bytes.load(std::memory_order_relaxed) + messageSize <= _config.maxBytes; };
+
+		std::unique_lock<std::mutex> lock(_blockMutex);
+		_blockedProducerCount.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (hasSpace() == false) {
+			_notFull.wait_until(lock, deadline);
+		}
+		_blockedProducerCount.fetch_sub(1);
+		return std::chrono::steady_clock::now() < deadline || hasSpace();
+	}
+
+	static void StoreMax(std::atomic<uint64_t>& maximum, uint64_t value)
+	{
+		uint64_t current = maximum.load(std::memory_order_relaxed);
+		while (value > current && maximum.compare_exchange_weak(current, value, std::memory_order_relaxed) == false) {
+		}
+	}
+
+	bool WaitDequeueUntil(std::string& message, std::chrono::steady_clock::time_point deadline)
+	{
+		if (TryDequeue(message)) {
+			return true;
+		}
+
+		std::unique_lock<std::mutex> lock(_waitMutex);
+		while (true) {
+			// Set the flag before checking the queue again. Either the producer sees the flag and notifies, or this check sees the message.
+			_consumerWaiting.store(true);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+
+			if (_wakeUp.exchange(false)) {
+				_consumerWaiting.store(false);
+				return TryDequeue(message);
+			}
+			if (TryDequeue(message)) {
+				_consumerWaiting.store(false);
+				return true;
+			}
+
+			if (deadline == std::chrono::steady_clock::time_point::max()) {
+				_notEmpty.wait(lock);
+			} else if (_notEmpty.wait_until(lock, deadline) == std::cv_status::timeout) {
+				_consumerWaiting.store(false);
+				return TryDequeue(message);
+			}
+		}
+	}
+};
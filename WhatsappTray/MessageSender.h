@@ -0,0 +1,386 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Sends the log-messages of the hook to WhatsappTray. Used by WinSockClient, which decides which transport is used.
+// The threads that log put their records into one of two bounded lanes. One message-processing thread collects them into batches and sends them over a LogTransport.
+// Nothing in here depends on a specific transport, so the same code is also used by the benchmark (See benchmarks/LogTransportBenchmark.cpp) and the tests.
+// NOTE: This file must not depend on Winsock or windows.h so it also builds on Linux.
+
+#pragma once
+
+#include "CircuitBreaker.h"
+#include "LogRecord.h"
+#include "LogTransport.h"
+#include "MessageBatch.h"
+#include "MessageBufferPool.h"
+#include "MessageQueue.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+enum class MessageLane
+{
+	/* Errors and the steps of the initialization. Sent before everything of the bulk-lane. */
+	Control,
+	/* Everything else, for example the traces of the window-messages. */
+	Bulk,
+};
+
+class MessageSender
+{
+public:
+	/* Creates the transport. Called from the message-processing thread, before anything is sent. */
+	using TransportFactory = std::function<std::unique_ptr<LogTransport>()>;
+
+	/* Limits every connect and send, so a WhatsappTray that does not read anymore can not block the message-processing thread. */
+	static constexpr std::chrono::milliseconds transportTimeout = std::chrono::milliseconds(500);
+
+	/**
+	 * @brief Starts the message-processing thread.
+	 *
+	 * @param producerId The id of this process. Used for the records that the sender creates itself.
+	 * @param queueConfig The limits of the message-buffer and what happens when it is full.
+	 * @param batchConfig Controls how many messages are collected before they are sent together.
+	 * @param reconnectConfig Controls how long to wait before the server is tried again after a failure.
+	 */
+	void Start(const TransportFactory& openTransport, uint32_t producerId, const MessageQueueConfig& queueConfig = MessageQueueConfig(), const MessageBatchConfig& batchConfig = MessageBatchConfig(), const ReconnectConfig& reconnectConfig = ReconnectConfig())
+	{
+		_openTransport = openTransport;
+		_producerId = producerId;
+		// The buffers of the messages that DropOldest removes go back into the pool. Otherwise a full buffer would allocate for every new message.
+		MessageQueueConfig laneConfig = queueConfig;
+		laneConfig.evictedMessageHandler = [this](std::string&& message) { _bufferPool.Return(std::move(message)); };
+		_controlLane.Configure(laneConfig);
+		_bulkLane.Configure(laneConfig);
+		_batchConfig = batchConfig;
+		_circuitBreaker = CircuitBreaker(reconnectConfig);
+
+		_isRunning = true;
+
+		_processMessagesThread = std::thread(&MessageSender::ProcessMessageQueue, this);
+	}
+
+	/**
+	 * @brief Puts the message into the lane. Can be called from any thread.
+	 *
+	 * @param message One record. (See LogRecord.h)
+	 * @param lane The messages of the control-lane are sent before the messages of the bulk-lane. The order within a lane is kept.
+	 */
+	void Send(std::string&& message, MessageLane lane)
+	{
+		if (_isRunning) {
+			// NOTE: If the buffer is full, messages are dropped and counted. (See AddDroppedMessagesRecord())
+			if (lane == MessageLane::Control) {
+				_controlLane.Enqueue(std::move(message));
+				_bulkLane.WakeUp();
+			} else {
+				_bulkLane.Enqueue(std::move(message));
+			}
+		}
+
+		// When the message was dropped, it was not moved. Then the buffer can be used again.
+		_bufferPool.Return(std::move(message));
+	}
+
+	/**
+	 * @brief Returns an empty buffer for a record. It is given back to the pool after the record was sent, so logging does not allocate.
+	 */
+	std::string TakeBuffer()
+	{
+		return _bufferPool.Take();
+	}
+
+	/**
+	 * @brief Gives a buffer back to the pool that was not passed to Send().
+	 */
+	void ReturnBuffer(std::string&& buffer)
+	{
+		_bufferPool.Return(std::move(buffer));
+	}
+
+	/**
+	 * @brief Sends the registration of a call-site to the server. (See LogRecord.h)
+	 *
+	 * The registrations do not go through the lanes. The new registrations are sent before every batch, so a registration always arrives before the first event of its call-site, whatever lane the event uses.
+	 * They are also sent again on every new connection. Can be called before Start().
+	 */
+	void SendRegistration(std::string&& record)
+	{
+		std::lock_guard<std::mutex> lock(_registrationsMutex);
+		MessageFraming::AppendFrame(_registrationFrames, record.data(), record.size());
+	}
+
+	/**
+	 * @brief The depth and the wait-times of the lane since Start().
+	 */
+	MessageQueueStatistics LaneStatistics(MessageLane lane) const
+	{
+		return lane == MessageLane::Control ? _controlLane.Statistics() : _bulkLane.Statistics();
+	}
+
+	/**
+	 * @brief Stops the message-processing thread.
+	 *
+	 * The remaining messages are sent until the timeout is reached. The rest is dropped.
+	 * Every connect and send after Stop() only gets the time that is left until then. (See LimitToShutdownDeadline())
+	 * Only a connect or send that was already running when Stop() was called can take longer, at most transportTimeout.
+	 * So it returns at the latest after timeout + transportTimeout, also when the server does not read anymore or can not be reached.
+	 *
+	 * @param timeout The time to send the remaining messages. Zero to drop them.
+	 * @return The count of messages that were not sent.
+	 */
+	uint64_t Stop(std::chrono::milliseconds timeout)
+	{
+		_shutdownDeadline = MessageBatch::Clock::now() + timeout;
+		_isRunning = false;
+
+		// Get the message-processing thread out of WaitDequeue().
+		_bulkLane.WakeUp();
+
+		uint64_t unsentCount = 0;
+		if (_processMessagesThread.joinable()) {
+			_processMessagesThread.join();
+			unsentCount = _unsentAtShutdown;
+		}
+		return unsentCount;
+	}
+
+private:
+	std::atomic<bool> _isRunning = false;
+	/* Until then the remaining messages are sent when stopping. Set before _isRunning is reset. */
+	MessageBatch::Clock::time_point _shutdownDeadline;
+	/* The count of messages that were not sent when stopping. Set by the message-processing thread before it ends. */
+	uint64_t _unsentAtShutdown = 0;
+	TransportFactory _openTransport;
+	uint32_t _producerId = 0;
+	MessageBatchConfig _batchConfig;
+	std::thread _processMessagesThread;
+	/* The transport to WhatsappTray. Only used from the message-processing thread. */
+	std::unique_ptr<LogTransport> _transport;
+	/* Decides when the server is tried again after a failure. Only used from the message-processing thread. */
+	CircuitBreaker _circuitBreaker;
+	/* The message-buffers. Bounded, so the hook can never let the memory of WhatsApp grow without limit.
+	 * The messages of the control-lane are always sent before the messages of the bulk-lane, so a flood of traces can not delay an error.
+	 * The message-processing thread only sleeps on the bulk-lane. Send() wakes it up for a message of the control-lane. */
+	MessageQueue _controlLane;
+	MessageQueue _bulkLane;
+	/* The buffers of the records. Used by all threads that log and the message-processing thread that returns them after sending. */
+	MessageBufferPool _bufferPool;
+	std::mutex _registrationsMutex;
+	/* The frames of all call-site-registrations. They are sent again on every new connection, because the server may have been restarted and does not know them. */
+	std::string _registrationFrames;
+	/* The size of the part of _registrationFrames that was already sent over the current connection. Only used from the message-processing thread. */
+	size_t _registrationsSentSize = 0;
+
+	/**
+	 * @brief Takes the messages from the buffer and sends them.
+	 *
+	 * Everything that is pending is collected into one batch and sent with one send()-call.
+	 * The batch is sent when it is full or at the latest after the flush-interval, so the latency stays bounded when there is only little traffic.
+	 * While the server can not be reached, the batch is kept and the rest of the messages stay in the buffer. They are sent when the server is reachable again.
+	 */
+	void ProcessMessageQueue()
+	{
+		_transport = _openTransport();
+		_transport->SetTimeout(transportTimeout);
+
+		MessageBatch batch(_batchConfig);
+		std::string item;
+		while (_isRunning) {
+			auto now = MessageBatch::Clock::now();
+			if (batch.ShouldFlush(now) && SendBatch(batch) == false && batch.IsFull()) {
+				// Do not take more messages. So when the buffer is full, the full-policy of the buffer decides which messages are dropped.
+				auto timeout = std::chrono::duration_cast<std::chrono::microseconds>(_circuitBreaker.TimeUntilNextAttempt(MessageBatch::Clock::now()));
+				_bulkLane.WaitForWakeUp(timeout);
+				continue;
+			}
+
+			if (TryTakeMessage(item) == false) {
+				bool hasMessage;
+				if (batch.IsEmpty()) {
+					hasMessage = _bulkLane.WaitDequeue(item);
+				} else {
+					// Wait until the batch has to be sent. While the server can not be reached, wait until the next attempt.
+					// NOTE: The parentheses keep the max-macro of windows.h from expanding.
+					now = MessageBatch::Clock::now();
+					auto timeout = (std::max)(batch.TimeUntilDeadline(now), _circuitBreaker.TimeUntilNextAttempt(now));
+					hasMessage = _bulkLane.WaitDequeueTimed(item, std::chrono::duration_cast<std::chrono::microseconds>(timeout));
+				}
+
+				// Woken up without a message of the bulk-lane, maybe for a message of the control-lane.
+				if (hasMessage == false) {
+					continue;
+				}
+			}
+
+			// Take everything that is pending without waiting.
+			do {
+				batch.Add(item, MessageBatch::Clock::now());
+				_bufferPool.Return(std::move(item));
+			} while (batch.IsFull() == false && TryTakeMessage(item));
+		}
+
+		AddLaneStatisticsRecord(batch);
+
+		// Send what fits into the time until the shutdown-deadline. Give up as soon as the server can not be reached.
+		bool isReachable = true;
+		while (isReachable) {
+			while (batch.IsFull() == false && TryTakeMessage(item)) {
+				batch.Add(item, MessageBatch::Clock::now());
+				_bufferPool.Return(std::move(item));
+			}
+
+			if (batch.IsEmpty() || MessageBatch::Clock::now() >= _shutdownDeadline) {
+				break;
+			}
+
+			isReachable = SendBatch(batch);
+		}
+		_unsentAtShutdown = batch.MessageCount() + _controlLane.Size() + _bulkLane.Size() + _controlLane.TakeDroppedCount() + _bulkLane.TakeDroppedCount();
+
+		_transport->Close();
+		_transport.reset();
+	}
+
+	/**
+	 * @brief Takes the next message without waiting. Strict priority: A message of the bulk-lane is only taken when the control-lane is empty.
+	 *
+	 * The control-lane only carries a few messages, so it can not starve the bulk-lane.
+	 */
+	bool TryTakeMessage(std::string& message)
+	{
+		return _controlLane.TryDequeue(message) || _bulkLane.TryDequeue(message);
+	}
+
+	/**
+	 * @brief Sends the batch over the transport and clears the batch.
+	 *
+	 * If there is no connection yet, or the connection was lost, a new connection is established.
+	 * @return False if the server can not be reached. The batch is kept in that case, so it can be sent later.
+	 */
+	bool SendBatch(MessageBatch& batch)
+	{
+		if (_circuitBreaker.AllowAttempt(MessageBatch::Clock::now()) == false) {
+			return false;
+		}
+
+		AddDroppedMessagesRecord(batch);
+
+		// Try twice, because the server may have closed the old connection in the meantime.
+		for (int attempt = 0; attempt < 2; attempt++) {
+			if (_transport->IsConnected() == false) {
+				if (LimitToShutdownDeadline() == false || _transport->Connect() == false) {
+					break;
+				}
+
+				// The server of the new connection may not know the call-sites yet.
+				_registrationsSentSize = 0;
+			}
+
+			if (SendNewRegistrations() && LimitToShutdownDeadline() && _transport->Send(batch.Data().data(), batch.Data().size())) {
+				_circuitBreaker.OnSuccess();
+				batch.Clear();
+				return true;
+			}
+		}
+
+		_circuitBreaker.OnFailure(MessageBatch::Clock::now());
+		return false;
+	}
+
+	/**
+	 * @brief Sends the registrations that were not sent over the current connection yet.
+	 */
+	bool SendNewRegistrations()
+	{
+		std::string registrationFrames;
+		{
+			std::lock_guard<std::mutex> lock(_registrationsMutex);
+			registrationFrames.assign(_registrationFrames, _registrationsSentSize, std::string::npos);
+		}
+
+		if (registrationFrames.empty()) {
+			return true;
+		}
+
+		if (LimitToShutdownDeadline() == false || _transport->Send(registrationFrames.data(), registrationFrames.size()) == false) {
+			return false;
+		}
+
+		_registrationsSentSize += registrationFrames.size();
+		return true;
+	}
+
+	/**
+	 * @brief While stopping, limits the next connect or send to the time that is left until the shutdown-deadline.
+	 *
+	 * Called before every single connect and send, because one batch can take multiple of them.
+	 * @return False if the shutdown-deadline has passed. Then nothing must be tried anymore.
+	 */
+	bool LimitToShutdownDeadline()
+	{
+		if (_isRunning) {
+			return true;
+		}
+
+		auto now = MessageBatch::Clock::now();
+		if (now >= _shutdownDeadline) {
+			return false;
+		}
+
+		// A timeout of 0 would mean "no timeout", so wait at least 1ms.
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(_shutdownDeadline - now);
+		_transport->SetTimeout((std::max)((std::min)(remaining, transportTimeout), std::chrono::milliseconds(1)));
+		return true;
+	}
+
+	/**
+	 * @brief If messages were dropped since the last batch, adds a record that tells WhatsappTray how many.
+	 */
+	void AddDroppedMessagesRecord(MessageBatch& batch)
+	{
+		auto droppedCount = _controlLane.TakeDroppedCount() + _bulkLane.TakeDroppedCount();
+		if (droppedCount == 0) {
+			return;
+		}
+
+		std::string record;
+		LogRecordWriter::BeginText(record, _producerId);
+		record.append("MessageSender::AddDroppedMessagesRecord: " + std::to_string(droppedCount) + " messages dropped because the message-buffer was full");
+		batch.Add(record, MessageBatch::Clock::now());
+	}
+
+	/**
+	 * @brief Adds a record with the depth and the wait-times of the lanes, so they can be checked in the log of WhatsappTray.
+	 */
+	void AddLaneStatisticsRecord(MessageBatch& batch)
+	{
+		const char* laneNames[] = { "control", "bulk" };
+		MessageLane lanes[] = { MessageLane::Control, MessageLane::Bulk };
+
+		for (int i = 0; i < 2; i++) {
+			auto statistics = LaneStatistics(lanes[i]);
+			if (statistics.dequeuedCount == 0) {
+				continue;
+			}
+
+			char text[256];
+			snprintf(text, sizeof(text), "MessageSender::AddLaneStatisticsRecord: %s-lane: messages=%llu maxDepth=%zu averageWait=%lldus maxWait=%lldus", laneNames[i],
+				static_cast<unsigned long long>(statistics.dequeuedCount), statistics.maxSize,
+				static_cast<long long>(statistics.totalWait.count() / statistics.dequeuedCount), static_cast<long long>(statistics.maxWait.count()));
+
+			std::string record;
+			LogRecordWriter::BeginText(record, _producerId);
+			record.append(text);
+			batch.Add(record, MessageBatch::Clock::now());
+		}
+	}
+};
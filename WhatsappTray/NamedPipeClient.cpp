@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// NamedPipeClient implementation
+
+#include "NamedPipeClient.h"
+
+#include "SharedDefines.h"
+
+#include <algorithm>
+
+#undef MODULE_NAME
+#define MODULE_NAME "NamedPipeClient"
+
+// NOTE: For debugging OutputDebugStringA could be used...
+#define LogDebug(message, ...) //printf(MODULE_NAME "::" __FUNCTION__ " - " message "\n", __VA_ARGS__)
+
+/**
+ * @brief Connects to the named pipe of WhatsappTray.
+ *
+ * @return False if WhatsappTray did not create the pipe. In that case another transport has to be used.
+*/
+bool NamedPipeClient::Open()
+{
+	return Connect();
+}
+
+/**
+ * @brief Writes all frames into the pipe.
+*/
+bool NamedPipeClient::Send(const char data[], size_t size)
+{
+	if (WriteAll(data, size)) {
+		return true;
+	}
+
+	Close();
+	return false;
+}
+
+void NamedPipeClient::Close()
+{
+	if (_pipe != INVALID_HANDLE_VALUE) {
+		CloseHandle(_pipe);
+		_pipe = INVALID_HANDLE_VALUE;
+	}
+	if (_writeEvent != NULL) {
+		CloseHandle(_writeEvent);
+		_writeEvent = NULL;
+	}
+}
+
+bool NamedPipeClient::Connect()
+{
+	if (_pipe != INVALID_HANDLE_VALUE) {
+		return true;
+	}
+
+	// All instances of the pipe can be busy for a short time, while the server creates the next instance.
+	for (int attempt = 0; attempt < 2; attempt++) {
+		// Overlapped, so a write can be given up after the timeout.
+		_pipe = CreateFileA(LOGGER_PIPE_NAME, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+		if (_pipe != INVALID_HANDLE_VALUE) {
+			_writeEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+			if (_writeEvent == NULL) {
+				Close();
+				return false;
+			}
+			return true;
+		}
+
+		auto error = GetLastError();
+		DWORD waitMs = static_cast<DWORD>(std::min<long long>(_timeout.count(), 100));
+		if (error != ERROR_PIPE_BUSY || WaitNamedPipeA(LOGGER_PIPE_NAME, waitMs) == FALSE) {
+			LogDebug("Error occurred while opening the pipe: %ld.", error);
+			return false;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Write all bytes. WriteFile() on a pipe may write only a part of the data, so call it until everything is written.
+ *
+ * All writes together wait at most the timeout. If WhatsappTray does not read anymore, the write is cancelled.
+*/
+bool NamedPipeClient::WriteAll(const char data[], size_t size)
+{
+	auto deadline = std::chrono::steady_clock::now() + _timeout;
+	size_t bytesWrittenTotal = 0;
+	while (bytesWrittenTotal < size) {
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = _writeEvent;
+
+		if (WriteFile(_pipe, data + bytesWrittenTotal, static_cast<DWORD>(size - bytesWrittenTotal), NULL, &overlapped) == FALSE) {
+			if (GetLastError() != ERROR_IO_PENDING) {
+				LogDebug("Error occurred while writing to the pipe: %ld.", GetLastError());
+				return false;
+			}
+
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			DWORD waitMs = remaining.count() > 0 ? static_cast<DWORD>(remaining.count()) : 0;
+			if (WaitForSingleObject(_writeEvent, waitMs) != WAIT_OBJECT_0) {
+				LogDebug("Writing to the pipe timed out.");
+				// The OVERLAPPED is on the stack, so wait until the cancelled write is really done.
+				DWORD ignored = 0;
+				CancelIo(_pipe);
+				GetOverlappedResult(_pipe, &overlapped, &ignored, TRUE);
+				return false;
+			}
+		}
+
+		DWORD bytesWritten = 0;
+		if (GetOverlappedResult(_pipe, &overlapped, &bytesWritten, FALSE) == FALSE) {
+			LogDebug("Error occurred while writing to the pipe: %ld.", GetLastError());
+			return false;
+		}
+
+		bytesWrittenTotal += bytesWritten;
+	}
+
+	return true;
+}
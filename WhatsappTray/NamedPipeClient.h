@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// NamedPipeClient header
+// Sends the log-messages of the hook over the named pipe of WhatsappTray.
+
+#pragma once
+
+#include "LogTransport.h"
+
+#include <windows.h>
+
+class NamedPipeClient : public LogTransport
+{
+public:
+	bool Open() override;
+	bool Connect() override;
+	bool IsConnected() const override { return _pipe != INVALID_HANDLE_VALUE; }
+	void SetTimeout(std::chrono::milliseconds timeout) override { _timeout = timeout; }
+	bool Send(const char data[], size_t size) override;
+	void Close() override;
+	const char* Name() const override { return "named-pipe"; }
+
+private:
+	/* INVALID_HANDLE_VALUE if there is currently no connection. */
+	HANDLE _pipe = INVALID_HANDLE_VALUE;
+	/* Signaled when the overlapped write is done. Only valid while there is a connection. */
+	HANDLE _writeEvent = NULL;
+	std::chrono::milliseconds _timeout = std::chrono::milliseconds(1000);
+
+	bool WriteAll(const char data[], size_t size);
+};
@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Implementation for the named-pipe server.
+// Every hooked process connects to its own instance of the pipe. All instances use overlapped I/O, so one thread waits for all of them.
+
+#include "stdafx.h"
+#include "NamedPipeServer.h"
+
+#include "SharedDefines.h"
+
+#include <algorithm>
+#include "Logger.h"
+
+#undef MODULE_NAME
+#define MODULE_NAME "NamedPipeServer"
+
+/* WaitForMultipleObjects() can wait for this many instances. One handle is needed for the stop-event. */
+constexpr size_t maxPipeInstances = MAXIMUM_WAIT_OBJECTS - 1;
+
+NamedPipeServer::NamedPipeServer()
+{
+	_stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+}
+
+NamedPipeServer::~NamedPipeServer()
+{
+	if (_stopEvent != NULL) {
+		CloseHandle(_stopEvent);
+	}
+}
+
+/**
+ * @brief Creates the pipe and reads from all connected hooks until Stop() is called.
+*/
+bool NamedPipeServer::Run()
+{
+	if (_stopEvent == NULL || CreateListeningInstance() == false) {
+		return false;
+	}
+
+	std::vector<HANDLE> waitHandles;
+	while (_isRunning) {
+		waitHandles.clear();
+		waitHandles.push_back(_stopEvent);
+		for (auto& instance : _instances) {
+			waitHandles.push_back(instance->overlapped.hEvent);
+		}
+
+		auto waitResult = WaitForMultipleObjects(static_cast<DWORD>(waitHandles.size()), waitHandles.data(), FALSE, INFINITE);
+		if (waitResult == WAIT_FAILED) {
+			LogDebug("Error occurred while waiting for the pipe: %ld.", GetLastError());
+			break;
+		}
+
+		if (waitResult == WAIT_OBJECT_0) {
+			continue;
+		}
+
+		// WaitForMultipleObjects() only reports the lowest signaled index. Service every signaled instance, so a hook that writes all the time can not starve the hooks behind it.
+		for (auto it = _instances.begin(); it != _instances.end();) {
+			auto& instance = **it;
+			if (WaitForSingleObject(instance.overlapped.hEvent, 0) != WAIT_OBJECT_0) {
+				++it;
+				continue;
+			}
+
+			if (HandleCompletion(instance) == false) {
+				LogDebug("Close instance of the pipe.");
+				CloseInstance(instance);
+				it = _instances.erase(it);
+				continue;
+			}
+			++it;
+		}
+
+		// There always has to be one instance that waits for the next hook.
+		bool hasListeningInstance = std::any_of(_instances.begin(), _instances.end(), [](const std::unique_ptr<PipeInstance>& instance) {
+			return instance->isConnected == false;
+		});
+		if (hasListeningInstance == false && _instances.size() < maxPipeInstances) {
+			CreateListeningInstance();
+		}
+	}
+
+	for (auto& instance : _instances) {
+		CloseInstance(*instance);
+	}
+	_instances.clear();
+
+	return true;
+}
+
+void NamedPipeServer::Stop()
+{
+	_isRunning = false;
+	if (_stopEvent != NULL) {
+		SetEvent(_stopEvent);
+	}
+}
+
+/**
+ * @brief Creates a new instance of the pipe and waits for a hook to connect to it.
+*/
+bool NamedPipeServer::CreateListeningInstance()
+{
+	auto instance = std::make_unique<PipeInstance>();
+	instance->readBuffer.resize(16 * 1024);
+
+	// PIPE_REJECT_REMOTE_CLIENTS, because the log-messages only come from the hooked processes on this machine.
+	instance->pipe = CreateNamedPipeA(LOGGER_PIPE_NAME, PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		PIPE_UNLIMITED_INSTANCES, 0, 64 * 1024, 0, NULL);
+	if (instance->pipe == INVALID_HANDLE_VALUE) {
+		LogDebug("Error occurred while creating the pipe: %ld.", GetLastError());
+		return false;
+	}
+
+	// Overlapped I/O needs a manual-reset event.
+	instance->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (instance->overlapped.hEvent == NULL) {
+		CloseInstance(*instance);
+		return false;
+	}
+
+	if (ConnectNamedPipe(instance->pipe, &instance->overlapped) == FALSE) {
+		auto error = GetLastError();
+		if (error == ERROR_PIPE_CONNECTED) {
+			// The hook connected between CreateNamedPipeA() and ConnectNamedPipe(). In that case the event is not signaled.
+			instance->isConnected = true;
+			if (StartRead(*instance) == false) {
+				CloseInstance(*instance);
+				return false;
+			}
+		} else if (error != ERROR_IO_PENDING) {
+			LogDebug("Error occurred while waiting for a connection: %ld.", error);
+			CloseInstance(*instance);
+			return false;
+		}
+	}
+
+	_instances.push_back(std::move(instance));
+	return true;
+}
+
+/**
+ * @brief Handles the completed ConnectNamedPipe() or ReadFile() and starts the next read.
+ *
+ * @return False if the instance should be closed, for example because the hook closed the connection.
+*/
+bool NamedPipeServer::HandleCompletion(PipeInstance& instance)
+{
+	DWORD bytesRead = 0;
+	BOOL success = GetOverlappedResult(instance.pipe, &instance.overlapped, &bytesRead, FALSE);
+
+	if (instance.isConnected == false) {
+		if (success == FALSE) {
+			return false;
+		}
+
+		LogDebug("Client connected.");
+		instance.isConnected = true;
+		return StartRead(instance);
+	}
+
+	if (success == FALSE) {
+		// ERROR_BROKEN_PIPE means the hook closed the connection.
+		return false;
+	}
+
+	instance.frameReader.Append(instance.readBuffer.data(), bytesRead);
+
+	std::string messageFromClient;
+	while (instance.frameReader.NextFrame(messageFromClient)) {
+		ForwardRecord(messageFromClient);
+	}
+
+	if (instance.frameReader.HasError()) {
+		LogDebug("Received invalid frame.");
+		return false;
+	}
+
+	return StartRead(instance);
+}
+
+/**
+ * @brief Starts the next overlapped read. Its completion signals the event of the instance, also when it completes immediately.
+*/
+bool NamedPipeServer::StartRead(PipeInstance& instance)
+{
+	if (ReadFile(instance.pipe, instance.readBuffer.data(), static_cast<DWORD>(instance.readBuffer.size()), NULL, &instance.overlapped) == FALSE) {
+		auto error = GetLastError();
+		if (error != ERROR_IO_PENDING) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void NamedPipeServer::CloseInstance(PipeInstance& instance)
+{
+	if (instance.pipe != INVALID_HANDLE_VALUE) {
+		// The OVERLAPPED must not be freed while an operation is still pending, so wait for the cancellation.
+		if (HasOverlappedIoCompleted(&instance.overlapped) == FALSE) {
+			DWORD bytesTransferred = 0;
+			CancelIo(instance.pipe);
+			GetOverlappedResult(instance.pipe, &instance.overlapped, &bytesTransferred, TRUE);
+		}
+		DisconnectNamedPipe(instance.pipe);
+		CloseHandle(instance.pipe);
+		instance.pipe = INVALID_HANDLE_VALUE;
+	}
+	if (instance.overlapped.hEvent != NULL) {
+		CloseHandle(instance.overlapped.hEvent);
+		instance.overlapped.hEvent = NULL;
+	}
+}
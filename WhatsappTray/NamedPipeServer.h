@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+#pragma once
+
+#include "LogServer.h"
+#include "MessageFraming.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class NamedPipeServer : public LogServer
+{
+public:
+	NamedPipeServer();
+	~NamedPipeServer();
+
+	bool Run() override;
+	void Stop() override;
+
+private:
+	struct PipeInstance
+	{
+		HANDLE pipe = INVALID_HANDLE_VALUE;
+		/* The pending ConnectNamedPipe() or ReadFile(). */
+		OVERLAPPED overlapped{};
+		bool isConnected = false;
+		FrameReader frameReader;
+		std::vector<char> readBuffer;
+	};
+
+	/* Only reset by Stop(), so a Stop() before Run() is not lost. */
+	std::atomic<bool> _isRunning = true;
+	HANDLE _stopEvent = NULL;
+	/* One instance per connected hook and one that waits for the next hook. Only used from the pipe-thread. */
+	std::vector<std::unique_ptr<PipeInstance>> _instances;
+
+	bool CreateListeningInstance();
+	bool HandleCompletion(PipeInstance& instance);
+	bool StartRead(PipeInstance& instance);
+	static void CloseInstance(PipeInstance& instance);
+};
@@ -0,0 +1,118 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The few differences between Winsock and the BSD-sockets of Linux, that TcpClient and WinSockServer need.
+// So both also build on Linux and the TCP-transport can be tested and benchmarked there. (See tests/ and benchmarks/)
+// NOTE: On Windows this includes winsock2.h, which has to be included before windows.h
+//       WhatsappTray includes windows.h without WIN32_LEAN_AND_MEAN, which already includes the old winsock.h. Then that one is used.
+
+#pragma once
+
+#include <chrono>
+
+#ifdef _WIN32
+
+#ifndef _WINSOCKAPI_
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+/* winsock.h has everything else that is used here. */
+typedef int socklen_t;
+#endif
+
+#pragma comment(lib, "ws2_32.lib")
+
+/* send() must not raise a signal when the connection was closed. Winsock never does that. */
+constexpr int socketSendFlags = 0;
+
+inline int LastSocketError() { return WSAGetLastError(); }
+
+/**
+ * @brief True if the error of a non-blocking connect() only means that the connection is not established yet.
+ */
+inline bool IsConnectPending(int error) { return error == WSAEWOULDBLOCK; }
+
+/**
+ * @brief True if the error of a non-blocking accept() or recv() only means that there is nothing to get right now.
+ */
+inline bool IsWouldBlock(int error) { return error == WSAEWOULDBLOCK; }
+
+/**
+ * @brief True if the error of recvfrom() only affects one datagram, so the next one can be received.
+ */
+inline bool IsDatagramError(int error) { return error == WSAECONNRESET || error == WSAEMSGSIZE; }
+
+/**
+ * @brief The first parameter of select(). Winsock ignores it.
+ */
+inline int SelectSocketCount(SOCKET /*socket*/) { return 0; }
+
+inline bool StartupSockets()
+{
+	WSADATA wsaData;
+	return WSAStartup(MAKEWORD(2, 2), &wsaData) == NO_ERROR;
+}
+
+inline void CleanupSockets() { WSACleanup(); }
+
+inline bool SetSocketNonBlocking(SOCKET socket, bool nonBlocking)
+{
+	u_long value = nonBlocking ? 1 : 0;
+	return ioctlsocket(socket, FIONBIO, &value) != SOCKET_ERROR;
+}
+
+inline void SetSocketSendTimeout(SOCKET socket, std::chrono::milliseconds timeout)
+{
+	DWORD timeoutMs = static_cast<DWORD>(timeout.count());
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeoutMs), sizeof(timeoutMs));
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+
+constexpr int socketSendFlags = MSG_NOSIGNAL;
+
+inline int closesocket(SOCKET socket) { return close(socket); }
+
+inline int LastSocketError() { return errno; }
+
+inline bool IsConnectPending(int error) { return error == EINPROGRESS; }
+
+inline bool IsWouldBlock(int error) { return error == EWOULDBLOCK || error == EAGAIN; }
+
+inline bool IsDatagramError(int error) { return error == ECONNREFUSED || error == EINTR; }
+
+inline int SelectSocketCount(SOCKET socket) { return socket + 1; }
+
+inline bool StartupSockets() { return true; }
+
+inline void CleanupSockets() { }
+
+inline bool SetSocketNonBlocking(SOCKET socket, bool nonBlocking)
+{
+	int flags = fcntl(socket, F_GETFL, 0);
+	return flags != -1 && fcntl(socket, F_SETFL, nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) != -1;
+}
+
+inline void SetSocketSendTimeout(SOCKET socket, std::chrono::milliseconds timeout)
+{
+	timeval value;
+	value.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+	value.tv_usec = static_cast<suseconds_t>((timeout.count() % 1000) * 1000);
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &value, sizeof(value));
+}
+
+#endif
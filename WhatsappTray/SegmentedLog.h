@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The log-file as a row of memory-mapped segments. (See LogSegment.h)
+// Appending a line only takes a shared lock, so all threads append to the current segment at the same time.
+// When the segment is full, the thread that noticed it takes the exclusive lock and opens the next one. The other threads wait for it and then continue in the new segment.
+// The mapped file is a template-parameter, so the roll-over is the same for MappedLogFile on Windows and for the mmap() stand-in of the test and the benchmark on Linux.
+// NOTE: This file must not depend on windows.h so it also builds on Linux.
+
+#pragma once
+
+#include <stddef.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+/**
+ * @tparam MappedFile Has TryAppend(const char*, size_t) and Flush(). Seals the segment when it is closed or destroyed.
+ */
+template<typename MappedFile>
+class SegmentedLog
+{
+public:
+	/**
+	 * Opens the next segment in the file-object, which first closes and seals the full one. The segment has to have room for at least minimumSize bytes.
+	 * Called while the exclusive lock is held, so no line is appended meanwhile.
+	 * @return False if the segment could not be opened. Then SegmentedLog has no segment anymore.
+	 */
+	using OpenSegmentFunction = std::function<bool(MappedFile& file, size_t minimumSize)>;
+
+	explicit SegmentedLog(const OpenSegmentFunction& openSegment) : _openSegment(openSegment) { }
+
+	/**
+	 * @brief Appends the line to the current segment and opens the next one when it is full.
+	 *
+	 * Can be called from multiple threads at the same time.
+	 * @return False if there is no segment. Then the line was not written.
+	 */
+	bool Append(const char* text, size_t length)
+	{
+		{
+			std::shared_lock<std::shared_mutex> lock(_mutex);
+			if (_file == nullptr) {
+				return false;
+			}
+			if (_file->TryAppend(text, length)) {
+				return true;
+			}
+		}
+
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		// Another thread may already have replaced the full segment.
+		if (_file != nullptr && _file->TryAppend(text, length)) {
+			return true;
+		}
+		if (_file == nullptr || OpenNextSegment(length) == false) {
+			return false;
+		}
+		return _file->TryAppend(text, length);
+	}
+
+	/**
+	 * @brief Seals the current segment, if there is one, and opens the next one.
+	 *
+	 * @return False if the segment could not be opened.
+	 */
+	bool Open()
+	{
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		return OpenNextSegment(0);
+	}
+
+	/**
+	 * @brief Seals the current segment and opens the next one, if the current one was opened before maxAge.
+	 */
+	void RotateIfOlderThan(std::chrono::steady_clock::duration maxAge)
+	{
+		{
+			std::shared_lock<std::shared_mutex> lock(_mutex);
+			if (_file == nullptr || std::chrono::steady_clock::now() - _openTime < maxAge) {
+				return;
+			}
+		}
+
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		if (_file == nullptr || std::chrono::steady_clock::now() - _openTime < maxAge) {
+			return;
+		}
+		OpenNextSegment(0);
+	}
+
+	/**
+	 * @return False if there is no segment.
+	 */
+	bool Flush()
+	{
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		if (_file == nullptr) {
+			return false;
+		}
+		_file->Flush();
+		return true;
+	}
+
+	/**
+	 * @brief Seals the current segment. Append() fails afterwards.
+	 */
+	void Close()
+	{
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		_file.reset();
+	}
+
+private:
+	OpenSegmentFunction _openSegment;
+	/* Shared while a line is appended. Exclusive while the full segment is replaced. */
+	std::shared_mutex _mutex;
+	std::unique_ptr<MappedFile> _file;
+	std::chrono::steady_clock::time_point _openTime;
+
+	/**
+	 * NOTE: _mutex has to be locked exclusively.
+	 */
+	bool OpenNextSegment(size_t minimumSize)
+	{
+		if (_file == nullptr) {
+			_file = std::make_unique<MappedFile>();
+		}
+		if (_openSegment(*_file, minimumSize) == false) {
+			_file.reset();
+			return false;
+		}
+		_openTime = std::chrono::steady_clock::now();
+		return true;
+	}
+};
@@ -12,6 +12,16 @@
 // What port to use: https://stackoverflow.com/a/53667220/4870255
 // Ports 49152 - 65535 - Free to use these in client programs
 #define LOGGER_PORT "52677"
+// NOTE: The high-volume traces of the hook are sent as UDP-datagrams to the same port. (See TraceDatagram.h)
+// Alternative to the socket: A ring-buffer in shared memory. It is used by the hook when WhatsappTray created it. (WhatsappTray started with --sharedMemoryLogging)
+#define LOGGER_SHARED_MEMORY_NAME "Local\\WhatsappTrayLoggerRing"
+#define LOGGER_SHARED_MEMORY_EVENT_NAME "Local\\WhatsappTrayLoggerRingEvent" /* Signaled by the hook after it wrote into the ring */
+#define LOGGER_SHARED_MEMORY_MUTEX_NAME "Local\\WhatsappTrayLoggerRingWriter" /* The ring only supports one writer, but there can be multiple hooked processes */
+#define LOGGER_SHARED_MEMORY_RING_CAPACITY (1024 * 1024)
+// Alternative to the socket: A named pipe. It is used by the hook when WhatsappTray created it. (WhatsappTray started with --namedPipeLogging)
+#define LOGGER_PIPE_NAME "\\\\.\\pipe\\WhatsappTrayLogger"
+// The level of the log-messages that the hook creates. Set by WhatsappTray. (See LogControl.h)
+#define LOGGER_CONTROL_NAME "Local\\WhatsappTrayLoggerControl"
 
 #define WM_WA_MINIMIZE_BUTTON_PRESSED  0x0401 /* The minimize-button in WhatsApp was pressed */
 #define WM_WA_CLOSE_BUTTON_PRESSED  0x0402 /* The close-button in WhatsApp was pressed (X) */
@@ -30,10 +40,12 @@
 #define IDM_SETTING_START_MINIMIZED   0x1007
 #define IDM_SETTING_SHOW_UNREAD_MESSAGES   0x1008
 #define IDM_SETTING_CLOSE_TO_TRAY_WITH_ESCAPE   0x1009
+#define IDM_SAVE_FLIGHT_RECORDER   0x100A
+#define IDM_HOOK_LOG_LEVEL_FIRST   0x1010 /* IDM_HOOK_LOG_LEVEL_FIRST + HookLogLevel selects the level of the hook. Uses the ids up to 0x1014. */
+
+#include "LogFormat.h"
 
-#include <memory>
 #include <string>
-#include <stdexcept>
 
 /**
  * @brief 
@@ -43,9 +55,8 @@
 template<typename ... Args>
 std::string string_format(const std::string& format, Args ... args)
 {
-    size_t size = snprintf(nullptr, 0, format.c_str(), args ...) + 1ll; // '1 + ' because extra space for '\0'
-    if (size <= 0) { throw std::runtime_error("Error during formatting."); }
-    std::unique_ptr<char[]> buf(new char[size]);
-    snprintf(buf.get(), size, format.c_str(), args ...);
-    return std::string(buf.get(), buf.get() + size - 1); // We don't want the '\0' inside
+	// Formats only once and only uses the heap for the result, unless the text is very long. (See LogFormat.h)
+	LogFormatBuffer buffer;
+	buffer.AppendFormat(format.c_str(), args ...);
+	return buffer.ToString();
 }
\ No newline at end of file
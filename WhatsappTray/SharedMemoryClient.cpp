@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// SharedMemoryClient implementation
+
+#include "SharedMemoryClient.h"
+
+#include "SharedDefines.h"
+
+#include <algorithm>
+
+#undef MODULE_NAME
+#define MODULE_NAME "SharedMemoryClient"
+
+// NOTE: For debugging OutputDebugStringA could be used...
+#define LogDebug(message, ...) //printf(MODULE_NAME "::" __FUNCTION__ " - " message "\n", __VA_ARGS__)
+
+/**
+ * @brief Opens the shared-memory ring of WhatsappTray.
+ *
+ * @return False if WhatsappTray did not create the ring. In that case another transport has to be used.
+*/
+bool SharedMemoryClient::Open()
+{
+	_fileMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, LOGGER_SHARED_MEMORY_NAME);
+	if (_fileMapping == NULL) {
+		LogDebug("Shared memory '" LOGGER_SHARED_MEMORY_NAME "' not found.");
+		return false;
+	}
+
+	_memory = MapViewOfFile(_fileMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	_dataWrittenEvent = OpenEventA(EVENT_MODIFY_STATE, FALSE, LOGGER_SHARED_MEMORY_EVENT_NAME);
+	_writerMutex = OpenMutexA(SYNCHRONIZE, FALSE, LOGGER_SHARED_MEMORY_MUTEX_NAME);
+
+	if (_memory == NULL || _dataWrittenEvent == NULL || _writerMutex == NULL || _ring.Attach(_memory, SharedMemoryRing::RequiredMemorySize(LOGGER_SHARED_MEMORY_RING_CAPACITY)) == false) {
+		LogDebug("Opening the shared memory failed.");
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Opens the ring again after sending failed.
+ *
+ * When WhatsappTray was restarted, this gets the ring of the new instance. If WhatsappTray is not running, the ring does not exist anymore.
+*/
+bool SharedMemoryClient::Connect()
+{
+	if (_memory != NULL) {
+		return true;
+	}
+
+	return Open();
+}
+
+/**
+ * @brief Writes the data into the ring and wakes up WhatsappTray.
+ *
+ * A full ring is normal during a burst. Like send() with a full socket-buffer, it waits up to the timeout until WhatsappTray made room.
+ * The ring stays open in any case. A restarted WhatsappTray opens the same ring again, because this process still holds it.
+ * @return False if the ring stays full or another hooked process blocks it. Nothing is written in that case.
+*/
+bool SharedMemoryClient::Send(const char data[], size_t size)
+{
+	auto deadline = std::chrono::steady_clock::now() + _timeout;
+	while (true) {
+		// Wait only a short time. If another hooked process holds the mutex for longer, something is wrong and it is better to drop the messages.
+		auto waitResult = WaitForSingleObject(_writerMutex, static_cast<DWORD>(std::min<long long>(_timeout.count(), 100)));
+		if (waitResult != WAIT_OBJECT_0 && waitResult != WAIT_ABANDONED) {
+			return false;
+		}
+
+		bool success = _ring.Write(data, size);
+		ReleaseMutex(_writerMutex);
+
+		// Also wakes up WhatsappTray when the ring is full, in case the last signal was missed.
+		SetEvent(_dataWrittenEvent);
+		if (success) {
+			return true;
+		}
+		if (size > _ring.Capacity() || std::chrono::steady_clock::now() >= deadline) {
+			LogDebug("The ring is full.");
+			return false;
+		}
+		Sleep(1);
+	}
+}
+
+void SharedMemoryClient::Close()
+{
+	if (_memory != NULL) {
+		UnmapViewOfFile(_memory);
+		_memory = NULL;
+	}
+	if (_fileMapping != NULL) {
+		CloseHandle(_fileMapping);
+		_fileMapping = NULL;
+	}
+	if (_dataWrittenEvent != NULL) {
+		CloseHandle(_dataWrittenEvent);
+		_dataWrittenEvent = NULL;
+	}
+	if (_writerMutex != NULL) {
+		CloseHandle(_writerMutex);
+		_writerMutex = NULL;
+	}
+}
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// SharedMemoryClient header
+// Writes the log-messages of the hook into the shared-memory ring created by WhatsappTray.
+
+#pragma once
+
+#include "LogTransport.h"
+#include "SharedMemoryRing.h"
+
+#include <windows.h>
+
+class SharedMemoryClient : public LogTransport
+{
+public:
+	bool Open() override;
+	bool Connect() override;
+	bool IsConnected() const override { return _memory != NULL; }
+	void SetTimeout(std::chrono::milliseconds timeout) override { _timeout = timeout; }
+	bool Send(const char data[], size_t size) override;
+	void Close() override;
+	const char* Name() const override { return "shared-memory"; }
+
+private:
+	HANDLE _fileMapping = NULL;
+	void* _memory = NULL;
+	HANDLE _dataWrittenEvent = NULL;
+	HANDLE _writerMutex = NULL;
+	SharedMemoryRing _ring;
+	std::chrono::milliseconds _timeout = std::chrono::milliseconds(1000);
+};
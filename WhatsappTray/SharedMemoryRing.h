@@ -0,0 +1,195 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Lock-free single-producer/single-consumer ring buffer for bytes, that lives in a memory-block shared by two processes.
+// The hook writes the frames of its log-messages into the ring and WhatsappTray reads them.
+// NOTE: This file only works on the memory it gets and must not depend on windows.h, so it also builds on Linux.
+
+#pragma once
+
+#include "MessageFraming.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+class SharedMemoryRing
+{
+public:
+	static constexpr uint32_t ringMagic = 0x57415452; // "WATR"
+
+	struct Header
+	{
+		uint32_t magic;
+		/* Size of the data-area in bytes. Always a power of two. */
+		uint32_t capacity;
+		/* The positions only grow. The position in the data-area is position & (capacity - 1). They are on seperate cache-lines so writer and reader do not slow each other down. */
+		alignas(64) std::atomic<uint64_t> writePosition;
+		alignas(64) std::atomic<uint64_t> readPosition;
+	};
+
+	static size_t RequiredMemorySize(uint32_t capacity) { return sizeof(Header) + capacity; }
+
+	/**
+	 * @brief Initializes a new, empty ring in the memory-block.
+	 *
+	 * @param capacity The size of the data-area. Has to be a power of two.
+	 */
+	bool Create(void* memory, size_t memorySize, uint32_t capacity)
+	{
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0 || memorySize < RequiredMemorySize(capacity)) {
+			return false;
+		}
+
+		_header = new (memory) Header();
+		_header->capacity = capacity;
+		_header->writePosition = 0;
+		_header->readPosition = 0;
+		_header->magic = ringMagic;
+		_data = static_cast<char*>(memory) + sizeof(Header);
+		return true;
+	}
+
+	/**
+	 * @brief Uses the ring that was already created by the other process in the memory-block.
+	 */
+	bool Attach(void* memory, size_t memorySize)
+	{
+		auto header = static_cast<Header*>(memory);
+		if (memorySize < sizeof(Header) || header->magic != ringMagic || memorySize < RequiredMemorySize(header->capacity)) {
+			return false;
+		}
+
+		_header = header;
+		_data = static_cast<char*>(memory) + sizeof(Header);
+		return true;
+	}
+
+	/**
+	 * @brief Writes all bytes or nothing. Must only be called by the one producer.
+	 *
+	 * @return False if there is not enough free space. Nothing is written in that case.
+	 */
+	bool Write(const char* data, size_t size)
+	{
+		uint64_t writePosition = _header->writePosition.load(std::memory_order_relaxed);
+		uint64_t readPosition = _header->readPosition.load(std::memory_order_acquire);
+
+		if (_header->capacity - (writePosition - readPosition) < size) {
+			return false;
+		}
+
+		CopyToRing(writePosition, data, size);
+		_header->writePosition.store(writePosition + size, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Reads up to bufferSize of the available bytes. Must only be called by the one consumer.
+	 *
+	 * @return The count of bytes that were read.
+	 */
+	size_t Read(char* buffer, size_t bufferSize)
+	{
+		uint64_t readPosition = _header->readPosition.load(std::memory_order_relaxed);
+		uint64_t writePosition = _header->writePosition.load(std::memory_order_acquire);
+
+		size_t size = static_cast<size_t>(writePosition - readPosition);
+		if (size > bufferSize) {
+			size = bufferSize;
+		}
+
+		CopyFromRing(readPosition, buffer, size);
+		_header->readPosition.store(readPosition + size, std::memory_order_release);
+		return size;
+	}
+
+	/**
+	 * @brief Drops all available bytes. Must only be called by the one consumer.
+	 *
+	 * @return The count of the dropped bytes.
+	 */
+	size_t SkipToWritePosition()
+	{
+		uint64_t readPosition = _header->readPosition.load(std::memory_order_relaxed);
+		uint64_t writePosition = _header->writePosition.load(std::memory_order_acquire);
+
+		_header->readPosition.store(writePosition, std::memory_order_release);
+		return static_cast<size_t>(writePosition - readPosition);
+	}
+
+	size_t UsedBytes() const
+	{
+		return static_cast<size_t>(_header->writePosition.load(std::memory_order_acquire) - _header->readPosition.load(std::memory_order_acquire));
+	}
+
+	uint32_t Capacity() const { return _header->capacity; }
+
+private:
+	Header* _header = nullptr;
+	char* _data = nullptr;
+
+	void CopyToRing(uint64_t position, const char* data, size_t size)
+	{
+		size_t offset = static_cast<size_t>(position & (_header->capacity - 1));
+		size_t firstPart = size < _header->capacity - offset ? size : _header->capacity - offset;
+		memcpy(_data + offset, data, firstPart);
+		memcpy(_data, data + firstPart, size - firstPart);
+	}
+
+	void CopyFromRing(uint64_t position, char* buffer, size_t size)
+	{
+		size_t offset = static_cast<size_t>(position & (_header->capacity - 1));
+		size_t firstPart = size < _header->capacity - offset ? size : _header->capacity - offset;
+		memcpy(buffer, _data + offset, firstPart);
+		memcpy(buffer + firstPart, _data, size - firstPart);
+	}
+};
+
+/**
+ * @brief Reads the frames out of the ring. Is used by the one consumer.
+ *
+ * A corrupt frame does not stop the reading. The producers only write whole frames, so the write-position is always at the start of a frame.
+ * The reader drops everything up to the write-position and continues there.
+ */
+class SharedMemoryFrameReader
+{
+public:
+	explicit SharedMemoryFrameReader(SharedMemoryRing& ring) : _ring(ring), _readBuffer(64 * 1024) { }
+
+	/**
+	 * @brief Reads everything that is in the ring and calls frameHandler for every complete frame.
+	 *
+	 * @return The count of bytes that were dropped because of a corrupt frame.
+	 */
+	template<typename FrameHandler>
+	size_t ReadFrames(FrameHandler&& frameHandler)
+	{
+		size_t skippedBytes = 0;
+		while (true) {
+			auto bytesRead = _ring.Read(_readBuffer.data(), _readBuffer.size());
+			if (bytesRead == 0) {
+				break;
+			}
+
+			_frameReader.Append(_readBuffer.data(), bytesRead);
+			while (_frameReader.NextFrame(_frame)) {
+				frameHandler(_frame);
+			}
+
+			if (_frameReader.HasError()) {
+				skippedBytes += _frameReader.Reset() + _ring.SkipToWritePosition();
+			}
+		}
+		return skippedBytes;
+	}
+
+private:
+	SharedMemoryRing& _ring;
+	FrameReader _frameReader;
+	std::vector<char> _readBuffer;
+	std::string _frame;
+};
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Implementation for the shared-memory server.
+// Creates the ring-buffer in shared memory and reads the log-messages that the hook writes into it.
+
+#include "stdafx.h"
+#include "SharedMemoryServer.h"
+
+#include "SharedDefines.h"
+
+#include "Logger.h"
+
+#undef MODULE_NAME
+#define MODULE_NAME "SharedMemoryServer"
+
+SharedMemoryServer::SharedMemoryServer()
+{
+	_stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+}
+
+SharedMemoryServer::~SharedMemoryServer()
+{
+	if (_stopEvent != NULL) {
+		CloseHandle(_stopEvent);
+	}
+}
+
+/**
+ * @brief Creates the ring and reads from it until Stop() is called.
+ *
+ * Should run in its own thread. The hook signals the event after it wrote into the ring.
+*/
+bool SharedMemoryServer::Run()
+{
+	if (_stopEvent == NULL || SetupSharedMemory() == false) {
+		CleanupSharedMemory();
+		return false;
+	}
+
+	SharedMemoryFrameReader frameReader(_ring);
+	HANDLE waitHandles[] = { _stopEvent, _dataWrittenEvent };
+	while (_isRunning) {
+		// Use a timeout so nothing gets stuck if the hook crashed between writing and signaling.
+		if (WaitForMultipleObjects(2, waitHandles, FALSE, 1000) == WAIT_OBJECT_0) {
+			continue;
+		}
+
+		ReadRing(frameReader);
+	}
+
+	CleanupSharedMemory();
+	return true;
+}
+
+/**
+ * @brief Lets Run() return. Can be called from any thread.
+ *
+ * Only uses the stop-event. The event of the ring may be closed by the server-thread at the same time.
+*/
+void SharedMemoryServer::Stop()
+{
+	_isRunning = false;
+	if (_stopEvent != NULL) {
+		SetEvent(_stopEvent);
+	}
+}
+
+bool SharedMemoryServer::SetupSharedMemory()
+{
+	auto memorySize = SharedMemoryRing::RequiredMemorySize(LOGGER_SHARED_MEMORY_RING_CAPACITY);
+
+	_fileMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(memorySize), LOGGER_SHARED_MEMORY_NAME);
+	if (_fileMapping == NULL) {
+		LogDebug("Error occurred while creating the file-mapping: %ld.", GetLastError());
+		return false;
+	}
+
+	_memory = MapViewOfFile(_fileMapping, FILE_MAP_ALL_ACCESS, 0, 0, memorySize);
+	if (_memory == NULL) {
+		LogDebug("Error occurred while mapping the shared memory: %ld.", GetLastError());
+		return false;
+	}
+
+	_dataWrittenEvent = CreateEventA(NULL, FALSE, FALSE, LOGGER_SHARED_MEMORY_EVENT_NAME);
+	_writerMutex = CreateMutexA(NULL, FALSE, LOGGER_SHARED_MEMORY_MUTEX_NAME);
+	if (_dataWrittenEvent == NULL || _writerMutex == NULL) {
+		LogDebug("Error occurred while creating the event or mutex: %ld.", GetLastError());
+		return false;
+	}
+
+	return _ring.Create(_memory, memorySize, LOGGER_SHARED_MEMORY_RING_CAPACITY);
+}
+
+void SharedMemoryServer::CleanupSharedMemory()
+{
+	if (_memory != NULL) {
+		UnmapViewOfFile(_memory);
+		_memory = NULL;
+	}
+	if (_fileMapping != NULL) {
+		CloseHandle(_fileMapping);
+		_fileMapping = NULL;
+	}
+	if (_dataWrittenEvent != NULL) {
+		CloseHandle(_dataWrittenEvent);
+		_dataWrittenEvent = NULL;
+	}
+	if (_writerMutex != NULL) {
+		CloseHandle(_writerMutex);
+		_writerMutex = NULL;
+	}
+}
+
+/**
+ * @brief Read everything that is in the ring and forward all complete frames.
+ *
+ * After a corrupt frame the reader continues at the write-position, so one broken hook does not stop the logging of all others.
+*/
+void SharedMemoryServer::ReadRing(SharedMemoryFrameReader& frameReader)
+{
+	auto skippedBytes = frameReader.ReadFrames([this](const std::string& record) { ForwardRecord(record); });
+	if (skippedBytes > 0) {
+		_skippedByteCount += skippedBytes;
+		LogDebug("Received invalid frame. Skipped %zu bytes of the ring. (%llu bytes in total)", skippedBytes, _skippedByteCount);
+		ForwardLine("<" + std::to_string(skippedBytes) + " bytes of the shared-memory-ring skipped because of an invalid frame>", 0);
+	}
+}
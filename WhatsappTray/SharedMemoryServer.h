@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+#pragma once
+
+#include "LogServer.h"
+#include "SharedMemoryRing.h"
+#include "MessageFraming.h"
+
+#include <atomic>
+
+class SharedMemoryServer : public LogServer
+{
+public:
+	SharedMemoryServer();
+	~SharedMemoryServer();
+
+	bool Run() override;
+	void Stop() override;
+
+private:
+	/* Only reset by Stop(), so a Stop() before Run() is not lost. */
+	std::atomic<bool> _isRunning = true;
+	/* Set by Stop(). Lives as long as the server, so Stop() never uses a handle that the server-thread closes. */
+	HANDLE _stopEvent = NULL;
+	/* The handles of the ring are only used and closed by the server-thread. */
+	HANDLE _fileMapping = NULL;
+	void* _memory = NULL;
+	HANDLE _dataWrittenEvent = NULL;
+	HANDLE _writerMutex = NULL;
+	SharedMemoryRing _ring;
+	/* Bytes that were dropped because of invalid frames, since the start. */
+	unsigned long long _skippedByteCount = 0;
+
+	bool SetupSharedMemory();
+	void CleanupSharedMemory();
+	void ReadRing(SharedMemoryFrameReader& frameReader);
+};
@@ -0,0 +1,262 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// TcpClient implementation
+
+#include "TcpClient.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#undef MODULE_NAME
+#define MODULE_NAME "TcpClient"
+
+// NOTE: For debugging OutputDebugStringA could be used...
+#define LogDebug(...) //printf(MODULE_NAME " - " __VA_ARGS__)
+
+/**
+ * @brief Initializes Winsock. The connection is only established when the first batch is sent, so WhatsappTray may also be started later.
+*/
+bool TcpClient::Open()
+{
+	if (StartupSockets() == false) {
+		LogDebug("Error occurred while executing WSAStartup()");
+		return false;
+	}
+
+	LogDebug("WSAStartup() successful");
+
+	return true;
+}
+
+/**
+ * @brief Sends all frames over the persistent connection.
+ *
+ * No answer from the server is expected, so this does not block until the server has processed the messages.
+ * NOTE: A successful send() only means that the data is in the socket-buffer. On a connection that the server already closed, it still succeeds once and the data is lost.
+ *       So the connection is checked before, which finds a connection that was closed while it was idle. Only a server that closes the connection while the batch is on the way can still lose it.
+*/
+bool TcpClient::Send(const char data[], size_t size)
+{
+	if (IsClosedByServer()) {
+		LogDebug("The server closed the connection.");
+		CloseConnection();
+		return false;
+	}
+
+	if (SendAll(data, size)) {
+		return true;
+	}
+
+	CloseConnection();
+	return false;
+}
+
+void TcpClient::Close()
+{
+	CloseConnection();
+
+	// Cleanup Winsock
+	CleanupSockets();
+}
+
+/**
+ * @brief Establish the connection with the server.
+ *
+ * @return True if the connection was sucessfully established.
+*/
+bool TcpClient::Connect()
+{
+	if (_clientSocket != INVALID_SOCKET) {
+		if (IsClosedByServer() == false) {
+			return true;
+		}
+		CloseConnection();
+	}
+
+	_clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	if (INVALID_SOCKET == _clientSocket) {
+		LogDebug("Error occurred while opening socket: %ld.", LastSocketError());
+		return false;
+	}
+	LogDebug("socket() successful.");
+
+	sockaddr_in serverAddress;
+	if (CreateServerAddress(_ipString.c_str(), _portString.c_str(), serverAddress) == false) {
+		CloseConnection();
+		return false;
+	}
+
+	// When nobody listens on the port, connect() takes about 2 seconds on Windows. So connect non-blocking and wait only until the timeout.
+	SetSocketNonBlocking(_clientSocket, true);
+
+	if (SOCKET_ERROR == connect(_clientSocket, reinterpret_cast<const struct sockaddr*>(&serverAddress), sizeof(serverAddress)) && IsConnectPending(LastSocketError()) == false) {
+		LogDebug("Error occurred while connecting: %ld.", LastSocketError());
+		CloseConnection();
+		return false;
+	}
+
+	if (WaitForConnect() == false) {
+		LogDebug("Connecting failed or timed out.");
+		CloseConnection();
+		return false;
+	}
+	LogDebug("connect() successful.");
+
+	SetSocketNonBlocking(_clientSocket, false);
+	SetTimeout(_timeout);
+
+	// The messages are small and nobody waits for an answer, so there is no reason to let Nagle delay them.
+	int noDelay = 1;
+	setsockopt(_clientSocket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+	return true;
+}
+
+/**
+ * @brief Sets the timeout for connect() and send().
+ *
+ * NOTE: After send() timed out, the state of the socket is undefined. That is no problem, because the connection is closed after every failed send.
+*/
+void TcpClient::SetTimeout(std::chrono::milliseconds timeout)
+{
+	_timeout = timeout;
+
+	if (_clientSocket != INVALID_SOCKET) {
+		SetSocketSendTimeout(_clientSocket, timeout);
+	}
+}
+
+/**
+ * @brief Checks without waiting if the server closed or reset the connection.
+ *
+ * The server never sends anything. So when the socket is readable, the connection was closed and recv() returns 0 or an error.
+*/
+bool TcpClient::IsClosedByServer() const
+{
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(_clientSocket, &readSet);
+
+	timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+
+	int readyCount = select(SelectSocketCount(_clientSocket), &readSet, NULL, NULL, &timeout);
+	if (readyCount == 0) {
+		return false;
+	}
+	if (readyCount == SOCKET_ERROR) {
+		return true;
+	}
+
+	// MSG_PEEK leaves unexpected data in the socket.
+	char byte;
+	return recv(_clientSocket, &byte, 1, MSG_PEEK) <= 0;
+}
+
+/**
+ * @brief Waits until the non-blocking connect() is done or the timeout is reached.
+ *
+ * @return True if the connection is established.
+*/
+bool TcpClient::WaitForConnect()
+{
+	fd_set writeSet;
+	FD_ZERO(&writeSet);
+	FD_SET(_clientSocket, &writeSet);
+
+	// Windows reports a failed connect() in the except-set.
+	fd_set exceptSet;
+	FD_ZERO(&exceptSet);
+	FD_SET(_clientSocket, &exceptSet);
+
+	timeval timeout;
+	timeout.tv_sec = static_cast<long>(_timeout.count() / 1000);
+	timeout.tv_usec = static_cast<long>((_timeout.count() % 1000) * 1000);
+
+	if (select(SelectSocketCount(_clientSocket), NULL, &writeSet, &exceptSet, &timeout) <= 0 || FD_ISSET(_clientSocket, &writeSet) == 0) {
+		return false;
+	}
+
+	// Linux reports a failed connect() as writable, so check the result of the connect.
+	int error = 0;
+	socklen_t errorSize = sizeof(error);
+	return getsockopt(_clientSocket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &errorSize) == 0 && error == 0;
+}
+
+/**
+ * @brief Send all bytes. send() may send only a part of the data, so call it until everything is sent.
+ *
+ * SO_SNDTIMEO limits every single send(). All of them together must not take longer than the timeout either, so the later ones only get the time that is left.
+*/
+bool TcpClient::SendAll(const char data[], size_t size)
+{
+	auto deadline = std::chrono::steady_clock::now() + _timeout;
+	bool isTimeoutShortened = false;
+	size_t bytesSentTotal = 0;
+	while (bytesSentTotal < size) {
+		if (bytesSentTotal > 0) {
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			if (remaining <= std::chrono::milliseconds(0)) {
+				LogDebug("Sending timed out.");
+				return false;
+			}
+			SetSocketSendTimeout(_clientSocket, remaining);
+			isTimeoutShortened = true;
+		}
+
+		int nBytesSent = static_cast<int>(send(_clientSocket, data + bytesSentTotal, static_cast<int>(size - bytesSentTotal), socketSendFlags));
+
+		if (SOCKET_ERROR == nBytesSent) {
+			LogDebug("Error occurred while writing to socket: %ld.", LastSocketError());
+			return false;
+		}
+
+		bytesSentTotal += nBytesSent;
+	}
+	LogDebug("send() successful.");
+
+	// The socket is closed after a failed send, so the timeout only has to be reset after a successful one.
+	if (isTimeoutShortened) {
+		SetSocketSendTimeout(_clientSocket, _timeout);
+	}
+
+	return true;
+}
+
+void TcpClient::CloseConnection()
+{
+	if (_clientSocket != INVALID_SOCKET) {
+		closesocket(_clientSocket);
+		_clientSocket = INVALID_SOCKET;
+	}
+}
+
+bool TcpClient::CreateServerAddress(const char ipString[], const char portString[], sockaddr_in& serverAddress)
+{
+	// Get the server details
+	struct hostent* server = gethostbyname(ipString);
+
+	if (server == NULL) {
+		LogDebug("Error occurred no such host.");
+		return false;
+	}
+
+	LogDebug("gethostbyname() successful.");
+
+	int portNumber = atoi(portString);
+
+	// Cleanup and Init the serverAddress with 0
+	memset(&serverAddress, 0, sizeof(serverAddress));
+
+	serverAddress.sin_family = AF_INET;
+
+	// Assign the information received from gethostbyname()
+	memcpy(&serverAddress.sin_addr.s_addr, server->h_addr, server->h_length);
+
+	serverAddress.sin_port = htons(static_cast<unsigned short>(portNumber));
+
+	return true;
+}
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// TcpClient header
+// Sends the log-messages of the hook over a persistent TCP-connection to the WinSockServer of WhatsappTray.
+// NOTE: Only uses the sockets through PortableSocket.h, so it also builds on Linux for the tests and the benchmark.
+
+#pragma once
+
+#include "LogTransport.h"
+#include "PortableSocket.h"
+
+#include <string>
+
+class TcpClient : public LogTransport
+{
+public:
+	TcpClient(const char ipString[], const char portString[]) : _ipString(ipString), _portString(portString) { }
+
+	bool Open() override;
+	bool Connect() override;
+	bool IsConnected() const override { return _clientSocket != INVALID_SOCKET && IsClosedByServer() == false; }
+	void SetTimeout(std::chrono::milliseconds timeout) override;
+	bool Send(const char data[], size_t size) override;
+	void Close() override;
+	const char* Name() const override { return "TCP"; }
+
+	static bool CreateServerAddress(const char ipString[], const char portString[], sockaddr_in& serverAddress);
+
+private:
+	std::string _ipString;
+	std::string _portString;
+	/* The connection to the server is kept open and reused for all messages. INVALID_SOCKET if there is currently no connection. */
+	SOCKET _clientSocket = INVALID_SOCKET;
+	std::chrono::milliseconds _timeout = std::chrono::milliseconds(1000);
+
+	bool IsClosedByServer() const;
+	bool WaitForConnect();
+	bool SendAll(const char data[], size_t size);
+	void CloseConnection();
+};
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The datagrams for the high-volume trace-output of the hook.
+// Traces are sent fire-and-forget over UDP, so a busy WhatsappTray can never slow down the UI-thread of WhatsApp. Datagrams can get lost.
+// Every datagram contains one record (See LogRecord.h) and a sequence-number, so WhatsappTray can tell how many traces are missing.
+// [producerId uint32][sequence uint32][record]
+// NOTE: This file is used by Hook.dll and WhatsappTray. It must not depend on Winsock or windows.h so it also builds on Linux.
+//       The values are written in host byte-order. All supported platforms are little-endian.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+constexpr size_t datagramHeaderSize = 8;
+/* Bigger traces are not sent. This is below the maximum of a UDP-datagram on loopback. */
+constexpr size_t datagramMaxPayloadSize = 60 * 1024;
+
+class TraceDatagram
+{
+public:
+	static void BeginDatagram(std::string& datagram, uint32_t producerId, uint32_t sequence)
+	{
+		datagram.append(reinterpret_cast<const char*>(&producerId), sizeof(producerId));
+		datagram.append(reinterpret_cast<const char*>(&sequence), sizeof(sequence));
+	}
+
+	/**
+	 * @brief Splits a received datagram into header and record.
+	 *
+	 * @return False if the datagram is too short.
+	 */
+	static bool ReadDatagram(const char* datagram, size_t size, uint32_t& producerId, uint32_t& sequence, std::string& record)
+	{
+		if (size < datagramHeaderSize) {
+			return false;
+		}
+		memcpy(&producerId, datagram, sizeof(producerId));
+		memcpy(&sequence, datagram + sizeof(producerId), sizeof(sequence));
+		record.assign(datagram + datagramHeaderSize, size - datagramHeaderSize);
+		return true;
+	}
+};
+
+/**
+ * @brief Finds the gaps in the sequence-numbers of the datagrams of every producer.
+ */
+class DatagramGapDetector
+{
+public:
+	/**
+	 * @brief Takes the sequence-number of a received datagram.
+	 *
+	 * A datagram that arrives late is not counted as gap. The first datagram of a producer is never a gap, because WhatsappTray may have been started after the hook.
+	 * @return The count of datagrams that were lost directly before this one.
+	 */
+	uint32_t Track(uint32_t producerId, uint32_t sequence)
+	{
+		auto producer = _nextSequences.find(producerId);
+		if (producer == _nextSequences.end()) {
+			_nextSequences[producerId] = sequence + 1;
+			return 0;
+		}
+
+		// The sequence-number overflows, so the distance is calculated in uint32_t and everything in the upper half counts as "before".
+		uint32_t distance = sequence - producer->second;
+		if (distance >= 0x80000000u) {
+			return 0;
+		}
+
+		producer->second = sequence + 1;
+		return distance;
+	}
+
+private:
+	/* The expected next sequence-number per producerId. */
+	std::map<uint32_t, uint32_t> _nextSequences;
+};
@@ -13,18 +13,18 @@
 using namespace Gdiplus;
 
 #undef MODULE_NAME
-#define MODULE_NAME "TrayManager::"
+#define MODULE_NAME "TrayManager"
 
 TrayManager::TrayManager(const HWND hwndWhatsappTray)
 	: _hwndWhatsappTray(hwndWhatsappTray)
 	, _hwndItems { 0 }
 {
-	Logger::Info(MODULE_NAME "ctor() - Creating TrayManger.");
+	LogInfo("Creating TrayManger.");
 }
 
 void TrayManager::MinimizeWindowToTray(const HWND hwnd)
 {
-	Logger::Info(MODULE_NAME "MinimizeWindowToTray(0x%08X)", reinterpret_cast<uintptr_t>(hwnd));
+	LogInfo("hwnd=%p", hwnd);
 
 	// Hide window
 	// NOTE: The SW_MINIMIZE is important for the case when close-to-tray-feature is used:
@@ -42,7 +42,7 @@ void TrayManager::RegisterWindow(const HWND hwnd)
 {
 	// Add icon to tray if it's not already there
 	if (GetIndexFromWindowHandle(hwnd) != -1) {
-		Logger::Warning(MODULE_NAME "RegisterWindow() - Trying to send a window to tray that should already be minimized. This should not happen.");
+		LogWarning("Trying to send a window to tray that should already be minimized. This should not happen.");
 		return;
 	}
 
@@ -55,7 +55,7 @@ void TrayManager::RegisterWindow(const HWND hwnd)
 	}
 
 	if (newIndex == -1) {
-		Logger::Error(MODULE_NAME "RegisterWindow() - Tray is full!");
+		LogError("Tray is full!");
 	}
 
 	_hwndItems[newIndex] = hwnd;
@@ -64,7 +64,7 @@ void TrayManager::RegisterWindow(const HWND hwnd)
 
 void TrayManager::AddTrayIcon(const int32_t index, const HWND hwnd)
 {
-	Logger::Info(MODULE_NAME "AddTrayIcon(%d)", index);
+	LogInfo("index=%d", index);
 
 	auto nid = CreateTrayIconData(index, Helper::GetWindowIcon(hwnd));
 
@@ -74,7 +74,7 @@ void TrayManager::AddTrayIcon(const int32_t index, const HWND hwnd)
 
 void TrayManager::CloseWindowFromTray(const HWND hwnd)
 {
-	Logger::Info(MODULE_NAME "CloseWindowFromTray() 0x%08X", hwnd);
+	LogInfo("hwnd=%p", hwnd);
 
 	// Use PostMessage to avoid blocking if the program brings up a dialog on exit.
 	// NOTE: WM_WHATSAPPTRAY_TO_WHATSAPP_SEND_WM_CLOSE is a special message i made because WM_CLOSE is always blocked by the hook
@@ -100,7 +100,7 @@ void TrayManager::RemoveTrayIcon(const HWND hwnd)
 
 void TrayManager::RemoveFromTray(const int32_t index)
 {
-	Logger::Info(MODULE_NAME "RemoveFromTray(%d)", index);
+	LogInfo("index=%d", index);
 
 	NOTIFYICONDATA nid { 0 };
 	nid.cbSize = NOTIFYICONDATA_V2_SIZE;
@@ -133,7 +133,7 @@ void TrayManager::RestoreWindowFromTray(const HWND hwnd)
 
 void TrayManager::UpdateIcon(uint64_t id)
 {
-	Logger::Info(MODULE_NAME "UpdateIcon() Use bitmap with id(%d)", id);
+	LogInfo("Use bitmap with id(%llu)", id);
 
 	HICON waIcon = Helper::GetWindowIcon(GetWhatsAppHwnd());
 	auto trayIcon = waIcon;
@@ -144,14 +144,14 @@ void TrayManager::UpdateIcon(uint64_t id)
 		// Delete old unread_messsages-bitmap
 		auto lastMessageCountBitmapPath = appDirectory + std::string("unread_messages_") + std::to_string(id - 1) + ".bmp";
 		if (std::filesystem::exists(lastMessageCountBitmapPath)) {
-			Logger::Info(MODULE_NAME "UpdateIcon() Deleting old unread_messages-bitmap '%s'", lastMessageCountBitmapPath.c_str());
+			LogInfo("Deleting old unread_messages-bitmap '%s'", lastMessageCountBitmapPath.c_str());
 			std::filesystem::remove(lastMessageCountBitmapPath);
 		}
 
 		// Add the message-count-icon from WhatsApp to the normal icon
 		auto messageCountBitmapPath = appDirectory + std::string("unread_messages_") + std::to_string(id) + ".bmp";
 		if (std::filesystem::exists(messageCountBitmapPath) == false) {
-			Logger::Info(MODULE_NAME "UpdateIcon() Could not find message-count-bitmap in '%s'", messageCountBitmapPath.c_str());
+			LogInfo("Could not find message-count-bitmap in '%s'", messageCountBitmapPath.c_str());
 		} else {
 			trayIcon = AddImageOverlayToIcon(waIcon, messageCountBitmapPath.c_str());
 		}
@@ -174,7 +174,7 @@ void TrayManager::UpdateIcon(uint64_t id)
 
 NOTIFYICONDATA TrayManager::CreateTrayIconData(const int32_t index, HICON trayIcon)
 {
-	Logger::Info(MODULE_NAME "CreateTrayIconData() With index=%d", index);
+	LogInfo("index=%d", index);
 
 	NOTIFYICONDATA nid{ 0 };
 	nid.cbSize = NOTIFYICONDATA_V2_SIZE;
@@ -11,11 +11,16 @@
 #include "TrayManager.h"
 #include "AboutDialog.h"
 #include "WinSockServer.h"
+#include "NamedPipeServer.h"
+#include "SharedMemoryServer.h"
+#include "LogMessageConsumer.h"
+#include "HookLogControl.h"
 #include "Helper.h"
 #include "Logger.h"
 
 #include <windows.h>
 #include <Strsafe.h>
+#include <algorithm>
 #include <filesystem>
 
 namespace fs = std::filesystem;
@@ -36,8 +41,21 @@ static HWND _hwndWhatsapp = NULL; /* Handle to the window of WhatsApp */
 static HHOOK _hWndProc = NULL; /* Handle to the Hook from SetWindowsHookEx() */
 static HMODULE _hLib = NULL; /* Handle to the Hook.dll */
 
-static char _loggerPort[] = LOGGER_PORT;
-static std::thread _winsockThread;
+/* The servers that receive the log-messages of the hook. Each one runs in its own thread. */
+static std::vector<std::unique_ptr<LogServer>> _logServers;
+static std::vector<std::thread> _logServerThreads;
+/* Writes the received log-messages, so the log-servers never wait for the disk.
+ * While it runs, also the lines of WhatsappTray go through it, so all lines are written in the order in which they were created. */
+static LogMessageConsumer _hookMessageConsumer([](const LogLine& logLine) {
+	// The lines of WhatsappTray were already recorded in Logger::ProcessLog(). The ones of the hook are recorded here, in the consumer-thread, so the log-servers do not wait for it.
+	if (logLine.producerId != GetCurrentProcessId()) {
+		Logger::RecordLine(logLine);
+	}
+	Logger::WriteLine(logLine);
+});
+
+/* Sets the level of the log-messages of the hook. */
+static HookLogControl _hookLogControl;
 
 static std::unique_ptr<TrayManager> _trayManager;
 
@@ -50,13 +68,20 @@ static bool CreateWhatsappTrayWindow();
 static void ExecuteMenu();
 static bool SetHook();
 static void UnRegisterHook();
+static void CreateHookLogControl(const char* commandLine);
 static void SetLaunchOnWindowsStartupSetting(const bool value);
 
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd)
 {
 	_hInstance = hInstance;
 
-	Logger::Setup();
+	LoggerConfig loggerConfig;
+	loggerConfig.binaryJournal = strstr(lpCmdLine, "--binaryLog") != NULL;
+	// The flight-recorder is enabled by default. It costs the formatting of the debug-lines and 1MB of memory.
+	if (strstr(lpCmdLine, "--noFlightRecorder") != NULL) {
+		loggerConfig.flightRecorderSlots = 0;
+	}
+	Logger::Setup(loggerConfig);
 
 	LogInfo("Starting WhatsappTray %s in %s CompileConfiguration.", Helper::GetProductAndVersion().c_str(), CompileConfiguration);
 	LogInfo("CloseToTray=%d.", static_cast<bool>(AppData::CloseToTray.Get()));
@@ -67,12 +92,33 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 		LogInfo("The COM library was NOT initialized successfully");
 	}
 	
-	// Initialize WinSock-server, which is used to send log-messages from WhatsApp-hook to WhatsappTray
-	SocketNotifyOnNewMessage([](std::string message) {
-		Logger::Info("Hook> %s", message.c_str());
-	});
+	// Initialize the servers, which are used to send log-messages from WhatsApp-hook to WhatsappTray.
+	// The WinSock-server always runs. When one of the other servers exists, the hook uses it instead of the socket.
+	_logServers.push_back(std::make_unique<WinSockServer>(LOGGER_PORT));
+	if (strstr(lpCmdLine, "--namedPipeLogging")) {
+		LogInfo("Using a named pipe for the log-messages of the hook.");
+		_logServers.push_back(std::make_unique<NamedPipeServer>());
+	}
+	if (strstr(lpCmdLine, "--sharedMemoryLogging")) {
+		LogInfo("Using shared memory for the log-messages of the hook.");
+		_logServers.push_back(std::make_unique<SharedMemoryServer>());
+	}
 
-	_winsockThread = std::thread(SocketStart, _loggerPort);
+	CreateHookLogControl(lpCmdLine);
+
+	_hookMessageConsumer.Start();
+	Logger::SetLineSink([](const LogLine& logLine) {
+		_hookMessageConsumer.Push(logLine);
+	});
+	auto hookMessageReceived = [](const LogLine& message) {
+		LogLine logLine = message;
+		logLine.text = "Hook> " + message.text + "\n";
+		_hookMessageConsumer.Push(logLine);
+	};
+	for (auto& logServer : _logServers) {
+		logServer->NotifyOnNewMessage(hookMessageReceived);
+		_logServerThreads.push_back(std::thread(&LogServer::Run, logServer.get()));
+	}
 
 	Gdiplus::GdiplusStartupInput gdiplusStartupInput;
 	ULONG_PTR gdiplusToken;
@@ -101,6 +147,7 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 	Gdiplus::GdiplusShutdown(gdiplusToken);
 	CoUninitialize();
 
+	Logger::ReleaseInstance();
 	return 0;
 }
 
@@ -169,6 +216,24 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 			// Toggle the 'CloseToTrayWithEscape'-feature.
 			AppData::CloseToTrayWithEscape.Set(!AppData::CloseToTrayWithEscape.Get());
 		} break;
+		case IDM_SAVE_FLIGHT_RECORDER: {
+			std::string path = Logger::DumpFlightRecorder("Saved from the tray-menu");
+			if (path.empty()) {
+				MessageBox(NULL, "The recent log-lines could not be saved.", "WhatsappTray", MB_OK | MB_ICONERROR);
+			} else {
+				MessageBox(NULL, (std::string("The recent log-lines were saved to:\n") + path).c_str(), "WhatsappTray", MB_OK | MB_ICONINFORMATION);
+			}
+		} break;
+		case IDM_HOOK_LOG_LEVEL_FIRST + static_cast<int32_t>(HookLogLevel::Off):
+		case IDM_HOOK_LOG_LEVEL_FIRST + static_cast<int32_t>(HookLogLevel::Error):
+		case IDM_HOOK_LOG_LEVEL_FIRST + static_cast<int32_t>(HookLogLevel::Info):
+		case IDM_HOOK_LOG_LEVEL_FIRST + static_cast<int32_t>(HookLogLevel::Debug):
+		case IDM_HOOK_LOG_LEVEL_FIRST + static_cast<int32_t>(HookLogLevel::Trace): {
+			// The hook uses the new level with its next log-call. WhatsApp does not have to be restarted.
+			auto level = static_cast<HookLogLevel>(LOWORD(wParam) - IDM_HOOK_LOG_LEVEL_FIRST);
+			LogInfo("Hook-log-level=%s from the tray-menu.", HookLogLevelName(level));
+			_hookLogControl.Set(level, _hookLogControl.CategoryMask());
+		} break;
 		case IDM_RESTORE: {
 			LogInfo("IDM_RESTORE");
 			_trayManager->RestoreWindowFromTray(_hwndWhatsapp);
@@ -204,7 +269,7 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 		}
 	} break;
 	case WM_WA_KEY_PRESSED: {
-		LogInfo("WM_WA_KEY_PRESSED wParam=%d", wParam);
+		LogInfo("WM_WA_KEY_PRESSED wParam=%zu", wParam);
 
 		if (AppData::CloseToTrayWithEscape.Get() == true) {
 			if (wParam == 27) {
@@ -251,16 +316,23 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
 			FreeLibrary(_hLib);
 		}
 
-		// Stop winsock-server and wait for it to cleanup and finish
-		SocketStopServer();
-		_winsockThread.join();
+		// Stop the log-servers and wait for them to cleanup and finish
+		for (auto& logServer : _logServers) {
+			logServer->Stop();
+		}
+		for (auto& logServerThread : _logServerThreads) {
+			logServerThread.join();
+		}
+		// Write directly again. The consumer writes the lines that are still held back.
+		Logger::SetLineSink(nullptr);
+		_hookMessageConsumer.Stop();
 
 		PostQuitMessage(0);
 		LogInfo("QuitMessage posted.");
 	} break;
 	case WM_WHATSAPP_API_NEW_MESSAGE: {
 
-		LogInfo("WM_WHATSAPP_API_NEW_MESSAGE wparam=%d", wParam);
+		LogInfo("WM_WHATSAPP_API_NEW_MESSAGE wparam=%zu", wParam);
 
 		//if (AppData::ShowUnreadMessages.Get()) {
 
@@ -342,13 +414,13 @@ static HWND StartWhatsapp()
 		waStartPathString = waStartPath.u8string();
 	}
 
-	LogInfo("Starting WhatsApp from canonical-path:'" + waStartPathString + "'");
+	LogInfo("Starting WhatsApp from canonical-path:'%s'", waStartPathString.c_str());
 
 	auto waStartPathStringExtension = waStartPathString.substr(waStartPathString.size() - 3);
 	if (waStartPathStringExtension.compare("lnk") == 0)
 	{
 		waStartPathString = Helper::ResolveLnk(_hwndWhatsappTray, waStartPathString.c_str());
-		LogInfo("Resolved .lnk (Shortcut) to:'" + waStartPathString + "'");
+		LogInfo("Resolved .lnk (Shortcut) to:'%s'", waStartPathString.c_str());
 	}
 
 	auto pi = Helper::StartProcess(waStartPathString);
@@ -375,7 +447,7 @@ static HWND StartWhatsapp()
 		Sleep(100);
 	}
 
-	LogInfo("WhatsApp-Window found. hwnd=%X", _hwndWhatsapp);
+	LogInfo("WhatsApp-Window found. hwnd=%p", _hwndWhatsapp);
 
 	return _hwndWhatsapp;
 }
@@ -397,7 +469,7 @@ static HWND FindWhatsappWindowHandle()
 		}
 
 		auto windowTitle = Helper::GetWindowTitle(iteratedHwnd);
-		LogInfo("Found window with title: '%s' hwnd=0x%08X", windowTitle.c_str(), reinterpret_cast<uintptr_t>(iteratedHwnd));
+		LogInfo("Found window with title: '%s' hwnd=%p", windowTitle.c_str(), iteratedHwnd);
 
 		// It looks like as if the 'Whatsapp Voip'-window is first named 'Whatsapp' when Whatsapp is started and then changed shortly after to 'Whatsapp Voip'.
 		// Because of that it can happen that the wrong window is set.
@@ -542,6 +614,21 @@ static void ExecuteMenu()
 
 	AppendMenu(hMenu, MF_SEPARATOR, 0, NULL); //--------------
 
+	// -- Log-level of the hook.
+	HMENU hHookLogLevelMenu = CreatePopupMenu();
+	if (hHookLogLevelMenu) {
+		const char* levelTexts[] = { "Off", "Errors", "Info", "Debug", "Trace (every window-message)" };
+		for (int32_t level = 0; level <= static_cast<int32_t>(HookLogLevel::Trace); level++) {
+			AppendMenu(hHookLogLevelMenu, MF_STRING, IDM_HOOK_LOG_LEVEL_FIRST + level, levelTexts[level]);
+		}
+		CheckMenuRadioItem(hHookLogLevelMenu, IDM_HOOK_LOG_LEVEL_FIRST, IDM_HOOK_LOG_LEVEL_FIRST + static_cast<int32_t>(HookLogLevel::Trace), IDM_HOOK_LOG_LEVEL_FIRST + static_cast<int32_t>(_hookLogControl.Level()), MF_BYCOMMAND);
+		// The submenu is destroyed together with hMenu.
+		AppendMenu(hMenu, MF_POPUP, reinterpret_cast<UINT_PTR>(hHookLogLevelMenu), "Log-level of the hook");
+	}
+
+	if (Logger::IsFlightRecorderEnabled()) {
+		AppendMenu(hMenu, MF_STRING, IDM_SAVE_FLIGHT_RECORDER, "Save recent log-lines");
+	}
 	AppendMenu(hMenu, MF_STRING, IDM_RESTORE, "Restore Window");
 	AppendMenu(hMenu, MF_STRING, IDM_CLOSE, "Close Whatsapp");
 
@@ -598,6 +685,35 @@ static bool SetHook()
 	return true;
 }
 
+/**
+ * @brief Creates the control-block with the level from "--hookLogLevel=<off|error|info|debug|trace>" and the categories from "--hookLogCategories=<hex-mask>".
+ */
+static void CreateHookLogControl(const char* commandLine)
+{
+	HookLogLevel level = DefaultHookLogLevel();
+	uint32_t categoryMask = LogCategory::All;
+
+	const char* levelArgument = strstr(commandLine, "--hookLogLevel=");
+	if (levelArgument != NULL) {
+		char levelName[16] = {};
+		sscanf_s(levelArgument, "--hookLogLevel=%15[a-z]", levelName, static_cast<unsigned>(sizeof(levelName)));
+		if (ParseHookLogLevel(levelName, level) == false) {
+			LogError("Unknown hook-log-level '%s'. Using the default.", levelName);
+		}
+	}
+
+	const char* categoriesArgument = strstr(commandLine, "--hookLogCategories=");
+	if (categoriesArgument != NULL) {
+		if (sscanf_s(categoriesArgument, "--hookLogCategories=%x", &categoryMask) != 1) {
+			LogError("Invalid hook-log-categories. Using all.");
+			categoryMask = LogCategory::All;
+		}
+	}
+
+	LogInfo("Hook-log-level=%d categories=0x%08X.", static_cast<int32_t>(level), categoryMask);
+	_hookLogControl.Create(level, categoryMask);
+}
+
 static void UnRegisterHook()
 {
 	if (_hWndProc) {
@@ -4,11 +4,15 @@
 // WinSockClient implementation
 
 #include "WinSockClient.h"
+// NOTE: TcpClient.h includes winsock2.h, which has to be included before windows.h
+#include "TcpClient.h"
+#include "NamedPipeClient.h"
+#include "SharedMemoryClient.h"
 
-#include <string.h>
-#include <winsock2.h>
-#include "../libs/readerwriterqueue/readerwriterqueue.h"
-#include "../libs/readerwriterqueue/atomicops.h"
+#include "TraceDatagram.h"
+
+#include <atomic>
+#include <memory>
 
 #pragma comment(lib, "ws2_32.lib")
 
@@ -18,249 +22,189 @@
 // NOTE: For debugging OutputDebugStringA could be used...
 #define LogDebug(message, ...) //printf(MODULE_NAME "::" __FUNCTION__ " - " message "\n", __VA_ARGS__)
 
-static void ProcessMessageQueue();
-static bool SocketInit();
-static void SocketCleanup();
-static bool SocketSendMessage(const char ipString[], const char portString[], const char message[]);
-static bool SetupSocket();
-static bool CreateServerAddress(SOCKET clientSocket, const char ipString[], const char portString[], sockaddr_in& ServerAddress);
-static int WaitForNewMesaageWithTimeout(FD_SET& readSet, long sec, long usec);
+static std::unique_ptr<LogTransport> OpenTransport();
+static void OpenDatagramSocket(const char ipString[], const char portString[]);
+static void CloseDatagramSocket();
 
-static bool _isRunning = false;
-static bool _waitForEmptyBuffer;
 static std::string _ipString;
 static std::string _portString;
-static std::thread _processMessagesThread;
-static moodycamel::BlockingReaderWriterQueue<std::string> _messageBuffer;
-static SOCKET clientSocket = INVALID_SOCKET;
-
-constexpr int timeoutReceiveSec = 10;
+/* The lanes, the batching and the message-processing thread. (See MessageSender.h) */
+static MessageSender _sender;
+/* The UDP-socket for the traces. Used by all threads that trace. INVALID_SOCKET if the client is not running. */
+static std::atomic<SOCKET> datagramSocket = INVALID_SOCKET;
+static sockaddr_in datagramAddress;
+static std::atomic<uint32_t> _datagramSequence = 0;
 
 /**
  * @brief Sends message to server
+ *
+ * @param message One record. (See LogRecord.h)
+ * @param lane The messages of the control-lane are sent before the messages of the bulk-lane. The order within a lane is kept.
 */
-void SocketSendMessage(const char message[])
+void SocketSendMessage(std::string&& message, MessageLane lane)
 {
-	if (_isRunning) {
-		_messageBuffer.enqueue(std::string(message));
-	}
+	_sender.Send(std::move(message), lane);
 }
 
 /**
- * @brief Starts the client
+ * @brief Returns an empty buffer for a record. It is given back to the pool after the record was sent, so logging does not allocate.
 */
-void SocketStart(const char ipString[], const char portString[])
+std::string SocketTakeBuffer()
 {
-	_ipString = ipString;
-	_portString = portString;
-
-	LogDebug("Start message-processing thread");
-
-	_isRunning = true;
-
-	_processMessagesThread = std::thread(ProcessMessageQueue);
+	return _sender.TakeBuffer();
 }
 
-void ProcessMessageQueue()
+/**
+ * @brief Gives a buffer back to the pool that was not passed to SocketSendMessage().
+*/
+void SocketReturnBuffer(std::string&& buffer)
 {
-	SocketInit();
-
-	std::string item;
-	while (true) {
-		_messageBuffer.wait_dequeue(item);
-
-		if (_isRunning == false) {
-			break;
-		}
-
-		SocketSendMessage(_ipString.c_str(), _portString.c_str(), item.c_str());
-	}
-
-	if (_waitForEmptyBuffer) {
-		// Empty the buffer before stopping.
-
-		// One item should be still in item that was not processed yet.
-		// If it was the dummy, do nothing.
-
-		while (true) {
-
-			if (_messageBuffer.size_approx() == 0) {
-				break;
-			}
-
-			SocketSendMessage(_ipString.c_str(), _portString.c_str(), item.c_str());
-
-			_messageBuffer.try_dequeue(item);
-		}
-
-	}
-
-	SocketCleanup();
+	_sender.ReturnBuffer(std::move(buffer));
 }
 
-bool SocketInit()
+/**
+ * @brief Sends the registration of a call-site to the server. Can be called before SocketStart(). (See MessageSender::SendRegistration())
+*/
+void SocketSendRegistration(std::string&& record)
 {
-	WSADATA wsaData;
-	int nResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
-
-	if (NO_ERROR != nResult) {
-		LogDebug("Error occurred while executing WSAStartup()");
-		return false;
-	}
-
-	LogDebug("WSAStartup() successful");
-
-	return true;
+	_sender.SendRegistration(std::move(record));
 }
 
-void SocketCleanup()
+/**
+ * @brief The depth and the wait-times of the lane since SocketStart().
+*/
+MessageQueueStatistics SocketLaneStatistics(MessageLane lane)
 {
-	if (clientSocket != INVALID_SOCKET) {
-		closesocket(clientSocket);
-	}
-
-	// Cleanup Winsock
-	WSACleanup();
+	return _sender.LaneStatistics(lane);
 }
 
-bool SocketSendMessage(const char ipString[], const char portString[], const char message[])
+/**
+ * @brief Sends the record as UDP-datagram directly from the calling thread. (See TraceDatagram.h)
+ *
+ * Used for the high-volume trace-output. It does not wait for anything, so it never slows down the caller.
+ * When the datagram can not be sent it is lost. WhatsappTray notices that from the gap in the sequence-numbers.
+ *
+ * @param producerId The id of this process.
+ * @param record One record. (See LogRecord.h)
+*/
+void SocketSendDatagram(uint32_t producerId, const std::string& record)
 {
-	if (SetupSocket() == false) {
-		closesocket(clientSocket);
+	SOCKET socket = datagramSocket;
+	if (socket == INVALID_SOCKET) {
+		return;
 	}
 
-	sockaddr_in ServerAddress;
-	if (CreateServerAddress(clientSocket, ipString, portString, ServerAddress) == false) {
-		return false;
+	// The sequence-number is taken also when the datagram is not sent, so the loss is visible in WhatsappTray.
+	uint32_t sequence = _datagramSequence++;
+	if (record.size() > datagramMaxPayloadSize) {
+		return;
 	}
 
-	// Establish connection with the server
-	if (SOCKET_ERROR == connect(clientSocket, reinterpret_cast<const struct sockaddr*>(&ServerAddress), sizeof(ServerAddress))) {
-		auto error = WSAGetLastError();
-		LogDebug("Error occurred while connecting: %ld.", error);
-	}
-	LogDebug("connect() successful.");
+	thread_local std::string datagram;
+	datagram.clear();
+	TraceDatagram::BeginDatagram(datagram, producerId, sequence);
+	datagram.append(record);
 
-	// Send the message to the server
-	int nBytesSent = send(clientSocket, message, (int)strlen(message), 0);
+	// The socket is non-blocking. If the send-buffer is full, the datagram is simply dropped.
+	sendto(socket, datagram.data(), static_cast<int>(datagram.size()), 0, reinterpret_cast<const struct sockaddr*>(&datagramAddress), sizeof(datagramAddress));
+}
 
-	if (SOCKET_ERROR == nBytesSent) {
-		LogDebug("Error occurred while writing to socket.");
-		return false;
-	}
-	LogDebug("send() successful.");
-
-	FD_SET readSet;
-	// NOTE: selRet has the cout of sockets that are ready
-	auto selRet = WaitForNewMesaageWithTimeout(readSet, timeoutReceiveSec, 0);
-	if (selRet == SOCKET_ERROR) {
-		LogDebug("Error occurred while using select() on socket.");
-		return false;
-	} else if (selRet == 0) {
-		LogDebug("Waiting for message timeout.");
-		return false;
-	}
+/**
+ * @brief Starts the client
+ *
+ * @param queueConfig The limits of the message-buffer and what happens when it is full.
+ * @param batchConfig Controls how many messages are collected before they are sent together.
+ * @param reconnectConfig Controls how long to wait before the server is tried again after a failure.
+*/
+void SocketStart(const char ipString[], const char portString[], const MessageQueueConfig& queueConfig, const MessageBatchConfig& batchConfig, const ReconnectConfig& reconnectConfig)
+{
+	_ipString = ipString;
+	_portString = portString;
 
-	if (FD_ISSET(clientSocket, &readSet)) {
-		// Server sent message to client
+	OpenDatagramSocket(ipString, portString);
 
-		// Init szBuffer with 0
-		const int bufferSize = 256;
-		char szBuffer[bufferSize];
-		ZeroMemory(szBuffer, bufferSize);
+	LogDebug("Start message-processing thread");
 
-		// Get the message from the server
-		// WARNING: MSG_WAITALL only because in this case the server will close the connection, wich will also stop the waiting.
-		int bytesRecv = recv(clientSocket, szBuffer, bufferSize - 1, MSG_WAITALL);
+	_sender.Start(OpenTransport, GetCurrentProcessId(), queueConfig, batchConfig, reconnectConfig);
+}
 
-		if (SOCKET_ERROR == bytesRecv) {
-			LogDebug("Error occurred while reading from socket.");
-			return false;
+/**
+ * @brief Opens the first transport that WhatsappTray provides. Called from the message-processing thread.
+ *
+ * The shared-memory ring and the named pipe only exist when WhatsappTray was started with the corresponding option. TCP is always available.
+*/
+static std::unique_ptr<LogTransport> OpenTransport()
+{
+	std::unique_ptr<LogTransport> transports[] = {
+		std::make_unique<SharedMemoryClient>(),
+		std::make_unique<NamedPipeClient>(),
+		std::make_unique<TcpClient>(_ipString.c_str(), _portString.c_str()),
+	};
+
+	for (auto& transport : transports) {
+		if (transport->Open()) {
+			LogDebug("Use the %s-transport.", transport->Name());
+			return std::move(transport);
 		}
-		LogDebug("recv() successful.");
-
-		LogDebug("Server message: '%s'", szBuffer);
 	}
 
-	closesocket(clientSocket);
-
-	return true;
+	// TcpClient::Open() only fails when Winsock is not available. Keep TcpClient anyway, sending then just fails.
+	return std::move(transports[2]);
 }
 
 /**
- * @brief Create a socket
+ * @brief Stops the client
  *
- * @return True if socket was sucessfully created.
+ * The remaining messages are sent until the timeout is reached. The rest is dropped. (See MessageSender::Stop())
+ * This is important because it is called while WhatsApp exits.
+ *
+ * @param timeout The time to send the remaining messages. Zero to drop them.
+ * @return The count of messages that were not sent.
 */
-static bool SetupSocket()
+uint64_t SocketStop(std::chrono::milliseconds timeout)
 {
-	clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	uint64_t unsentCount = _sender.Stop(timeout);
 
-	if (INVALID_SOCKET == clientSocket) {
-		LogDebug("Error occurred while opening socket: %ld.", WSAGetLastError());
-		return false;
-	}
-	LogDebug("socket() successful.");
+	CloseDatagramSocket();
 
-	return true;
+	return unsentCount;
 }
 
-static bool CreateServerAddress(SOCKET clientSocket, const char ipString[], const char portString[], sockaddr_in& serverAddress)
+/**
+ * @brief Create the non-blocking UDP-socket for the traces.
+ *
+ * The datagram-socket has its own WSAStartup(), because it is used independent of the message-processing thread.
+*/
+static void OpenDatagramSocket(const char ipString[], const char portString[])
 {
-	// Server name will be supplied as a commandline argument
-	// Get the server details
-	struct hostent* server = gethostbyname(ipString);
-
-	if (server == NULL) {
-		LogDebug("Error occurred no such host.");
-		return false;
+	WSADATA wsaData;
+	if (NO_ERROR != WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+		LogDebug("Error occurred while executing WSAStartup()");
+		return;
 	}
 
-	LogDebug("gethostbyname() successful.");
-
-	// Port number will be supplied as a commandline argument
-	int portNumber = atoi(portString);
-
-	// Cleanup and Init the serverAddress with 0
-	ZeroMemory((char*)&serverAddress, sizeof(serverAddress));
-
-	serverAddress.sin_family = AF_INET;
-
-	// Assign the information received from gethostbyname()
-	CopyMemory((char*)&serverAddress.sin_addr.s_addr, (char*)server->h_addr, server->h_length);
-
-	serverAddress.sin_port = htons(portNumber); //comes from commandline
-
-	return true;
-}
-
-// Wait with timeout for new message.
-static int WaitForNewMesaageWithTimeout(FD_SET& readSet, long sec, long usec)
-{
-	FD_ZERO(&readSet);
-	FD_SET(clientSocket, &readSet);
-	timeval timeoutTime;
-	timeoutTime.tv_sec = sec;
-	timeoutTime.tv_usec = usec;
+	SOCKET socketTemp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (INVALID_SOCKET == socketTemp) {
+		LogDebug("Error occurred while opening datagram-socket: %ld.", WSAGetLastError());
+		WSACleanup();
+		return;
+	}
 
-	// NOTE: selRet has the cout of sockets that are ready
-	auto selRet = select(NULL, &readSet, NULL, NULL, &timeoutTime);
+	u_long nonBlocking = 1;
+	if (SOCKET_ERROR == ioctlsocket(socketTemp, FIONBIO, &nonBlocking) || TcpClient::CreateServerAddress(ipString, portString, datagramAddress) == false) {
+		closesocket(socketTemp);
+		WSACleanup();
+		return;
+	}
 
-	return selRet;
+	datagramSocket = socketTemp;
 }
 
-/**
- * @brief Stops the client
-*/
-void SocketStop(bool waitForEmptyBuffer, bool waitForShutdown)
+static void CloseDatagramSocket()
 {
-	_waitForEmptyBuffer = waitForEmptyBuffer;
-	_isRunning = false;
-
-	// Send dummy-message to get out of wait_dequeue()
-	_messageBuffer.enqueue(std::string("end processing dummy-message. This should not be sent!"));
-
-	if (waitForShutdown && _processMessagesThread.joinable()) {
-		_processMessagesThread.join();
+	SOCKET socket = datagramSocket.exchange(INVALID_SOCKET);
+	if (socket != INVALID_SOCKET) {
+		closesocket(socket);
+		WSACleanup();
 	}
 }
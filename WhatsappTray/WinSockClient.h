@@ -5,9 +5,17 @@
 
 #pragma once
 
+#include "MessageSender.h"
+
+#include <chrono>
 #include <iostream>
-#include <thread>
+#include <string>
 
-void SocketSendMessage(const char message[]);
-void SocketStart(const char ipString[], const char portString[]);
-void SocketStop(bool waitForEmptyBuffer = true, bool waitForShutdown = true);
+void SocketSendMessage(std::string&& message, MessageLane lane = MessageLane::Bulk);
+std::string SocketTakeBuffer();
+void SocketReturnBuffer(std::string&& buffer);
+void SocketSendRegistration(std::string&& record);
+MessageQueueStatistics SocketLaneStatistics(MessageLane lane);
+void SocketSendDatagram(uint32_t producerId, const std::string& record);
+void SocketStart(const char ipString[], const char portString[], const MessageQueueConfig& queueConfig = MessageQueueConfig(), const MessageBatchConfig& batchConfig = MessageBatchConfig(), const ReconnectConfig& reconnectConfig = ReconnectConfig());
+uint64_t SocketStop(std::chrono::milliseconds timeout = std::chrono::milliseconds(500));
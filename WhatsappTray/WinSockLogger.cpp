@@ -3,18 +3,61 @@
 
 #include "WinSockLogger.h"
 
-void WinSockLogger::TraceString(const std::string traceString)
+#include "SharedDefines.h"
+
+#include <windows.h>
+#include <mutex>
+
+static std::mutex _registerCallSiteMutex;
+static uint32_t _lastCallSiteId = 0;
+
+/* Used when WhatsappTray did not create the control-block, for example an older version. */
+static LogControlBlock _defaultLogControl{ static_cast<int32_t>(DefaultHookLogLevel()), LogCategory::All };
+std::atomic<const LogControlBlock*> WinSockLogger::_logControl = &_defaultLogControl;
+
+void WinSockLogger::OpenLogControl()
 {
-	SocketSendMessage(traceString.c_str());
+	// The handle and the view are kept until the process ends, because every log-call reads the block.
+	HANDLE fileMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, LOGGER_CONTROL_NAME);
+	if (fileMapping == NULL) {
+		return;
+	}
+
+	auto controlBlock = static_cast<const LogControlBlock*>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, sizeof(LogControlBlock)));
+	if (controlBlock == NULL) {
+		CloseHandle(fileMapping);
+		return;
+	}
+
+	_logControl = controlBlock;
+}
+
+void WinSockLogger::TraceString(const std::string traceString, uint8_t level)
+{
+	std::string record = SocketTakeBuffer();
+	LogRecordWriter::BeginText(record, ProducerId(), LogRecordWriter::Now(), level);
+	record.append(traceString);
+	SocketSendMessage(std::move(record), MessageLane::Control);
 
 	//#ifdef _DEBUG
 	//	OutputDebugStringA(traceString.c_str());
 	//#endif
 }
 
+/**
+ * @brief Sends the trace as UDP-datagram.
+ *
+ * This is used for the high-volume trace-output, for example every window-message. Traces can get lost, but they never slow down the caller.
+ * Important messages like errors have to use TraceString() or LogImportant(), which use the control-lane of the reliable connection.
+*/
 void WinSockLogger::TraceStream(std::ostringstream& traceBuffer)
 {
-	SocketSendMessage(traceBuffer.str().c_str());
+	std::string record = SocketTakeBuffer();
+	LogRecordWriter::BeginText(record, ProducerId());
+	record.append(traceBuffer.str());
+	SocketSendDatagram(ProducerId(), record);
+	SocketReturnBuffer(std::move(record));
+
 	traceBuffer.clear();
 	traceBuffer.str(std::string());
 
@@ -23,4 +66,55 @@ void WinSockLogger::TraceStream(std::ostringstream& traceBuffer)
 	//	traceBuffer.clear();
 	//	traceBuffer.str(std::string());
 	//#endif
-}
\ No newline at end of file
+}
+
+bool WinSockLogger::PassesRateLimit(LogRateLimiter& rateLimiter, const char* module, const char* function)
+{
+	static const LogRateLimit rateLimit;
+
+	uint32_t suppressedCount = 0;
+	if (rateLimiter.TryAcquire(LogRecordWriter::Now(), rateLimit, suppressedCount) == false) {
+		return false;
+	}
+	if (suppressedCount > 0) {
+		std::string notice;
+		AppendFormat(notice, "%s::%s: %u lines were dropped because of the rate-limit.", module, function, suppressedCount);
+		TraceString(notice, logRecordWarningLevel);
+	}
+	return true;
+}
+
+/**
+ * @brief Gives the call-site an id and sends the registration to WhatsappTray.
+ *
+ * The registration is stored before the id is published, so the registration is always sent before the first event of the call-site.
+ * @return The id of the call-site
+*/
+uint32_t WinSockLogger::RegisterCallSite(LogCallSite& callSite)
+{
+	std::lock_guard<std::mutex> lock(_registerCallSiteMutex);
+
+	// Another thread could have registered the call-site while we waited for the mutex.
+	uint32_t callSiteId = callSite.id.load(std::memory_order_acquire);
+	if (callSiteId != 0) {
+		return callSiteId;
+	}
+
+	callSiteId = ++_lastCallSiteId;
+
+	std::string record;
+	LogRecordWriter::BeginCallSite(record, ProducerId(), callSiteId, callSite);
+	SocketSendRegistration(std::move(record));
+
+	callSite.id.store(callSiteId, std::memory_order_release);
+	return callSiteId;
+}
+
+/**
+ * @brief The id of this process. WhatsappTray uses it to keep the call-sites of the different hooked processes apart.
+*/
+uint32_t WinSockLogger::ProducerId()
+{
+	static const uint32_t producerId = GetCurrentProcessId();
+	return producerId;
+}
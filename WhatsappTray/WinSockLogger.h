@@ -4,16 +4,84 @@
 #pragma once
 
 #include "WinSockClient.h"
+#include "LogControl.h"
+#include "LogFormat.h"
+#include "LogRateLimiter.h"
+#include "LogRecord.h"
 
 #include <string>
 #include <iostream>
 #include <sstream>
 
-#define LogString(logString, ...) WinSockLogger::TraceString(MODULE_NAME + std::string("::") + std::string(__func__) + ": " + string_format(logString, __VA_ARGS__))
+/**
+ * Every call-site is registered once. After that only the id of the call-site and the raw arguments are sent to WhatsappTray, which does the formatting.
+ * The level is checked first. When it is disabled, the arguments are not even evaluated.
+ * The count of the arguments is checked against the format-string at compile-time. The types do not have to match exactly, WhatsappTray formats with the real type.
+ * Every call-site has its own rate-limit. (See LogRateLimiter.h)
+ * NOTE: logString has to be a string-literal.
+ */
+#define LogWithLevel(level, category, lane, ...) do { static_assert(CountFormatArguments(LOG_FORMAT_STRING(__VA_ARGS__)) + 1 == decltype(LogArgumentCount(__VA_ARGS__))::value, "The count of the arguments does not match the format-string."); if (WinSockLogger::IsEnabled(level, category)) { static LogRateLimiter logRateLimiter; if (level == HookLogLevel::Error || WinSockLogger::PassesRateLimit(logRateLimiter, MODULE_NAME, __func__)) { static LogCallSite logCallSite{ MODULE_NAME, __func__, LOG_FORMAT_STRING(__VA_ARGS__), 0 }; WinSockLogger::TraceEvent(lane, logCallSite, __VA_ARGS__); } } } while (0)
+
+/**
+ * The first argument is the format-string. It is passed inside of __VA_ARGS__, so a line without arguments also builds with GCC and Clang.
+ */
+#define LogString(...) LogWithLevel(HookLogLevel::Debug, LogCategory::General, MessageLane::Bulk, __VA_ARGS__)
+/**
+ * For the handling of the window-messages. Can be disabled separately, because it creates many messages.
+ */
+#define LogWindowMessage(...) LogWithLevel(HookLogLevel::Debug, LogCategory::WindowMessages, MessageLane::Bulk, __VA_ARGS__)
+/**
+ * Uses the control-lane. For the steps of the initialization, which must not wait behind a flood of other messages.
+ */
+#define LogImportant(...) LogWithLevel(HookLogLevel::Info, LogCategory::General, MessageLane::Control, __VA_ARGS__)
+/**
+ * Uses the control-lane. For errors. They are also logged when WhatsappTray only wants errors.
+ */
+#define LogFailure(...) LogWithLevel(HookLogLevel::Error, LogCategory::General, MessageLane::Control, __VA_ARGS__)
 
 class WinSockLogger
 {
 public:
-	static void TraceString(const std::string traceString);
+	/**
+	 * @brief Uses the control-block of WhatsappTray, if it exists. Otherwise the default-level stays active.
+	 */
+	static void OpenLogControl();
+
+	static bool IsEnabled(HookLogLevel level, uint32_t category) { return _logControl.load(std::memory_order_relaxed)->IsEnabled(level, category); }
+	/**
+	 * @brief Checks the rate-limit of the call-site. Before the first line after a pause, it sends how many lines were dropped.
+	 *
+	 * The lines are formatted by WhatsappTray, so identical lines are not collapsed here. Errors are never checked, so they are never dropped.
+	 */
+	static bool PassesRateLimit(LogRateLimiter& rateLimiter, const char* module, const char* function);
+
+	/**
+	 * @param level The Loglevel of WhatsappTray with which the line is written. 0 for the lines of the hook.
+	 */
+	static void TraceString(const std::string traceString, uint8_t level = 0);
 	static void TraceStream(std::ostringstream& traceBuffer);
+
+	/**
+	 * @brief Sends the id of the call-site and the arguments as binary record.
+	 */
+	template<typename ... Args>
+	static void TraceEvent(MessageLane lane, LogCallSite& callSite, const char* /*format*/, const Args& ... args)
+	{
+		uint32_t callSiteId = callSite.id.load(std::memory_order_acquire);
+		if (callSiteId == 0) {
+			callSiteId = RegisterCallSite(callSite);
+		}
+
+		std::string record = SocketTakeBuffer();
+		LogRecordWriter::BeginEvent(record, ProducerId(), callSiteId);
+		LogRecordWriter::AppendArguments(record, args ...);
+		SocketSendMessage(std::move(record), lane);
+	}
+
+private:
+	/* Points to the control-block in the shared memory or to the default-block. */
+	static std::atomic<const LogControlBlock*> _logControl;
+
+	static uint32_t RegisterCallSite(LogCallSite& callSite);
+	static uint32_t ProducerId();
 };
@@ -2,68 +2,70 @@
 /* Copyright(C) 2020 - 2020 WhatsappTray Sebastian Amann */
 
 // Implementation for the WinSock server.
+// NOTE: Built without the precompiled header, so it also builds on Linux. There the Logger of WhatsappTray does not exist.
 
+#ifdef _WIN32
 #include "stdafx.h"
+#include "Logger.h"
+#else
+#define LogDebug(...)
+#endif
 #include "WinSockServer.h"
 
+#include <stdlib.h>
 #include <string.h>
-//#include <winsock2.h>
-#include <atomic>
-#include "Logger.h"
-
-#pragma comment(lib, "ws2_32.lib")
+#include <algorithm>
 
 #undef MODULE_NAME
 #define MODULE_NAME "ServerSocket"
 
-#define LogDebug(message, ...) //Logger::Info(MODULE_NAME "::" __FUNCTION__ " - " message "\n", __VA_ARGS__)
-
-static bool SocketDoProcessing(char portString[]);
-static bool SetupSocket(char portString[]);
-static bool ProcessClientSocket(SOCKET remoteSocket, std::string& messageFromClient);
-static int WaitForNewMesaageWithTimeout(SOCKET clientSocket, FD_SET& readSet, long sec, long usec);
-
-static std::atomic<bool> isRunning = false;
-static SOCKET listenSocket = INVALID_SOCKET;
-static std::function<void(std::string)> socketMessageReceivedEvent = NULL;
+/* How often select() returns to check if the server was stopped, in case the wake-up of Stop() got lost, and to close stalled clients. */
+constexpr long selectTimeoutSec = 1;
+/* Places in the fd_set are needed for the listen-socket and the datagram-socket.
+ * On Linux FD_SETSIZE limits the value of the socket instead of the count, so there some values are left for the other sockets of the process. */
+#ifdef _WIN32
+constexpr size_t maxClientCount = FD_SETSIZE - 2;
+#else
+constexpr size_t maxClientCount = FD_SETSIZE / 2;
+#endif
 
 /**
- * @brief Initialize socket
- *
- * @param portString The port the socket is running on
+ * @brief Initialize socket and receive until Stop() is called.
 */
-bool SocketStart(char portString[])
+bool WinSockServer::Run()
 {
-	isRunning = true;
-
 	// Initialize Winsock
-	WSADATA wsaData;
-	int nResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
-
-	if (NO_ERROR != nResult) {
+	if (StartupSockets() == false) {
 		LogDebug("Error occurred while executing WSAStartup().");
 		return false;
 	}
 
 	LogDebug("WSAStartup() successful.");
 
-	SocketDoProcessing(portString);
+	DoProcessing();
 
 	// Cleanup Winsock
-	WSACleanup();
+	CleanupSockets();
 	return true;
 }
 
-static bool SocketDoProcessing(char portString[])
+/**
+ * @brief The event-loop of the server.
+ *
+ * All sockets are non-blocking and one select()-call waits for new connections and for data from all connected clients.
+ * This way a slow or stalled client can not block the other clients.
+*/
+bool WinSockServer::DoProcessing()
 {
 	bool success = true;
 
-	if (SetupSocket(portString) == false) {
+	if (SetupSocket() == false) {
 		return false;
 	}
 
-	if (SOCKET_ERROR == listen(listenSocket, SOMAXCONN)) {
-		closesocket(listenSocket);
+	if (SOCKET_ERROR == listen(_listenSocket, SOMAXCONN)) {
+		closesocket(_listenSocket);
+		_listenSocket = INVALID_SOCKET;
 
 		LogDebug("Error occurred while listening.");
 		return false;
@@ -71,166 +73,355 @@ static bool SocketDoProcessing(char portString[])
 
 	LogDebug("Listen to port successful.");
 
-	struct sockaddr_in clientAddress{};
-	int clientSize = sizeof(clientAddress);
+	if (SetupDatagramSocket() == false) {
+		LogDebug("Traces of the hook are not received.");
+	}
+
 	while (true) {
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		// When all places are taken, new connections wait in the backlog of the listen-socket until a client disconnects.
+		bool isAccepting = _clientConnections.size() < maxClientCount;
+		if (isAccepting) {
+			FD_SET(_listenSocket, &readSet);
+		}
+		SOCKET maxSocket = _listenSocket;
+		if (_datagramSocket != INVALID_SOCKET) {
+			FD_SET(_datagramSocket, &readSet);
+			maxSocket = (std::max)(maxSocket, _datagramSocket);
+		}
+		for (auto& client : _clientConnections) {
+			FD_SET(client.socket, &readSet);
+			maxSocket = (std::max)(maxSocket, client.socket);
+		}
 
-		LogDebug("Wait for a client to connect.");
-		SOCKET clientSocket = accept(listenSocket, (struct sockaddr*)&clientAddress, &clientSize);
+		timeval timeoutTime;
+		timeoutTime.tv_sec = selectTimeoutSec;
+		timeoutTime.tv_usec = 0;
 
-		if (INVALID_SOCKET == clientSocket) {
-			if (isRunning == false) {
-				LogDebug("Listening on socket for new connection stopped.");
-				break;
-			}
+		// NOTE: selRet has the cout of sockets that are ready
+		auto selRet = select(SelectSocketCount(maxSocket), &readSet, NULL, NULL, &timeoutTime);
+
+		if (_isRunning == false) {
+			LogDebug("Listening on socket for new connection stopped.");
+			break;
+		}
 
-			auto errorNo = WSAGetLastError();
-			LogDebug("Error occurred while accepting socket: %ld.", errorNo);
+		if (selRet == SOCKET_ERROR) {
+			LogDebug("Error occurred while using select() on socket: %ld.", LastSocketError());
 
 			success = false;
 			break;
 		}
-		else {
-			LogDebug("Accept() successful.");
+
+		if (isAccepting && FD_ISSET(_listenSocket, &readSet)) {
+			AcceptClients();
+		}
+
+		if (_datagramSocket != INVALID_SOCKET && FD_ISSET(_datagramSocket, &readSet)) {
+			ReceiveDatagrams();
+		}
+
+		for (auto& client : _clientConnections) {
+			if (FD_ISSET(client.socket, &readSet) == false || ReceiveFromClient(client)) {
+				continue;
+			}
+
+			LogDebug("Close connection to client.");
+			closesocket(client.socket);
+			client.socket = INVALID_SOCKET;
 		}
 
-		LogDebug("Client connected from: %s", inet_ntoa(clientAddress.sin_addr));
+		CloseStalledClients();
+
+		_clientConnections.erase(std::remove_if(_clientConnections.begin(), _clientConnections.end(), [](const ClientConnection& client) {
+			return client.socket == INVALID_SOCKET;
+		}), _clientConnections.end());
+	}
 
-		std::string messageFromClient;
-		auto clientProcessingSuccessful = ProcessClientSocket(clientSocket, messageFromClient);
+	if (INVALID_SOCKET != _listenSocket) {
+		closesocket(_listenSocket);
+		_listenSocket = INVALID_SOCKET;
 	}
 
-	if (INVALID_SOCKET != listenSocket) {
-		closesocket(listenSocket);
+	if (INVALID_SOCKET != _datagramSocket) {
+		closesocket(_datagramSocket);
+		_datagramSocket = INVALID_SOCKET;
 	}
+
+	CloseAllClients();
+
 	return success;
 }
 
-void SocketNotifyOnNewMessage(const std::function<void(std::string)>& messageReceivedEvent)
+/**
+ * @brief Accept the pending connections, as long as there are places for them.
+ *
+ * The rest stays in the backlog. Refusing them would lose the messages that the hooks already sent.
+*/
+void WinSockServer::AcceptClients()
 {
-	socketMessageReceivedEvent = messageReceivedEvent;
-}
+	while (_clientConnections.size() < maxClientCount) {
+		struct sockaddr_in clientAddress{};
+		socklen_t clientSize = sizeof(clientAddress);
+		SOCKET clientSocket = accept(_listenSocket, (struct sockaddr*)&clientAddress, &clientSize);
 
-void SocketStopServer()
-{
-	isRunning = false;
-	// NOTE: closesocket() can be calld on invalid sockets, so there is no handling for that necessary
-	closesocket(listenSocket);
-	listenSocket = INVALID_SOCKET;
+		if (INVALID_SOCKET == clientSocket) {
+			auto errorNo = LastSocketError();
+			if (IsWouldBlock(errorNo) == false) {
+				LogDebug("Error occurred while accepting socket: %ld.", errorNo);
+			}
+			return;
+		}
+		// NOTE: inet_ntoa() is deprecated.
+		[[maybe_unused]] uint32_t address = ntohl(clientAddress.sin_addr.s_addr);
+		LogDebug("Client connected from: %u.%u.%u.%u", address >> 24, (address >> 16) & 0xFF, (address >> 8) & 0xFF, address & 0xFF);
+
+		// NOTE: On Linux a socket with a value of FD_SETSIZE or more does not fit into the fd_set.
+		if (SelectSocketCount(clientSocket) > FD_SETSIZE || SetSocketNonBlocking(clientSocket, true) == false) {
+			LogDebug("Connection refused.");
+			closesocket(clientSocket);
+			continue;
+		}
+
+		_clientConnections.push_back(ClientConnection{ clientSocket, FrameReader() });
+	}
 }
 
 /**
- * @brief Create a socket
+ * @brief Receive the available data from the client and forward all complete frames.
+ *
+ * The client keeps the connection open and sends one frame per message. It does not wait for an answer.
+ * @return False if the connection should be closed.
 */
-static bool SetupSocket(char portString[])
+bool WinSockServer::ReceiveFromClient(ClientConnection& client)
 {
-	SOCKET listenSocketTemp = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	const int messageBufferSize = 16 * 1024;
+	char messageBuffer[messageBufferSize];
 
-	if (INVALID_SOCKET == listenSocketTemp) {
-		LogDebug("Error occurred while opening socket: %ld.", WSAGetLastError());
+	int nBytesRecv = static_cast<int>(recv(client.socket, messageBuffer, messageBufferSize, 0));
+
+	if (SOCKET_ERROR == nBytesRecv) {
+		if (IsWouldBlock(LastSocketError())) {
+			return true;
+		}
+		LogDebug("Error occurred while receiving from socket.");
+		return false;
+	}
+	if (nBytesRecv == 0) {
+		LogDebug("Client closed the connection.");
 		return false;
 	}
 
-	LogDebug("socket() successful.");
-
-	struct sockaddr_in ServerAddress{};
-	// Cleanup and Init with 0 the ServerAddress
-	ZeroMemory((char*)&ServerAddress, sizeof(ServerAddress));
-
-	// Port number will be supplied as a commandline argument
-	int nPortNo = atoi(portString);
-
-	// Fill up the address structure
-	ServerAddress.sin_family = AF_INET;
-	ServerAddress.sin_addr.s_addr = INADDR_ANY; // WinSock will supply address
-	ServerAddress.sin_port = htons(nPortNo);    //comes from commandline
+	client.frameReader.Append(messageBuffer, nBytesRecv);
 
-	// Assign local address and port number
-	if (SOCKET_ERROR == bind(listenSocketTemp, (struct sockaddr*)&ServerAddress, sizeof(ServerAddress))) {
-		closesocket(listenSocketTemp);
+	std::string messageFromClient;
+	while (client.frameReader.NextFrame(messageFromClient)) {
+		ForwardRecord(messageFromClient);
+	}
 
-		LogDebug("Error occurred while binding.");
+	if (client.frameReader.HasError()) {
+		LogDebug("Received invalid frame.");
 		return false;
 	}
-	else {
-		LogDebug("bind() successful.");
-	}
 
-	listenSocket = listenSocketTemp;
+	bool hasPartialFrame = client.frameReader.PendingSize() > 0;
+	if (hasPartialFrame && client.hasPartialFrame == false) {
+		client.partialFrameStart = std::chrono::steady_clock::now();
+	}
+	client.hasPartialFrame = hasPartialFrame;
 
 	return true;
 }
 
-static bool ProcessClientSocket(SOCKET clientSocket, std::string& messageFromClient)
+/**
+ * @brief Close the clients that stopped in the middle of a frame for longer than the partial-frame-timeout.
+ *
+ * Their frame can not be completed anymore, for example because the hooked process hangs. A new connection of the same process starts with a new frame.
+*/
+void WinSockServer::CloseStalledClients()
 {
-	FD_SET readSet;
+	auto now = std::chrono::steady_clock::now();
+	for (auto& client : _clientConnections) {
+		if (client.socket == INVALID_SOCKET || client.hasPartialFrame == false || now - client.partialFrameStart < _partialFrameTimeout) {
+			continue;
+		}
 
-	auto selRet = WaitForNewMesaageWithTimeout(clientSocket, readSet, 10, 0);
-	if (selRet == SOCKET_ERROR) {
-		LogDebug("Error occurred while using select() on socket.");
-		return false;
-	}
-	else if (selRet == 0) {
-		LogDebug("Waiting for message timeout.");
-		return false;
+		LogDebug("Close connection to client, because it did not complete its frame within %lld seconds.", static_cast<long long>(_partialFrameTimeout.count()));
+		ForwardLine("<Connection closed, because the hook stopped in the middle of a message>", 0);
+		closesocket(client.socket);
+		client.socket = INVALID_SOCKET;
 	}
+}
 
-	if (FD_ISSET(clientSocket, &readSet)) {
-		// Init messageBuffer with 0
-		const int messageBufferSize = 2000;
-		char messageBuffer[messageBufferSize];
-		ZeroMemory(messageBuffer, messageBufferSize);
+/**
+ * @brief Receive all pending trace-datagrams and forward them.
+ *
+ * Lost datagrams are reported as one log-line per gap.
+*/
+void WinSockServer::ReceiveDatagrams()
+{
+	// Big enough for every datagram. Bigger datagrams are not sent by the hook.
+	static char datagramBuffer[datagramHeaderSize + datagramMaxPayloadSize];
 
-		// Receive data from a connected or bound socket
-		int nBytesRecv = recv(clientSocket, messageBuffer, messageBufferSize - 1, 0);
+	std::string record;
+	while (true) {
+		int nBytesRecv = static_cast<int>(recvfrom(_datagramSocket, datagramBuffer, sizeof(datagramBuffer), 0, NULL, NULL));
 
 		if (SOCKET_ERROR == nBytesRecv) {
-			LogDebug("Error occurred while receiving from socket.");
-
-			closesocket(clientSocket);
-			return false;
+			auto errorNo = LastSocketError();
+			// NOTE: WSAECONNRESET and WSAEMSGSIZE only affect one datagram, so just continue with the next one.
+			if (IsDatagramError(errorNo)) {
+				continue;
+			}
+			if (IsWouldBlock(errorNo) == false) {
+				LogDebug("Error occurred while receiving datagram: %ld.", errorNo);
+			}
+			return;
 		}
-		LogDebug("recv() successful.");
 
-		messageFromClient = std::string(messageBuffer);
+		uint32_t producerId;
+		uint32_t sequence;
+		if (TraceDatagram::ReadDatagram(datagramBuffer, nBytesRecv, producerId, sequence, record) == false) {
+			continue;
+		}
 
-		if (socketMessageReceivedEvent) {
-			socketMessageReceivedEvent(messageFromClient);
+		uint32_t lostCount = _datagramGapDetector.Track(producerId, sequence);
+		if (lostCount > 0) {
+			ForwardLine("<" + std::to_string(lostCount) + " traces of producer " + std::to_string(producerId) + " lost>", producerId);
 		}
+
+		ForwardRecord(record);
+	}
+}
+
+void WinSockServer::CloseAllClients()
+{
+	for (auto& client : _clientConnections) {
+		closesocket(client.socket);
+	}
+	_clientConnections.clear();
+}
+
+/**
+ * @brief Lets Run() return. Can be called from any thread.
+ *
+ * The sockets are closed by the socket-thread itself. Closing them here could close a socket while select() waits for it, or a new socket that got the same handle.
+*/
+void WinSockServer::Stop()
+{
+	_isRunning = false;
+	WakeUpSocketThread();
+}
+
+/**
+ * @brief Sends an empty datagram to the datagram-socket, so select() returns immediately.
+ *
+ * Without the datagram-socket, the socket-thread notices the stop after selectTimeoutSec.
+*/
+void WinSockServer::WakeUpSocketThread()
+{
+	SOCKET wakeUpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (INVALID_SOCKET == wakeUpSocket) {
+		return;
+	}
+
+	struct sockaddr_in serverAddress{};
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	serverAddress.sin_port = htons(atoi(_portString.c_str()));
+
+	// The empty datagram is ignored by ReceiveDatagrams(), because it has no header.
+	sendto(wakeUpSocket, "", 0, 0, (struct sockaddr*)&serverAddress, sizeof(serverAddress));
+	closesocket(wakeUpSocket);
+}
+
+/**
+ * @brief Create the UDP-socket for the traces on the same port as the listen-socket.
+ *
+ * Only bound to loopback, because the traces only come from the hooked processes on this machine.
+*/
+bool WinSockServer::SetupDatagramSocket()
+{
+	SOCKET datagramSocketTemp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (INVALID_SOCKET == datagramSocketTemp) {
+		LogDebug("Error occurred while opening datagram-socket: %ld.", LastSocketError());
+		return false;
 	}
 
-	// Send data to connected client
-	std::string messageToClient = "Message received successfully";
-	int nBytesSent = send(clientSocket, messageToClient.c_str(), (int)messageToClient.length(), 0);
+	struct sockaddr_in serverAddress{};
+	serverAddress.sin_family = AF_INET;
+	serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	serverAddress.sin_port = htons(atoi(_portString.c_str()));
 
-	if (SOCKET_ERROR == nBytesSent) {
-		LogDebug("Error occurred while writing message to Client to socket.");
+	if (SOCKET_ERROR == bind(datagramSocketTemp, (struct sockaddr*)&serverAddress, sizeof(serverAddress))) {
+		closesocket(datagramSocketTemp);
 
-		closesocket(clientSocket);
+		LogDebug("Error occurred while binding datagram-socket.");
 		return false;
 	}
-	LogDebug("Send message to Client successful.");
 
-	closesocket(clientSocket);
+	if (SetSocketNonBlocking(datagramSocketTemp, true) == false) {
+		closesocket(datagramSocketTemp);
+
+		LogDebug("Error occurred while setting the datagram-socket to non-blocking.");
+		return false;
+	}
+
+	// A bigger receive-buffer, so bursts of traces are not lost while the socket-thread is busy.
+	int receiveBufferSize = 1024 * 1024;
+	setsockopt(datagramSocketTemp, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&receiveBufferSize), sizeof(receiveBufferSize));
+
+	_datagramSocket = datagramSocketTemp;
 
 	return true;
 }
 
 /**
- * @brief Wait with timeout for new message.
- *
- * @return The cout of sockets that have data or SOCKET_ERROR
+ * @brief Create a socket
 */
-static int WaitForNewMesaageWithTimeout(SOCKET clientSocket, FD_SET& readSet, long sec, long usec)
+bool WinSockServer::SetupSocket()
 {
-	FD_ZERO(&readSet);
-	FD_SET(clientSocket, &readSet);
-	timeval timeoutTime;
-	timeoutTime.tv_sec = sec;
-	timeoutTime.tv_usec = usec;
+	SOCKET listenSocketTemp = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	if (INVALID_SOCKET == listenSocketTemp) {
+		LogDebug("Error occurred while opening socket: %ld.", LastSocketError());
+		return false;
+	}
+
+	LogDebug("socket() successful.");
+
+	struct sockaddr_in ServerAddress{};
 
-	// NOTE: selRet has the cout of sockets that are ready
-	auto selRet = select(NULL, &readSet, NULL, NULL, &timeoutTime);
+	// Port number will be supplied as a commandline argument
+	int nPortNo = atoi(_portString.c_str());
 
-	return selRet;
+	// Fill up the address structure
+	ServerAddress.sin_family = AF_INET;
+	ServerAddress.sin_addr.s_addr = INADDR_ANY; // WinSock will supply address
+	ServerAddress.sin_port = htons(nPortNo);    //comes from commandline
+
+	// Assign local address and port number
+	if (SOCKET_ERROR == bind(listenSocketTemp, (struct sockaddr*)&ServerAddress, sizeof(ServerAddress))) {
+		closesocket(listenSocketTemp);
+
+		LogDebug("Error occurred while binding.");
+		return false;
+	}
+	else {
+		LogDebug("bind() successful.");
+	}
+
+	// accept() is only called when select() reports a new connection, but it still must never block the event-loop.
+	if (SetSocketNonBlocking(listenSocketTemp, true) == false) {
+		closesocket(listenSocketTemp);
+
+		LogDebug("Error occurred while setting the socket to non-blocking.");
+		return false;
+	}
+
+	_listenSocket = listenSocketTemp;
+
+	return true;
 }
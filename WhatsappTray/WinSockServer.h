@@ -1,11 +1,63 @@
 /* SPDX-License-Identifier: GPL-3.0-only */
 /* Copyright(C) 2020 - 2020 WhatsappTray Sebastian Amann */
 
+// Receives the log-messages of the hooks over TCP and their traces over UDP.
+// NOTE: Only uses the sockets through PortableSocket.h, so it also builds on Linux for the benchmark. (See benchmarks/TcpServerBenchmark.cpp)
+
 #pragma once
 
-#include <iostream>
-#include <functional>
+#include "LogServer.h"
+#include "MessageFraming.h"
+#include "PortableSocket.h"
+#include "TraceDatagram.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+class WinSockServer : public LogServer
+{
+public:
+	/* A client that sent the beginning of a frame has to send the rest within this time. Otherwise it is closed, so it does not hold its buffer and socket forever.
+	 * NOTE: Idle connections are not closed. The hook keeps its connection open and only reconnects after the connection broke. */
+	static constexpr std::chrono::seconds defaultPartialFrameTimeout = std::chrono::seconds(10);
+
+	WinSockServer(const char portString[], std::chrono::seconds partialFrameTimeout = defaultPartialFrameTimeout) : _portString(portString), _partialFrameTimeout(partialFrameTimeout) { }
+
+	bool Run() override;
+	void Stop() override;
+
+private:
+	struct ClientConnection
+	{
+		SOCKET socket;
+		FrameReader frameReader;
+		/* Since when the frameReader holds the beginning of a frame. Only valid if hasPartialFrame is true. */
+		std::chrono::steady_clock::time_point partialFrameStart;
+		bool hasPartialFrame = false;
+	};
+
+	std::string _portString;
+	std::chrono::seconds _partialFrameTimeout;
+	/* Only reset by Stop(), so a Stop() before Run() is not lost. */
+	std::atomic<bool> _isRunning = true;
+	/* Only used from the socket-thread. Also closed there, because closing it while select() waits for it is not safe. */
+	SOCKET _listenSocket = INVALID_SOCKET;
+	/* Receives the traces of the hook. (See TraceDatagram.h) INVALID_SOCKET if it could not be created. Then the server works without traces. */
+	SOCKET _datagramSocket = INVALID_SOCKET;
+	/* Only used from the socket-thread. */
+	DatagramGapDetector _datagramGapDetector;
+	/* All connected clients. Only used from the socket-thread. */
+	std::vector<ClientConnection> _clientConnections;
 
-bool SocketStart(char portString[]);
-void SocketNotifyOnNewMessage(const std::function<void(std::string)>& messageReceivedEvent);
-void SocketStopServer();
+	bool DoProcessing();
+	bool SetupSocket();
+	bool SetupDatagramSocket();
+	void AcceptClients();
+	bool ReceiveFromClient(ClientConnection& client);
+	void ReceiveDatagrams();
+	void CloseStalledClients();
+	void CloseAllClients();
+	void WakeUpSocketThread();
+};
@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures how long a thread that logs waits for the log-file. (See WhatsappTray/LogFileWriter.h)
+// - sync:  Every line is written and flushed by the thread that logs. That is what Logger::WriteLine() did before the LogFileWriter.
+// - async: The line is appended to the front-buffer of the LogFileWriter and its writer-thread writes the file.
+// Both cases write into a real file, so the disk is part of the measurement. The file is deleted at the end.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -pthread -o LogFileWriterBenchmark benchmarks/LogFileWriterBenchmark.cpp
+// Build on Windows: cl /std:c++17 /O2 /EHsc benchmarks\LogFileWriterBenchmark.cpp
+//
+// Usage: LogFileWriterBenchmark [--lines=<count>] [--size=<bytes>] [--threads=<count>] [--file=<path>]
+// Prints lines/s and the percentiles of the time that one call took for the thread that logs.
+
+#include "../WhatsappTray/LogFileWriter.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct BenchmarkConfig
+{
+	uint64_t lineCount = 200000;
+	size_t lineSize = 80;
+	unsigned threadCount = 2;
+	std::string filePath = "LogFileWriterBenchmark.log";
+};
+
+void PrintResult(const char* caseName, const BenchmarkConfig& config, std::chrono::steady_clock::duration duration, std::vector<int64_t>& callDurations)
+{
+	double seconds = std::chrono::duration<double>(duration).count();
+	std::sort(callDurations.begin(), callDurations.end());
+	auto percentile = [&](double fraction) { return callDurations[static_cast<size_t>(fraction * (callDurations.size() - 1))] / 1000.0; };
+	printf("%-6s lines=%llu time=%.3fs %.0f lines/s call: p50=%.2fus p99=%.2fus p99.9=%.2fus max=%.2fus\n", caseName, static_cast<unsigned long long>(config.lineCount),
+		seconds, config.lineCount / seconds, percentile(0.5), percentile(0.99), percentile(0.999), callDurations.back() / 1000.0);
+}
+
+/**
+ * @brief Lets the threads log their share of the lines and measures every call.
+ *
+ * @param logLine Called for every line. Has to be thread-safe.
+ * @param finish Called after all threads are done. Writes what is left.
+ */
+template<typename LogFunction, typename FinishFunction>
+void RunBenchmark(const char* caseName, const BenchmarkConfig& config, LogFunction logLine, FinishFunction finish)
+{
+	std::string line(config.lineSize > 1 ? config.lineSize - 1 : 0, 'x');
+	line += '\n';
+	std::vector<std::vector<int64_t>> threadCallDurations(config.threadCount);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned thread = 0; thread < config.threadCount; thread++) {
+		threads.emplace_back([&, thread]() {
+			uint64_t count = config.lineCount / config.threadCount + (thread < config.lineCount % config.threadCount ? 1 : 0);
+			auto& callDurations = threadCallDurations[thread];
+			callDurations.reserve(count);
+			for (uint64_t i = 0; i < count; i++) {
+				auto callStart = std::chrono::steady_clock::now();
+				logLine(line);
+				callDurations.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - callStart).count());
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	finish();
+	auto duration = std::chrono::steady_clock::now() - start;
+
+	std::vector<int64_t> callDurations;
+	for (auto& durations : threadCallDurations) {
+		callDurations.insert(callDurations.end(), durations.begin(), durations.end());
+	}
+	PrintResult(caseName, config, duration, callDurations);
+}
+
+void RunSync(const BenchmarkConfig& config)
+{
+	std::ofstream logFile(config.filePath, std::ios::out | std::ios::trunc | std::ios::binary);
+	std::mutex logFileMutex;
+	RunBenchmark("sync", config, [&](const std::string& line) {
+		std::lock_guard<std::mutex> lock(logFileMutex);
+		logFile << line;
+		logFile.flush();
+	}, []() { });
+}
+
+void RunAsync(const BenchmarkConfig& config)
+{
+	std::ofstream logFile(config.filePath, std::ios::out | std::ios::trunc | std::ios::binary);
+	LogFileWriter writer;
+	writer.Start(logFile);
+	RunBenchmark("async", config, [&](const std::string& line) { writer.Append(line); }, [&]() { writer.Stop(); });
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig config;
+
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		if (strncmp(argument, "--lines=", 8) == 0) {
+			config.lineCount = strtoull(argument + 8, nullptr, 10);
+		} else if (strncmp(argument, "--size=", 7) == 0) {
+			config.lineSize = static_cast<size_t>(strtoull(argument + 7, nullptr, 10));
+		} else if (strncmp(argument, "--threads=", 10) == 0) {
+			config.threadCount = static_cast<unsigned>(strtoul(argument + 10, nullptr, 10));
+		} else if (strncmp(argument, "--file=", 7) == 0) {
+			config.filePath = argument + 7;
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\nUsage: LogFileWriterBenchmark [--lines=<count>] [--size=<bytes>] [--threads=<count>] [--file=<path>]\n", argument);
+			return 1;
+		}
+	}
+	if (config.lineCount == 0 || config.threadCount == 0) {
+		fprintf(stderr, "ERROR: --lines and --threads have to be at least 1.\n");
+		return 1;
+	}
+
+	RunSync(config);
+	RunAsync(config);
+	remove(config.filePath.c_str());
+	return 0;
+}
@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures the formatting of a log-line of WhatsappTray, before and after it was moved into one engine. (See WhatsappTray/LogFormat.h)
+// - string_format old: snprintf() twice, once for the length and once into a new char-array, then copied into the returned string.
+// - string_format new: string_format() of SharedDefines.h, which formats once into a LogFormatBuffer.
+// - LogInfo old:       What LogInfo() did: "module::function: " + string_format() concatenated, then passed to Logger::Info(), whose LogVariadic() formatted the text again into 5000 bytes on the stack.
+// - LogInfo new:       What Logger::LogFunction() does: The prefix and the text formatted into one LogFormatBuffer.
+// The writing of the line is not part of the measurement. Every case ends where Logger::ProcessLog() is called.
+// With --titleSize the lines can be made longer than the buffer on the stack. The old LogInfo() cuts them at 5000 bytes, which the printed line-size shows.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -o LogFormatBenchmark benchmarks/LogFormatBenchmark.cpp
+// Build on Windows: cl /std:c++17 /O2 /EHsc benchmarks\LogFormatBenchmark.cpp
+//
+// Usage: LogFormatBenchmark [--lines=<count>] [--titleSize=<bytes>]
+
+#include "../WhatsappTray/LogFormat.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace
+{
+
+/* A typical line of WhatsappTray. */
+constexpr const char* benchmarkModule = "WhatsappTray";
+constexpr const char* benchmarkFunction = "WindowProc";
+constexpr const char* benchmarkFormat = "title '%s' hwnd=%p count=%d";
+
+/* Keeps the compiler from dropping the work of a case. */
+volatile size_t benchmarkSink = 0;
+
+template<typename ... Args>
+std::string OldStringFormat(const std::string& format, Args ... args)
+{
+	size_t size = snprintf(nullptr, 0, format.c_str(), args ...) + 1ll;
+	std::unique_ptr<char[]> buf(new char[size]);
+	snprintf(buf.get(), size, format.c_str(), args ...);
+	return std::string(buf.get(), buf.get() + size - 1);
+}
+
+template<typename ... Args>
+std::string NewStringFormat(const std::string& format, Args ... args)
+{
+	LogFormatBuffer buffer;
+	buffer.AppendFormat(format.c_str(), args ...);
+	return buffer.ToString();
+}
+
+/**
+ * @brief Logger::LogVariadic() before the formatting engine. Returns the length of the line that went to ProcessLog().
+ */
+size_t OldLogVariadic(const char* format, ...)
+{
+	va_list argptr;
+	va_start(argptr, format);
+	const size_t buffersize = 5000;
+	char logStringBuffer[buffersize];
+	vsnprintf(logStringBuffer, buffersize, format, argptr);
+	va_end(argptr);
+	return strlen(logStringBuffer);
+}
+
+/**
+ * @brief Logger::Info() before the formatting engine.
+ */
+size_t OldInfo(const std::string& text)
+{
+	return OldLogVariadic((text + "\n").c_str());
+}
+
+/**
+ * @brief Logger::LogFunction() without the rate-limit.
+ */
+size_t NewLogFunction(const char* module, const char* function, const char* format, ...)
+{
+	LogFormatBuffer logText;
+	logText.Append(module);
+	logText.Append("::");
+	logText.Append(function);
+	logText.Append(": ");
+
+	va_list argptr;
+	va_start(argptr, format);
+	logText.AppendFormatV(format, argptr);
+	va_end(argptr);
+
+	logText.Append("\n");
+	return logText.Size();
+}
+
+void PrintResult(const char* caseName, uint64_t lineCount, std::chrono::steady_clock::duration duration, size_t lineSize)
+{
+	double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	printf("%-18s %8.1f ns/line %12.0f lines/s line=%zu bytes\n", caseName, nanoseconds / lineCount, lineCount / (nanoseconds / 1e9), lineSize);
+}
+
+template<typename Function>
+void RunCase(const char* caseName, uint64_t lineCount, Function formatLine)
+{
+	size_t lineSize = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < lineCount; i++) {
+		lineSize = formatLine(static_cast<int>(i));
+		benchmarkSink = benchmarkSink + lineSize;
+	}
+	PrintResult(caseName, lineCount, std::chrono::steady_clock::now() - start, lineSize);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t lineCount = 1000000;
+	size_t titleSize = 8;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--lines=", 8) == 0) {
+			lineCount = strtoull(argv[i] + 8, nullptr, 10);
+		} else if (strncmp(argv[i], "--titleSize=", 12) == 0) {
+			titleSize = static_cast<size_t>(strtoull(argv[i] + 12, nullptr, 10));
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\nUsage: LogFormatBenchmark [--lines=<count>] [--titleSize=<bytes>]\n", argv[i]);
+			return 1;
+		}
+	}
+	if (lineCount == 0) {
+		fprintf(stderr, "ERROR: --lines has to be at least 1.\n");
+		return 1;
+	}
+
+	std::string titleText(titleSize, 'W');
+	const char* title = titleText.c_str();
+	void* hwnd = reinterpret_cast<void*>(0x1234);
+
+	RunCase("string_format old", lineCount, [&](int count) { return OldStringFormat(benchmarkFormat, title, hwnd, count).size(); });
+	RunCase("string_format new", lineCount, [&](int count) { return NewStringFormat(benchmarkFormat, title, hwnd, count).size(); });
+	RunCase("LogInfo old", lineCount, [&](int count) {
+		return OldInfo(benchmarkModule + std::string("::") + std::string(benchmarkFunction) + ": " + OldStringFormat(benchmarkFormat, title, hwnd, count));
+	});
+	RunCase("LogInfo new", lineCount, [&](int count) { return NewLogFunction(benchmarkModule, benchmarkFunction, benchmarkFormat, title, hwnd, count); });
+	return 0;
+}
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures what a log-call costs the hook with the binary records, compared to formatting the text in the hook like before. (See WhatsappTray/LogRecord.h)
+// - formatted: snprintf() into a text-record. That is what the hook did before the call-sites were registered.
+// - record:    An event-record with the id of the call-site and the raw arguments. That is what the hook does now.
+// - decode:    Writing and formatting the event-record in WhatsappTray. (See WhatsappTray/LogRecordDecoder.h) The formatting moved from the hook to WhatsappTray.
+// Every case writes into the same reused buffer, like the hook does with the buffers of its pool.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -o LogRecordBenchmark benchmarks/LogRecordBenchmark.cpp
+// Build on Windows: cl /std:c++17 /O2 /EHsc benchmarks\LogRecordBenchmark.cpp
+//
+// Usage: LogRecordBenchmark [--messages=<count>]
+
+#include "../WhatsappTray/LogRecord.h"
+#include "../WhatsappTray/LogRecordDecoder.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+namespace
+{
+
+/* A typical line of the hook: A window-message with the handle and its parameters. */
+constexpr const char* benchmarkFormat = "hwnd=%p message=0x%X wParam=%llu lParam=%lld title='%s'";
+const char* const benchmarkTitle = "WhatsApp";
+
+/* Keeps the compiler from dropping the work of a case. */
+volatile size_t benchmarkSink = 0;
+
+void PrintResult(const char* caseName, uint64_t messageCount, std::chrono::steady_clock::duration duration, size_t recordSize)
+{
+	double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	printf("%-10s %8.1f ns/message %12.0f messages/s record=%zu bytes\n", caseName, nanoseconds / messageCount, messageCount / (nanoseconds / 1e9), recordSize);
+}
+
+void RunFormatted(uint64_t messageCount)
+{
+	std::string record;
+	char text[512];
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < messageCount; i++) {
+		record.clear();
+		LogRecordWriter::BeginText(record, 1);
+		int size = snprintf(text, sizeof(text), "%s::%s: ", "Hook", "RedirectedWndProc");
+		size += snprintf(text + size, sizeof(text) - size, benchmarkFormat, reinterpret_cast<void*>(0x1234 + i), static_cast<unsigned>(i & 0xFFFF), static_cast<unsigned long long>(i), static_cast<long long>(-i), benchmarkTitle);
+		record.append(text, static_cast<size_t>(size));
+		benchmarkSink = benchmarkSink + record.size();
+	}
+	PrintResult("formatted", messageCount, std::chrono::steady_clock::now() - start, record.size());
+}
+
+void RunRecord(uint64_t messageCount)
+{
+	std::string record;
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < messageCount; i++) {
+		record.clear();
+		LogRecordWriter::BeginEvent(record, 1, 1);
+		LogRecordWriter::AppendArguments(record, reinterpret_cast<void*>(0x1234 + i), static_cast<unsigned>(i & 0xFFFF), static_cast<unsigned long long>(i), static_cast<long long>(-i), benchmarkTitle);
+		benchmarkSink = benchmarkSink + record.size();
+	}
+	PrintResult("record", messageCount, std::chrono::steady_clock::now() - start, record.size());
+}
+
+void RunDecode(uint64_t messageCount)
+{
+	LogRecordDecoder decoder;
+	LogLine line;
+	LogCallSite callSite{ "Hook", "RedirectedWndProc", benchmarkFormat, 1 };
+	std::string record;
+	LogRecordWriter::BeginCallSite(record, 1, 1, callSite);
+	decoder.Decode(record, line);
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < messageCount; i++) {
+		record.clear();
+		LogRecordWriter::BeginEvent(record, 1, 1);
+		LogRecordWriter::AppendArguments(record, reinterpret_cast<void*>(0x1234 + i), static_cast<unsigned>(i & 0xFFFF), static_cast<unsigned long long>(i), static_cast<long long>(-i), benchmarkTitle);
+		decoder.Decode(record, line);
+		benchmarkSink = benchmarkSink + line.text.size();
+	}
+	PrintResult("decode", messageCount, std::chrono::steady_clock::now() - start, record.size());
+	printf("  %s\n", line.text.c_str());
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t messageCount = 2000000;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--messages=", 11) == 0) {
+			messageCount = strtoull(argv[i] + 11, nullptr, 10);
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\nUsage: LogRecordBenchmark [--messages=<count>]\n", argv[i]);
+			return 1;
+		}
+	}
+
+	RunFormatted(messageCount);
+	RunRecord(messageCount);
+	RunDecode(messageCount);
+	return 0;
+}
@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures how long a thread that logs waits for the log-file with the memory-mapped segments, compared to the ofstream. (See WhatsappTray/SegmentedLog.h)
+// - ofstream: Every line is written into the ofstream and flushed by the thread that logs. That is what the Logger did before the segments.
+// - writer:   The line is appended to the LogFileWriter, whose thread writes the ofstream. That is the fallback of the Logger, when no segment can be mapped.
+// - mmap:     The line is copied into the mapped segment by SegmentedLog, like Logger::AppendToLogFile() does. Full segments are sealed and the next one is opened.
+// All cases write real files, so the disk is part of the measurement. The files are deleted at the end.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -pthread -o LogSegmentBenchmark benchmarks/LogSegmentBenchmark.cpp
+// Build on Windows: The segments are mapped with the mmap()-stand-in of the tests, so the benchmark is only built on Linux.
+//
+// Usage: LogSegmentBenchmark [--lines=<count>] [--size=<bytes>] [--threads=<count>] [--segmentSize=<bytes>]
+// Prints lines/s, the percentiles of the time that one call took for the thread that logs and the count of files.
+
+#include "../WhatsappTray/LogFileWriter.h"
+#include "../WhatsappTray/SegmentedLog.h"
+#include "../tests/PosixMappedLogFile.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct BenchmarkConfig
+{
+	uint64_t lineCount = 1000000;
+	size_t lineSize = 80;
+	unsigned threadCount = 2;
+	size_t segmentSize = defaultLogSegmentSize;
+};
+
+void PrintResult(const char* caseName, const BenchmarkConfig& config, std::chrono::steady_clock::duration duration, std::vector<int64_t>& callDurations, size_t fileCount)
+{
+	double seconds = std::chrono::duration<double>(duration).count();
+	std::sort(callDurations.begin(), callDurations.end());
+	auto percentile = [&](double fraction) { return callDurations[static_cast<size_t>(fraction * (callDurations.size() - 1))] / 1000.0; };
+	printf("%-8s lines=%llu time=%.3fs %.0f lines/s call: p50=%.2fus p99=%.2fus p99.9=%.2fus max=%.2fus files=%zu\n", caseName, static_cast<unsigned long long>(config.lineCount),
+		seconds, config.lineCount / seconds, percentile(0.5), percentile(0.99), percentile(0.999), callDurations.back() / 1000.0, fileCount);
+}
+
+/**
+ * @brief Lets the threads log their share of the lines and measures every call.
+ *
+ * @param logLine Called for every line. Has to be thread-safe.
+ * @param finish Called after all threads are done. Writes what is left.
+ */
+template<typename LogFunction, typename FinishFunction>
+void RunBenchmark(const char* caseName, const BenchmarkConfig& config, size_t& fileCount, LogFunction logLine, FinishFunction finish)
+{
+	std::string line(config.lineSize > 1 ? config.lineSize - 1 : 0, 'x');
+	line += '\n';
+	std::vector<std::vector<int64_t>> threadCallDurations(config.threadCount);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned thread = 0; thread < config.threadCount; thread++) {
+		threads.emplace_back([&, thread]() {
+			uint64_t count = config.lineCount / config.threadCount + (thread < config.lineCount % config.threadCount ? 1 : 0);
+			auto& callDurations = threadCallDurations[thread];
+			callDurations.reserve(count);
+			for (uint64_t i = 0; i < count; i++) {
+				auto callStart = std::chrono::steady_clock::now();
+				logLine(line);
+				callDurations.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - callStart).count());
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	finish();
+	auto duration = std::chrono::steady_clock::now() - start;
+
+	std::vector<int64_t> callDurations;
+	for (auto& durations : threadCallDurations) {
+		callDurations.insert(callDurations.end(), durations.begin(), durations.end());
+	}
+	PrintResult(caseName, config, duration, callDurations, fileCount);
+}
+
+void RunOfstream(const BenchmarkConfig& config, const std::string& directory)
+{
+	std::string path = directory + "/ofstream.txt";
+	std::ofstream logFile(path, std::ios::out | std::ios::trunc | std::ios::binary);
+	std::mutex logFileMutex;
+	size_t fileCount = 1;
+	RunBenchmark("ofstream", config, fileCount, [&](const std::string& line) {
+		std::lock_guard<std::mutex> lock(logFileMutex);
+		logFile << line;
+		logFile.flush();
+	}, []() { });
+	logFile.close();
+	remove(path.c_str());
+}
+
+void RunWriter(const BenchmarkConfig& config, const std::string& directory)
+{
+	std::string path = directory + "/writer.txt";
+	std::ofstream logFile(path, std::ios::out | std::ios::trunc | std::ios::binary);
+	LogFileWriter writer;
+	writer.Start(logFile);
+	size_t fileCount = 1;
+	RunBenchmark("writer", config, fileCount, [&](const std::string& line) { writer.Append(line); }, [&]() { writer.Stop(); });
+	logFile.close();
+	remove(path.c_str());
+}
+
+void RunMappedSegments(const BenchmarkConfig& config, const std::string& directory)
+{
+	// Only touched by SegmentedLog under its exclusive lock.
+	std::vector<std::string> paths;
+	SegmentedLog<PosixMappedLogFile> log([&](PosixMappedLogFile& file, size_t minimumSize) {
+		std::string path = directory + "/mmap_" + std::to_string(paths.size()) + ".txt";
+		if (file.Open(path, (std::max)(config.segmentSize, minimumSize)) == false) {
+			return false;
+		}
+		paths.push_back(path);
+		return true;
+	});
+	if (log.Open() == false) {
+		fprintf(stderr, "ERROR: The first segment could not be mapped.\n");
+		return;
+	}
+
+	uint64_t failedCount = 0;
+	size_t fileCount = 0;
+	RunBenchmark("mmap", config, fileCount, [&](const std::string& line) {
+		if (log.Append(line.data(), line.size()) == false) {
+			failedCount++;
+		}
+	}, [&]() {
+		log.Close();
+		fileCount = paths.size();
+	});
+	if (failedCount > 0) {
+		fprintf(stderr, "ERROR: %llu lines could not be written.\n", static_cast<unsigned long long>(failedCount));
+	}
+	for (auto& path : paths) {
+		remove(path.c_str());
+	}
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig config;
+
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		if (strncmp(argument, "--lines=", 8) == 0) {
+			config.lineCount = strtoull(argument + 8, nullptr, 10);
+		} else if (strncmp(argument, "--size=", 7) == 0) {
+			config.lineSize = static_cast<size_t>(strtoull(argument + 7, nullptr, 10));
+		} else if (strncmp(argument, "--threads=", 10) == 0) {
+			config.threadCount = static_cast<unsigned>(strtoul(argument + 10, nullptr, 10));
+		} else if (strncmp(argument, "--segmentSize=", 14) == 0) {
+			config.segmentSize = static_cast<size_t>(strtoull(argument + 14, nullptr, 10));
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\nUsage: LogSegmentBenchmark [--lines=<count>] [--size=<bytes>] [--threads=<count>] [--segmentSize=<bytes>]\n", argument);
+			return 1;
+		}
+	}
+	if (config.lineCount == 0 || config.threadCount == 0 || config.segmentSize == 0) {
+		fprintf(stderr, "ERROR: --lines, --threads and --segmentSize have to be at least 1.\n");
+		return 1;
+	}
+
+	char directoryTemplate[] = "/tmp/LogSegmentBenchmark-XXXXXX";
+	if (mkdtemp(directoryTemplate) == nullptr) {
+		fprintf(stderr, "ERROR: The directory for the log-files could not be created.\n");
+		return 1;
+	}
+	RunOfstream(config, directoryTemplate);
+	RunWriter(config, directoryTemplate);
+	RunMappedSegments(config, directoryTemplate);
+	rmdir(directoryTemplate);
+	return 0;
+}
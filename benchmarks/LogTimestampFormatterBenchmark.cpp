@@ -0,0 +1,120 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures what the timestamp costs every log-line of WhatsappTray, before and after it was cached. (See WhatsappTray/LogTimestampFormatter.h)
+// - put_time: What Logger::GetTimeString() did for every line: A new ostringstream, localtime() and put_time(), then the milliseconds with setw(), and the line built by concatenating strings.
+// - cached:   LogTimestampFormatter appends into a reused buffer. localtime() and strftime() only run when the second changes.
+// The time of the lines is simulated, so the count of lines per second and with it how often the cached second changes can be chosen.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -o LogTimestampFormatterBenchmark benchmarks/LogTimestampFormatterBenchmark.cpp
+// Build on Windows: cl /std:c++17 /O2 /EHsc benchmarks\LogTimestampFormatterBenchmark.cpp
+//
+// Usage: LogTimestampFormatterBenchmark [--lines=<count>] [--linesPerSecond=<count>]
+
+#include "../WhatsappTray/LogTimestampFormatter.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+const std::string benchmarkText = "WhatsappTray::WindowProc: WM_TRAYCMD received";
+
+/* Keeps the compiler from dropping the work of a case. */
+volatile size_t benchmarkSink = 0;
+
+/**
+ * @brief Logger::GetTimeString() before the timestamp was cached.
+ */
+std::string GetTimeString(const char* formatString, bool withMilliseconds, std::chrono::system_clock::time_point time)
+{
+	using namespace std::chrono;
+
+	auto ms = duration_cast<milliseconds>(time.time_since_epoch()) % 1000;
+	auto timer = system_clock::to_time_t(time);
+	struct tm local_time;
+#ifdef _WIN32
+	localtime_s(&local_time, &timer);
+#else
+	localtime_r(&timer, &local_time);
+#endif
+
+	std::ostringstream oss;
+	oss << std::put_time(&local_time, formatString);
+	if (withMilliseconds) {
+		oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
+	}
+	return oss.str();
+}
+
+void PrintResult(const char* caseName, uint64_t lineCount, std::chrono::steady_clock::duration duration, const std::string& line)
+{
+	double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	printf("%-9s %8.1f ns/line %12.0f lines/s  '%s'\n", caseName, nanoseconds / lineCount, lineCount / (nanoseconds / 1e9), line.c_str());
+}
+
+void RunPutTime(uint64_t lineCount, std::chrono::system_clock::time_point startTime, std::chrono::nanoseconds lineInterval)
+{
+	std::string line;
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < lineCount; i++) {
+		auto time = startTime + std::chrono::duration_cast<std::chrono::system_clock::duration>(lineInterval * i);
+		line = GetTimeString("%H:%M:%S", true, time) + " - " + benchmarkText;
+		benchmarkSink = benchmarkSink + line.size();
+	}
+	PrintResult("put_time", lineCount, std::chrono::steady_clock::now() - start, line);
+}
+
+void RunCached(uint64_t lineCount, std::chrono::system_clock::time_point startTime, std::chrono::nanoseconds lineInterval)
+{
+	LogTimestampFormatter timestampFormatter;
+	std::string line;
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < lineCount; i++) {
+		auto time = startTime + std::chrono::duration_cast<std::chrono::system_clock::duration>(lineInterval * i);
+		line.clear();
+		timestampFormatter.AppendTo(line, time);
+		line.append(" - ");
+		line.append(benchmarkText);
+		benchmarkSink = benchmarkSink + line.size();
+	}
+	PrintResult("cached", lineCount, std::chrono::steady_clock::now() - start, line);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t lineCount = 2000000;
+	uint64_t linesPerSecond = 100000;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--lines=", 8) == 0) {
+			lineCount = strtoull(argv[i] + 8, nullptr, 10);
+		} else if (strncmp(argv[i], "--linesPerSecond=", 17) == 0) {
+			linesPerSecond = strtoull(argv[i] + 17, nullptr, 10);
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\nUsage: LogTimestampFormatterBenchmark [--lines=<count>] [--linesPerSecond=<count>]\n", argv[i]);
+			return 1;
+		}
+	}
+	if (lineCount == 0 || linesPerSecond == 0) {
+		fprintf(stderr, "ERROR: --lines and --linesPerSecond have to be at least 1.\n");
+		return 1;
+	}
+
+	auto startTime = std::chrono::system_clock::now();
+	auto lineInterval = std::chrono::nanoseconds(1000000000 / linesPerSecond);
+	printf("%llu lines, %llu lines per simulated second\n", static_cast<unsigned long long>(lineCount), static_cast<unsigned long long>(linesPerSecond));
+	RunPutTime(lineCount, startTime, lineInterval);
+	RunCached(lineCount, startTime, lineInterval);
+	return 0;
+}
@@ -0,0 +1,214 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures how fast the log-messages of the hook get to WhatsappTray over the different transports.
+// The messages go through the same MessageSender as in the hook (lanes, batching, buffer-pool) and are decoded by a LogServer like in WhatsappTray.
+// The in-process transport is the baseline without the operating-system. (See WhatsappTray/InProcessTransport.h)
+// The named pipe and the shared memory only exist on Windows. They are not part of this benchmark, because it also has to run on Linux.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -pthread -o LogTransportBenchmark benchmarks/LogTransportBenchmark.cpp WhatsappTray/TcpClient.cpp
+// Build on Windows: cl /std:c++17 /O2 /EHsc benchmarks\LogTransportBenchmark.cpp WhatsappTray\TcpClient.cpp
+//
+// Usage: LogTransportBenchmark [--transport=<in-process|tcp|all>] [--messages=<count>] [--size=<bytes>] [--producers=<count>]
+// Prints messages/s, bytes/s and a histogram of the latency from the creation of a record until it was decoded.
+
+#include "../WhatsappTray/InProcessTransport.h"
+#include "../WhatsappTray/MessageSender.h"
+#include "../WhatsappTray/TcpClient.h"
+#include "../tests/LoopbackTcpServer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct BenchmarkConfig
+{
+	uint64_t messageCount = 1000000;
+	size_t messageSize = 100;
+	unsigned producerCount = 4;
+};
+
+/* Bucket i counts the latencies in [2^(i-1), 2^i) microseconds. */
+constexpr size_t latencyBucketCount = 24;
+
+/**
+ * @brief Counts the messages that arrive at the server. Only called from the thread of the server.
+ */
+class BenchmarkReceiver
+{
+public:
+	void OnLine(const LogLine& line)
+	{
+		// The sender adds own lines, for example the statistics of the lanes.
+		if (line.text.compare(0, 6, "bench ") != 0) {
+			return;
+		}
+
+		int64_t latencyUs = (LogRecordWriter::Now() - line.timestamp) / 1000;
+		size_t bucket = 0;
+		while (bucket + 1 < latencyBucketCount && latencyUs >= (int64_t(1) << bucket)) {
+			bucket++;
+		}
+		_latencyBuckets[bucket]++;
+		_bytes += line.text.size();
+		_lastReceived = std::chrono::steady_clock::now();
+		_messageCount.fetch_add(1, std::memory_order_release);
+	}
+
+	uint64_t MessageCount() const { return _messageCount.load(std::memory_order_acquire); }
+	uint64_t Bytes() const { return _bytes; }
+	std::chrono::steady_clock::time_point LastReceived() const { return _lastReceived; }
+	const uint64_t* LatencyBuckets() const { return _latencyBuckets; }
+
+private:
+	std::atomic<uint64_t> _messageCount = 0;
+	uint64_t _bytes = 0;
+	std::chrono::steady_clock::time_point _lastReceived;
+	uint64_t _latencyBuckets[latencyBucketCount] = {};
+};
+
+void PrintResult(const char* transportName, const BenchmarkConfig& config, const BenchmarkReceiver& receiver, std::chrono::steady_clock::time_point start, uint64_t unsentCount)
+{
+	double seconds = std::chrono::duration<double>(receiver.LastReceived() - start).count();
+	uint64_t received = receiver.MessageCount();
+	printf("%-10s messages=%llu/%llu unsent=%llu time=%.3fs %.0f messages/s %.1f MB/s\n", transportName,
+		static_cast<unsigned long long>(received), static_cast<unsigned long long>(config.messageCount), static_cast<unsigned long long>(unsentCount),
+		seconds, received / seconds, receiver.Bytes() / seconds / (1024 * 1024));
+
+	uint64_t percentileCounts[] = { received / 2, received * 99 / 100, received * 999 / 1000 };
+	const char* percentileNames[] = { "p50", "p99", "p99.9" };
+	size_t percentile = 0;
+	uint64_t sum = 0;
+	for (size_t bucket = 0; bucket < latencyBucketCount; bucket++) {
+		uint64_t count = receiver.LatencyBuckets()[bucket];
+		sum += count;
+		if (count == 0) {
+			continue;
+		}
+		printf("  < %8lluus %10llu", static_cast<unsigned long long>(1ull << bucket), static_cast<unsigned long long>(count));
+		while (percentile < 3 && sum > percentileCounts[percentile]) {
+			printf(" %s", percentileNames[percentile]);
+			percentile++;
+		}
+		printf("\n");
+	}
+}
+
+/**
+ * @brief Sends the messages from multiple threads and waits until the server received them.
+ */
+void RunBenchmark(const char* transportName, const BenchmarkConfig& config, LogServer& server, const MessageSender::TransportFactory& openTransport)
+{
+	BenchmarkReceiver receiver;
+	server.NotifyOnNewMessage([&](const LogLine& line) { receiver.OnLine(line); });
+	std::thread serverThread([&]() { server.Run(); });
+
+	// Block instead of dropping, so every message is measured.
+	MessageQueueConfig queueConfig;
+	queueConfig.fullPolicy = QueueFullPolicy::Block;
+	queueConfig.blockTimeout = std::chrono::milliseconds(10000);
+	MessageSender sender;
+	sender.Start(openTransport, 1, queueConfig);
+
+	std::string text = "bench ";
+	text.resize(config.messageSize > text.size() ? config.messageSize : text.size(), 'x');
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> producers;
+	for (unsigned producer = 0; producer < config.producerCount; producer++) {
+		producers.emplace_back([&, producer]() {
+			uint64_t count = config.messageCount / config.producerCount + (producer < config.messageCount % config.producerCount ? 1 : 0);
+			for (uint64_t i = 0; i < count; i++) {
+				std::string record = sender.TakeBuffer();
+				LogRecordWriter::BeginText(record, 1);
+				record.append(text);
+				sender.Send(std::move(record), MessageLane::Bulk);
+			}
+		});
+	}
+	for (auto& producer : producers) {
+		producer.join();
+	}
+
+	uint64_t unsentCount = sender.Stop(std::chrono::milliseconds(10000));
+	auto waitEnd = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (receiver.MessageCount() + unsentCount < config.messageCount && std::chrono::steady_clock::now() < waitEnd) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	server.Stop();
+	serverThread.join();
+
+	PrintResult(transportName, config, receiver, start, unsentCount);
+}
+
+void RunInProcess(const BenchmarkConfig& config)
+{
+	InProcessChannel channel;
+	InProcessServer server(channel);
+	RunBenchmark("in-process", config, server, [&]() { return std::make_unique<InProcessTransport>(channel); });
+}
+
+void RunTcp(const BenchmarkConfig& config)
+{
+	LoopbackTcpServer server;
+	if (server.Listen() == false) {
+		fprintf(stderr, "ERROR: The TCP-server could not be started.\n");
+		return;
+	}
+	std::string portString = server.PortString();
+	RunBenchmark("tcp", config, server, [&]() { return std::make_unique<TcpClient>("127.0.0.1", portString.c_str()); });
+}
+
+void PrintUsage()
+{
+	fprintf(stderr, "Usage: LogTransportBenchmark [--transport=<in-process|tcp|all>] [--messages=<count>] [--size=<bytes>] [--producers=<count>]\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig config;
+	std::string transport = "all";
+
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		if (strncmp(argument, "--transport=", 12) == 0) {
+			transport = argument + 12;
+		} else if (strncmp(argument, "--messages=", 11) == 0) {
+			config.messageCount = strtoull(argument + 11, nullptr, 10);
+		} else if (strncmp(argument, "--size=", 7) == 0) {
+			config.messageSize = static_cast<size_t>(strtoull(argument + 7, nullptr, 10));
+		} else if (strncmp(argument, "--producers=", 12) == 0) {
+			config.producerCount = static_cast<unsigned>(strtoul(argument + 12, nullptr, 10));
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argument);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (config.producerCount == 0 || (transport != "all" && transport != "in-process" && transport != "tcp")) {
+		PrintUsage();
+		return 1;
+	}
+
+	printf("%llu messages of %zu bytes from %u threads\n", static_cast<unsigned long long>(config.messageCount), config.messageSize, config.producerCount);
+	if (transport == "all" || transport == "in-process") {
+		RunInProcess(config);
+	}
+	if (transport == "all" || transport == "tcp") {
+		RunTcp(config);
+	}
+	return 0;
+}
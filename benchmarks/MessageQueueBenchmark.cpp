@@ -0,0 +1,276 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures the message-buffer of the hook when several threads log at the same time. (See WhatsappTray/MessageQueue.h)
+// The baseline is the queue that was used before: One mutex around a ring, which every producer and the consumer lock.
+// Every producer enqueues its messages as fast as it can, one consumer takes them with WaitDequeue() like the thread of the MessageSender.
+// - messages/s: All enqueued messages, divided by the time until the consumer took the last one.
+// - enqueue: How long one Enqueue() took on the producer. That is the time that the UI-thread of WhatsApp loses. Every 16th call is measured, so the clock does not dominate.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -pthread -o MessageQueueBenchmark benchmarks/MessageQueueBenchmark.cpp
+// Build on Windows: cl /std:c++17 /O2 /EHsc benchmarks\MessageQueueBenchmark.cpp
+//
+// Usage: MessageQueueBenchmark [--producers=<count>[,<count>...]] [--messages=<count>] [--size=<bytes>] [--capacity=<count>] [--policy=<drop-newest|drop-oldest|block>]
+// Runs both queues once for every count of producers. Default: 1,2,4,8
+
+#include "../WhatsappTray/MessageQueue.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+struct BenchmarkConfig
+{
+	std::vector<unsigned> producerCounts = { 1, 2, 4, 8 };
+	/* How many messages every producer enqueues. */
+	uint64_t messagesPerProducer = 200000;
+	size_t messageSize = 100;
+	/* The default of the lanes of the MessageSender. */
+	size_t capacity = 4096;
+	QueueFullPolicy fullPolicy = QueueFullPolicy::Block;
+};
+
+/**
+ * @brief The queue before it was made lock-free. Only what the benchmark needs.
+ */
+class MutexMessageQueue
+{
+public:
+	explicit MutexMessageQueue(const MessageQueueConfig& config) : _config(config), _items(config.capacity) { }
+
+	bool Enqueue(std::string&& message)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (IsFull(message.size())) {
+			switch (_config.fullPolicy) {
+			case QueueFullPolicy::DropNewest: {
+				_droppedCount++;
+				return false;
+			}
+			case QueueFullPolicy::DropOldest: {
+				while (IsFull(message.size())) {
+					_bytes -= _items[_first].size();
+					_items[_first] = std::string();
+					_first = (_first + 1) % _config.capacity;
+					_count--;
+					_droppedCount++;
+				}
+			} break;
+			case QueueFullPolicy::Block: {
+				if (_notFull.wait_for(lock, _config.blockTimeout, [&]() { return IsFull(message.size()) == false; }) == false) {
+					_droppedCount++;
+					return false;
+				}
+			} break;
+			}
+		}
+		_bytes += message.size();
+		_items[(_first + _count) % _config.capacity] = std::move(message);
+		_count++;
+		lock.unlock();
+		_notEmpty.notify_one();
+		return true;
+	}
+
+	bool WaitDequeue(std::string& message)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notEmpty.wait(lock, [&]() { return _count > 0 || _wakeUp; });
+		_wakeUp = false;
+		return DequeueLocked(lock, message);
+	}
+
+	bool TryDequeue(std::string& message)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		return DequeueLocked(lock, message);
+	}
+
+	void WakeUp()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_wakeUp = true;
+		}
+		_notEmpty.notify_one();
+	}
+
+	uint64_t TakeDroppedCount()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return std::exchange(_droppedCount, 0);
+	}
+
+private:
+	MessageQueueConfig _config;
+	std::mutex _mutex;
+	std::condition_variable _notEmpty;
+	std::condition_variable _notFull;
+	std::vector<std::string> _items;
+	size_t _first = 0;
+	size_t _count = 0;
+	size_t _bytes = 0;
+	uint64_t _droppedCount = 0;
+	bool _wakeUp = false;
+
+	bool IsFull(size_t additionalBytes) const { return _count >= _config.capacity || _bytes + additionalBytes > _config.maxBytes; }
+
+	bool DequeueLocked(std::unique_lock<std::mutex>& lock, std::string& message)
+	{
+		if (_count == 0) {
+			return false;
+		}
+		_bytes -= _items[_first].size();
+		message = std::move(_items[_first]);
+		_items[_first].clear();
+		_first = (_first + 1) % _config.capacity;
+		_count--;
+		lock.unlock();
+		_notFull.notify_all();
+		return true;
+	}
+};
+
+const char* PolicyName(QueueFullPolicy policy)
+{
+	switch (policy) {
+	case QueueFullPolicy::DropNewest: return "drop-newest";
+	case QueueFullPolicy::DropOldest: return "drop-oldest";
+	case QueueFullPolicy::Block: return "block";
+	}
+	return "";
+}
+
+template <typename Queue>
+void RunBenchmark(const char* queueName, const BenchmarkConfig& config, unsigned producerCount)
+{
+	MessageQueueConfig queueConfig;
+	queueConfig.capacity = config.capacity;
+	queueConfig.fullPolicy = config.fullPolicy;
+	// Long enough that a producer is never dropped only because the consumer was not scheduled in time.
+	queueConfig.blockTimeout = std::chrono::milliseconds(1000);
+	queueConfig.collectStatistics = false;
+	Queue queue(queueConfig);
+
+	std::string text(config.messageSize, 'x');
+	std::atomic<unsigned> runningProducers = producerCount;
+	std::vector<std::vector<int64_t>> enqueueTimes(producerCount);
+	uint64_t receivedCount = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	std::thread consumer([&]() {
+		// The last producer wakes the consumer up, then the rest is taken without waiting.
+		std::string message;
+		while (runningProducers > 0) {
+			receivedCount += queue.WaitDequeue(message) ? 1 : 0;
+		}
+		while (queue.TryDequeue(message)) {
+			receivedCount++;
+		}
+	});
+	std::vector<std::thread> producers;
+	for (unsigned producer = 0; producer < producerCount; producer++) {
+		producers.emplace_back([&, producer]() {
+			auto& times = enqueueTimes[producer];
+			times.reserve(static_cast<size_t>(config.messagesPerProducer / 16 + 1));
+			for (uint64_t i = 0; i < config.messagesPerProducer; i++) {
+				if (i % 16 != 0) {
+					queue.Enqueue(std::string(text));
+					continue;
+				}
+				std::string message(text);
+				auto enqueueStart = std::chrono::steady_clock::now();
+				queue.Enqueue(std::move(message));
+				times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - enqueueStart).count());
+			}
+			if (--runningProducers == 0) {
+				queue.WakeUp();
+			}
+		});
+	}
+	for (auto& producer : producers) {
+		producer.join();
+	}
+	consumer.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<int64_t> times;
+	for (auto& producerTimes : enqueueTimes) {
+		times.insert(times.end(), producerTimes.begin(), producerTimes.end());
+	}
+	std::sort(times.begin(), times.end());
+	auto percentile = [&](double fraction) { return times.empty() ? 0.0 : times[static_cast<size_t>(fraction * (times.size() - 1))] / 1000.0; };
+
+	uint64_t messageCount = producerCount * config.messagesPerProducer;
+	printf("%-10s producers=%-2u %s messages=%llu/%llu dropped=%llu time=%.3fs %.0f messages/s enqueue: p50=%.2fus p99=%.2fus max=%.1fus\n", queueName, producerCount,
+		PolicyName(config.fullPolicy), static_cast<unsigned long long>(receivedCount), static_cast<unsigned long long>(messageCount),
+		static_cast<unsigned long long>(queue.TakeDroppedCount()), seconds, receivedCount / seconds, percentile(0.5), percentile(0.99), times.empty() ? 0.0 : times.back() / 1000.0);
+}
+
+void PrintUsage()
+{
+	fprintf(stderr, "Usage: MessageQueueBenchmark [--producers=<count>[,<count>...]] [--messages=<count>] [--size=<bytes>] [--capacity=<count>] [--policy=<drop-newest|drop-oldest|block>]\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig config;
+
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		if (strncmp(argument, "--producers=", 12) == 0) {
+			config.producerCounts.clear();
+			for (const char* count = argument + 12; *count != '\0';) {
+				char* end = nullptr;
+				config.producerCounts.push_back(static_cast<unsigned>(strtoul(count, &end, 10)));
+				count = *end == ',' ? end + 1 : end;
+				if (end == count) {
+					break;
+				}
+			}
+		} else if (strncmp(argument, "--messages=", 11) == 0) {
+			config.messagesPerProducer = strtoull(argument + 11, nullptr, 10);
+		} else if (strncmp(argument, "--size=", 7) == 0) {
+			config.messageSize = static_cast<size_t>(strtoull(argument + 7, nullptr, 10));
+		} else if (strncmp(argument, "--capacity=", 11) == 0) {
+			config.capacity = static_cast<size_t>(strtoull(argument + 11, nullptr, 10));
+		} else if (strcmp(argument, "--policy=drop-newest") == 0) {
+			config.fullPolicy = QueueFullPolicy::DropNewest;
+		} else if (strcmp(argument, "--policy=drop-oldest") == 0) {
+			config.fullPolicy = QueueFullPolicy::DropOldest;
+		} else if (strcmp(argument, "--policy=block") == 0) {
+			config.fullPolicy = QueueFullPolicy::Block;
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argument);
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (config.messagesPerProducer == 0 || config.capacity == 0 || config.producerCounts.empty()
+		|| std::find(config.producerCounts.begin(), config.producerCounts.end(), 0u) != config.producerCounts.end()) {
+		fprintf(stderr, "ERROR: --producers, --messages and --capacity have to be at least 1.\n");
+		PrintUsage();
+		return 1;
+	}
+
+	for (unsigned producerCount : config.producerCounts) {
+		RunBenchmark<MutexMessageQueue>("mutex", config, producerCount);
+		RunBenchmark<MessageQueue>("lock-free", config, producerCount);
+	}
+	return 0;
+}
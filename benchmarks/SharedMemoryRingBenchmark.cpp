@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures the shared-memory ring between two processes, like the hook and WhatsappTray. (See WhatsappTray/SharedMemoryRing.h)
+// On Linux POSIX shared memory stands in for the file-mapping and an eventfd for the event, like in tests/SharedMemoryRingTest.cpp.
+// - The writer-process does what SharedMemoryClient::Send() does: Writes one batch of frames, signals the event and, when the ring is full, signals and sleeps 1ms.
+// - The reader does what SharedMemoryServer::Run() does: Waits for the event, reads all frames and decodes the records.
+// The latency is measured from the creation of the record in the writer until the reader decoded it. Both processes use the same monotonic clock.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -pthread -o SharedMemoryRingBenchmark benchmarks/SharedMemoryRingBenchmark.cpp -lrt
+// Build on Windows: The stand-ins for the file-mapping and the event are POSIX, so the benchmark is only built on Linux.
+//
+// Usage: SharedMemoryRingBenchmark [--messages=<count>] [--size=<bytes>] [--batch=<messages>] [--capacity=<bytes>]
+// Prints messages/s, MB/s, the percentiles of the latency and how often the writer found the ring full.
+
+#include "../WhatsappTray/LogRecordDecoder.h"
+#include "../WhatsappTray/SharedMemoryRing.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct BenchmarkConfig
+{
+	uint64_t messageCount = 1000000;
+	size_t messageSize = 100;
+	/* Messages per write, like the batches of MessageSender. */
+	unsigned batchSize = 64;
+	/* The default of LOGGER_SHARED_MEMORY_RING_CAPACITY. Has to be a power of two. */
+	uint32_t ringCapacity = 1024 * 1024;
+};
+
+/* Written by the writer-process behind the ring, so the reader can print it. */
+struct WriterStatistics
+{
+	uint64_t fullCount;
+};
+
+void* MapSharedMemory(const std::string& name, size_t size, bool create)
+{
+	int file = shm_open(name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+	if (file < 0) {
+		return nullptr;
+	}
+	if (create && ftruncate(file, static_cast<off_t>(size)) != 0) {
+		close(file);
+		return nullptr;
+	}
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void Signal(int event)
+{
+	uint64_t value = 1;
+	(void)!write(event, &value, sizeof(value));
+}
+
+bool Wait(int event, int timeoutMs)
+{
+	pollfd pollEvent{ event, POLLIN, 0 };
+	if (poll(&pollEvent, 1, timeoutMs) <= 0) {
+		return false;
+	}
+	uint64_t value;
+	(void)!read(event, &value, sizeof(value));
+	return true;
+}
+
+/**
+ * @brief The hook.
+ *
+ * @return The exit-code of the process.
+ */
+int RunWriter(const BenchmarkConfig& config, const std::string& name, size_t memorySize, int dataWrittenEvent)
+{
+	void* memory = MapSharedMemory(name, memorySize, false);
+	SharedMemoryRing ring;
+	if (memory == nullptr || ring.Attach(memory, SharedMemoryRing::RequiredMemorySize(config.ringCapacity)) == false) {
+		return 2;
+	}
+	auto statistics = reinterpret_cast<WriterStatistics*>(static_cast<char*>(memory) + SharedMemoryRing::RequiredMemorySize(config.ringCapacity));
+
+	std::string text = "bench ";
+	text.resize(config.messageSize > text.size() ? config.messageSize : text.size(), 'x');
+	std::string record;
+	std::string batch;
+	for (uint64_t sent = 0; sent < config.messageCount;) {
+		batch.clear();
+		for (unsigned i = 0; i < config.batchSize && sent < config.messageCount; i++, sent++) {
+			record.clear();
+			LogRecordWriter::BeginText(record, 1);
+			record.append(text);
+			MessageFraming::AppendFrame(batch, record.data(), record.size());
+		}
+
+		while (true) {
+			bool success = ring.Write(batch.data(), batch.size());
+			Signal(dataWrittenEvent);
+			if (success) {
+				break;
+			}
+			if (batch.size() > ring.Capacity()) {
+				return 3;
+			}
+			statistics->fullCount++;
+			usleep(1000);
+		}
+	}
+	return 0;
+}
+
+void PrintResult(const BenchmarkConfig& config, std::chrono::steady_clock::duration duration, uint64_t bytes, std::vector<int64_t>& latencies, uint64_t fullCount)
+{
+	double seconds = std::chrono::duration<double>(duration).count();
+	printf("shared-memory messages=%llu/%llu time=%.3fs %.0f messages/s %.1f MB/s ring-full=%llu", static_cast<unsigned long long>(latencies.size()),
+		static_cast<unsigned long long>(config.messageCount), seconds, latencies.size() / seconds, bytes / seconds / (1024 * 1024), static_cast<unsigned long long>(fullCount));
+	if (latencies.empty()) {
+		printf("\n");
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double fraction) { return latencies[static_cast<size_t>(fraction * (latencies.size() - 1))] / 1000.0; };
+	printf(" latency: p50=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n", percentile(0.5), percentile(0.99), percentile(0.999), latencies.back() / 1000.0);
+}
+
+/**
+ * @brief The size of one batch in the ring, so a batch that can never fit is found before the writer starts.
+ */
+size_t BatchSize(const BenchmarkConfig& config)
+{
+	std::string record;
+	LogRecordWriter::BeginText(record, 1);
+	return (frameHeaderSize + record.size() + (std::max)(config.messageSize, size_t(6))) * config.batchSize;
+}
+
+int RunBenchmark(const BenchmarkConfig& config)
+{
+	if (BatchSize(config) > config.ringCapacity) {
+		fprintf(stderr, "ERROR: One batch needs %zu bytes, which is more than the capacity of the ring.\n", BatchSize(config));
+		return 1;
+	}
+
+	std::string name = "/WhatsappTrayRingBenchmark-" + std::to_string(getpid());
+	size_t memorySize = SharedMemoryRing::RequiredMemorySize(config.ringCapacity) + sizeof(WriterStatistics);
+	void* memory = MapSharedMemory(name, memorySize, true);
+	SharedMemoryRing ring;
+	if (memory == nullptr || ring.Create(memory, SharedMemoryRing::RequiredMemorySize(config.ringCapacity), config.ringCapacity) == false) {
+		fprintf(stderr, "ERROR: The ring could not be created. The capacity has to be a power of two.\n");
+		shm_unlink(name.c_str());
+		return 1;
+	}
+	auto statistics = reinterpret_cast<WriterStatistics*>(static_cast<char*>(memory) + SharedMemoryRing::RequiredMemorySize(config.ringCapacity));
+	statistics->fullCount = 0;
+
+	std::vector<int64_t> latencies;
+	latencies.reserve(config.messageCount);
+	uint64_t bytes = 0;
+	int dataWrittenEvent = eventfd(0, 0);
+	auto start = std::chrono::steady_clock::now();
+	pid_t writer = fork();
+	if (writer == 0) {
+		_exit(RunWriter(config, name, memorySize, dataWrittenEvent));
+	}
+
+	// The loop of SharedMemoryServer::Run().
+	SharedMemoryFrameReader frameReader(ring);
+	LogRecordDecoder decoder;
+	LogLine line;
+	while (latencies.size() < config.messageCount) {
+		if (Wait(dataWrittenEvent, 5000) == false) {
+			fprintf(stderr, "ERROR: The writer stopped writing.\n");
+			break;
+		}
+		frameReader.ReadFrames([&](const std::string& record) {
+			if (decoder.Decode(record, line)) {
+				latencies.push_back(LogRecordWriter::Now() - line.timestamp);
+				bytes += record.size();
+			}
+		});
+	}
+	auto duration = std::chrono::steady_clock::now() - start;
+
+	int status = -1;
+	waitpid(writer, &status, 0);
+	PrintResult(config, duration, bytes, latencies, statistics->fullCount);
+
+	close(dataWrittenEvent);
+	munmap(memory, memorySize);
+	shm_unlink(name.c_str());
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : 1;
+}
+
+void PrintUsage()
+{
+	fprintf(stderr, "Usage: SharedMemoryRingBenchmark [--messages=<count>] [--size=<bytes>] [--batch=<messages>] [--capacity=<bytes>]\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig config;
+
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		if (strncmp(argument, "--messages=", 11) == 0) {
+			config.messageCount = strtoull(argument + 11, nullptr, 10);
+		} else if (strncmp(argument, "--size=", 7) == 0) {
+			config.messageSize = static_cast<size_t>(strtoull(argument + 7, nullptr, 10));
+		} else if (strncmp(argument, "--batch=", 8) == 0) {
+			config.batchSize = static_cast<unsigned>(strtoul(argument + 8, nullptr, 10));
+		} else if (strncmp(argument, "--capacity=", 11) == 0) {
+			config.ringCapacity = static_cast<uint32_t>(strtoul(argument + 11, nullptr, 10));
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argument);
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (config.messageCount == 0 || config.batchSize == 0) {
+		fprintf(stderr, "ERROR: --messages and --batch have to be at least 1.\n");
+		PrintUsage();
+		return 1;
+	}
+
+	return RunBenchmark(config);
+}
@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Measures how the WinSockServer of WhatsappTray handles many hooked processes at once. (See WhatsappTray/WinSockServer.h)
+// Every simulated hook connects with a TcpClient, sends a few messages, closes the connection and connects again, like a hook that is injected again and again.
+// The messages are sent one by one without batching, so the latency of every message is measured and not the one of the batch.
+// - connections/s: All connections of all hooks, divided by the time until the server received the last message.
+// - latency: From the creation of the record in the hook until the server decoded it.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -pthread -o TcpServerBenchmark benchmarks/TcpServerBenchmark.cpp WhatsappTray/WinSockServer.cpp WhatsappTray/TcpClient.cpp
+// Build on Windows: The WinSockServer needs the Logger of WhatsappTray there, so the benchmark is only built on Linux.
+//
+// Usage: TcpServerBenchmark [--clients=<count>[,<count>...]] [--connections=<count>] [--messages=<count>] [--size=<bytes>]
+// Runs once for every count of clients. Default: 1,8,64
+
+#include "../WhatsappTray/MessageFraming.h"
+#include "../WhatsappTray/TcpClient.h"
+#include "../WhatsappTray/WinSockServer.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct BenchmarkConfig
+{
+	std::vector<unsigned> clientCounts = { 1, 8, 64 };
+	/* How often every hook connects. */
+	unsigned connectionsPerClient = 100;
+	/* How many messages every hook sends over one connection. */
+	unsigned messagesPerConnection = 10;
+	size_t messageSize = 100;
+};
+
+/**
+ * @brief Lets the operating-system choose a free port, so the benchmark does not collide with a running WhatsappTray.
+ */
+std::string FindFreePort()
+{
+	SOCKET probeSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+	socklen_t addressSize = sizeof(address);
+	std::string portString;
+	if (bind(probeSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != SOCKET_ERROR
+		&& getsockname(probeSocket, reinterpret_cast<sockaddr*>(&address), &addressSize) != SOCKET_ERROR) {
+		portString = std::to_string(ntohs(address.sin_port));
+	}
+	closesocket(probeSocket);
+	return portString;
+}
+
+/**
+ * @brief One hooked process. Connects connectionsPerClient times and sends messagesPerConnection frames over every connection.
+ *
+ * @return The count of the messages that could not be sent.
+ */
+uint64_t RunClient(const BenchmarkConfig& config, const std::string& portString, uint32_t producerId)
+{
+	std::string text = "bench ";
+	text.resize(config.messageSize > text.size() ? config.messageSize : text.size(), 'x');
+
+	uint64_t failedCount = 0;
+	std::string record;
+	std::string frame;
+	for (unsigned connection = 0; connection < config.connectionsPerClient; connection++) {
+		TcpClient client("127.0.0.1", portString.c_str());
+		// Longer than the hook waits, so a connect whose SYN was dropped because the backlog was full is retried by the operating-system and measured instead of counted as failed.
+		client.SetTimeout(std::chrono::milliseconds(5000));
+		if (client.Open() == false || client.Connect() == false) {
+			failedCount += config.messagesPerConnection;
+			continue;
+		}
+		for (unsigned message = 0; message < config.messagesPerConnection; message++) {
+			record.clear();
+			LogRecordWriter::BeginText(record, producerId);
+			record.append(text);
+			frame.clear();
+			MessageFraming::AppendFrame(frame, record.data(), record.size());
+			failedCount += client.Send(frame.data(), frame.size()) ? 0 : 1;
+		}
+		client.Close();
+	}
+	return failedCount;
+}
+
+void RunBenchmark(const BenchmarkConfig& config, unsigned clientCount)
+{
+	std::string portString = FindFreePort();
+	if (portString.empty()) {
+		fprintf(stderr, "ERROR: No free port found.\n");
+		return;
+	}
+
+	// Only touched by the thread of the server, until receivedCount says that all messages are there.
+	std::vector<int64_t> latencies;
+	latencies.reserve(static_cast<size_t>(clientCount) * config.connectionsPerClient * config.messagesPerConnection);
+	std::atomic<uint64_t> receivedCount = 0;
+	WinSockServer server(portString.c_str());
+	server.NotifyOnNewMessage([&](const LogLine& line) {
+		if (line.text.compare(0, 6, "bench ") != 0) {
+			return;
+		}
+		latencies.push_back(LogRecordWriter::Now() - line.timestamp);
+		receivedCount.fetch_add(1, std::memory_order_release);
+	});
+	std::thread serverThread([&]() { server.Run(); });
+
+	// Wait until the server listens.
+	TcpClient probe("127.0.0.1", portString.c_str());
+	probe.Open();
+	for (int i = 0; i < 1000 && probe.Connect() == false; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	probe.Close();
+
+	uint64_t messageCount = static_cast<uint64_t>(clientCount) * config.connectionsPerClient * config.messagesPerConnection;
+	std::atomic<uint64_t> failedCount = 0;
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> clients;
+	for (unsigned client = 0; client < clientCount; client++) {
+		clients.emplace_back([&, client]() { failedCount += RunClient(config, portString, client + 1); });
+	}
+	for (auto& client : clients) {
+		client.join();
+	}
+	auto waitEnd = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (receivedCount.load(std::memory_order_acquire) + failedCount < messageCount && std::chrono::steady_clock::now() < waitEnd) {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	server.Stop();
+	serverThread.join();
+
+	uint64_t connectionCount = static_cast<uint64_t>(clientCount) * config.connectionsPerClient;
+	printf("clients=%-3u connections=%llu time=%.3fs %.0f connections/s messages=%llu/%llu failed=%llu", clientCount, static_cast<unsigned long long>(connectionCount),
+		seconds, connectionCount / seconds, static_cast<unsigned long long>(latencies.size()), static_cast<unsigned long long>(messageCount), static_cast<unsigned long long>(failedCount.load()));
+	if (latencies.empty()) {
+		printf("\n");
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double fraction) { return latencies[static_cast<size_t>(fraction * (latencies.size() - 1))] / 1000.0; };
+	printf(" latency: p50=%.1fus p99=%.1fus max=%.1fus\n", percentile(0.5), percentile(0.99), latencies.back() / 1000.0);
+}
+
+void PrintUsage()
+{
+	fprintf(stderr, "Usage: TcpServerBenchmark [--clients=<count>[,<count>...]] [--connections=<count>] [--messages=<count>] [--size=<bytes>]\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig config;
+
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		if (strncmp(argument, "--clients=", 10) == 0) {
+			config.clientCounts.clear();
+			for (const char* count = argument + 10; *count != '\0';) {
+				char* end = nullptr;
+				config.clientCounts.push_back(static_cast<unsigned>(strtoul(count, &end, 10)));
+				count = *end == ',' ? end + 1 : end;
+				if (end == count) {
+					break;
+				}
+			}
+		} else if (strncmp(argument, "--connections=", 14) == 0) {
+			config.connectionsPerClient = static_cast<unsigned>(strtoul(argument + 14, nullptr, 10));
+		} else if (strncmp(argument, "--messages=", 11) == 0) {
+			config.messagesPerConnection = static_cast<unsigned>(strtoul(argument + 11, nullptr, 10));
+		} else if (strncmp(argument, "--size=", 7) == 0) {
+			config.messageSize = static_cast<size_t>(strtoull(argument + 7, nullptr, 10));
+		} else {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argument);
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (config.connectionsPerClient == 0 || config.clientCounts.empty() || std::find(config.clientCounts.begin(), config.clientCounts.end(), 0u) != config.clientCounts.end()) {
+		fprintf(stderr, "ERROR: --clients and --connections have to be at least 1.\n");
+		PrintUsage();
+		return 1;
+	}
+
+	StartupSockets();
+	for (unsigned clientCount : config.clientCounts) {
+		RunBenchmark(config, clientCount);
+	}
+	CleanupSockets();
+	return 0;
+}
@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that the lost trace-datagrams are counted correctly, also when datagrams arrive late or the sequence-number overflows. (See TraceDatagram.h)
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o DatagramGapDetectorTest tests/DatagramGapDetectorTest.cpp
+
+#include "../WhatsappTray/TraceDatagram.h"
+#include "TestSupport.h"
+
+#include <string>
+
+namespace
+{
+
+void CheckDatagram()
+{
+	std::string datagram;
+	TraceDatagram::BeginDatagram(datagram, 42, 0xDEADBEEF);
+	datagram.append("record");
+	CHECK(datagram.size() == datagramHeaderSize + 6);
+
+	uint32_t producerId = 0;
+	uint32_t sequence = 0;
+	std::string record;
+	CHECK(TraceDatagram::ReadDatagram(datagram.data(), datagram.size(), producerId, sequence, record));
+	CHECK(producerId == 42);
+	CHECK(sequence == 0xDEADBEEF);
+	CHECK(record == "record");
+
+	CHECK(TraceDatagram::ReadDatagram(datagram.data(), datagramHeaderSize - 1, producerId, sequence, record) == false);
+	CHECK(TraceDatagram::ReadDatagram(datagram.data(), datagramHeaderSize, producerId, sequence, record));
+	CHECK(record.empty());
+}
+
+void CheckGaps()
+{
+	DatagramGapDetector detector;
+
+	// WhatsappTray may start after the hook, so the first datagram is never a gap.
+	CHECK(detector.Track(1, 100) == 0);
+	CHECK(detector.Track(1, 101) == 0);
+	CHECK(detector.Track(1, 105) == 3);
+	CHECK(detector.Track(1, 106) == 0);
+
+	// A datagram that arrives late or twice is not a gap and does not move the expected sequence back.
+	CHECK(detector.Track(1, 103) == 0);
+	CHECK(detector.Track(1, 106) == 0);
+	CHECK(detector.Track(1, 107) == 0);
+}
+
+void CheckProducersAreSeparate()
+{
+	DatagramGapDetector detector;
+	CHECK(detector.Track(1, 0) == 0);
+	CHECK(detector.Track(2, 50) == 0);
+	CHECK(detector.Track(1, 1) == 0);
+	CHECK(detector.Track(2, 52) == 1);
+	CHECK(detector.Track(1, 4) == 2);
+}
+
+void CheckOverflow()
+{
+	DatagramGapDetector detector;
+	CHECK(detector.Track(1, 0xFFFFFFFE) == 0);
+	CHECK(detector.Track(1, 0xFFFFFFFF) == 0);
+	CHECK(detector.Track(1, 0) == 0);
+	CHECK(detector.Track(1, 3) == 2);
+	// Before the overflow, so late.
+	CHECK(detector.Track(1, 0xFFFFFFF0) == 0);
+	CHECK(detector.Track(1, 4) == 0);
+
+	DatagramGapDetector gapOverOverflow;
+	CHECK(gapOverOverflow.Track(1, 0xFFFFFFFD) == 0);
+	CHECK(gapOverOverflow.Track(1, 1) == 3);
+}
+
+}
+
+int main()
+{
+	CheckDatagram();
+	CheckGaps();
+	CheckProducersAreSeparate();
+	CheckOverflow();
+
+	return TestResult("DatagramGapDetectorTest");
+}
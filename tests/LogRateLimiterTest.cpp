@@ -0,0 +1,125 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks the token-bucket and the collapsing of LogRateLimiter and that the counts, which a call-site still holds when it stops logging, can be taken. (See LogRateLimiter.h)
+// The time is passed in, so the limits are checked without sleeping.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o LogRateLimiterTest tests/LogRateLimiterTest.cpp
+
+#include "../WhatsappTray/LogRateLimiter.h"
+#include "TestSupport.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr int64_t second = 1000LL * 1000 * 1000;
+
+bool Collapse(LogRateLimiter& rateLimiter, const char* text, int64_t now, const LogRateLimit& limit, uint32_t& repeatCount)
+{
+	return rateLimiter.Collapse(text, strlen(text), now, limit, repeatCount);
+}
+
+void CheckTokenBucket()
+{
+	LogRateLimit limit;
+	limit.burst = 3;
+	limit.linesPerSecond = 10;
+	LogRateLimiter rateLimiter;
+
+	uint32_t suppressedCount = 0;
+	for (int i = 0; i < 3; i++) {
+		CHECK(rateLimiter.TryAcquire(second, limit, suppressedCount));
+	}
+	CHECK(rateLimiter.TryAcquire(second, limit, suppressedCount) == false);
+	CHECK(rateLimiter.TryAcquire(second, limit, suppressedCount) == false);
+
+	// After 100ms one token is back and the dropped lines are reported with the next line.
+	CHECK(rateLimiter.TryAcquire(second + second / 10, limit, suppressedCount));
+	CHECK(suppressedCount == 2);
+	CHECK(rateLimiter.TryAcquire(second + second / 10, limit, suppressedCount) == false);
+
+	// The call-site stops logging. The count is still pending.
+	uint32_t repeatCount = 0;
+	CHECK(rateLimiter.TakePending(suppressedCount, repeatCount));
+	CHECK(suppressedCount == 1);
+	CHECK(repeatCount == 0);
+	CHECK(rateLimiter.TakePending(suppressedCount, repeatCount) == false);
+}
+
+void CheckCollapse()
+{
+	LogRateLimit limit;
+	LogRateLimiter rateLimiter;
+
+	uint32_t repeatCount = 0;
+	CHECK(Collapse(rateLimiter, "a", 0, limit, repeatCount));
+	CHECK(Collapse(rateLimiter, "a", 1, limit, repeatCount) == false);
+	CHECK(Collapse(rateLimiter, "a", 2, limit, repeatCount) == false);
+	CHECK(repeatCount == 0);
+	CHECK(Collapse(rateLimiter, "b", 3, limit, repeatCount));
+	CHECK(repeatCount == 2);
+
+	// A line that repeats forever is reported after the interval.
+	for (int i = 1; i <= 5; i++) {
+		CHECK(Collapse(rateLimiter, "b", i * 3 * second, limit, repeatCount) == false);
+	}
+	CHECK(repeatCount == 5);
+}
+
+void CheckTakePendingRepeats()
+{
+	LogRateLimit limit;
+	LogRateLimiter rateLimiter;
+
+	uint32_t repeatCount = 0;
+	CHECK(Collapse(rateLimiter, "a", 0, limit, repeatCount));
+	CHECK(Collapse(rateLimiter, "a", 1, limit, repeatCount) == false);
+	CHECK(Collapse(rateLimiter, "a", 2, limit, repeatCount) == false);
+
+	// Without TakePending() the repeats would only be reported by the next different line, which may never come.
+	uint32_t suppressedCount = 0;
+	CHECK(rateLimiter.TakePending(suppressedCount, repeatCount));
+	CHECK(suppressedCount == 0);
+	CHECK(repeatCount == 2);
+
+	// The last text stays stored, so the next identical line is still collapsed and only counted once.
+	CHECK(Collapse(rateLimiter, "a", 3, limit, repeatCount) == false);
+	CHECK(rateLimiter.TakePending(suppressedCount, repeatCount));
+	CHECK(repeatCount == 1);
+	CHECK(Collapse(rateLimiter, "b", 4, limit, repeatCount));
+	CHECK(repeatCount == 0);
+}
+
+void CheckRegistration()
+{
+	static LogRateLimiter first("Module", "First", 4);
+	static LogRateLimiter second("Module", "Second", 5);
+	// Without a call-site it is not registered, like the limiters of the hook.
+	static LogRateLimiter unregistered;
+
+	std::vector<std::string> functions;
+	LogRateLimiter::ForEachRegistered([&](LogRateLimiter& rateLimiter) {
+		CHECK(&rateLimiter != &unregistered);
+		CHECK(strcmp(rateLimiter.Module(), "Module") == 0);
+		functions.push_back(rateLimiter.Function());
+	});
+	CHECK(functions == std::vector<std::string>({ "Second", "First" }));
+	CHECK(first.Level() == 4);
+	CHECK(second.Level() == 5);
+}
+
+}
+
+int main()
+{
+	CheckTokenBucket();
+	CheckCollapse();
+	CheckTakePendingRepeats();
+	CheckRegistration();
+
+	return TestResult("LogRateLimiterTest");
+}
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that LogReorderBuffer releases the lines ordered by their origin-timestamp after the reorder-window. (See LogReorderBuffer.h)
+// The time is passed in, so the window is checked without sleeping.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o LogReorderBufferTest tests/LogReorderBufferTest.cpp
+
+#include "../WhatsappTray/LogReorderBuffer.h"
+#include "TestSupport.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr int64_t millisecond = 1000 * 1000;
+
+LogLine CreateLine(int64_t timestamp, const std::string& text)
+{
+	LogLine line;
+	line.timestamp = timestamp;
+	line.text = text;
+	return line;
+}
+
+std::vector<std::string> PopAllReady(LogReorderBuffer& buffer, int64_t now)
+{
+	std::vector<std::string> texts;
+	LogLine line;
+	while (buffer.PopReady(now, line)) {
+		texts.push_back(line.text);
+	}
+	return texts;
+}
+
+void CheckOrderWithinWindow()
+{
+	LogReorderBuffer buffer(std::chrono::milliseconds(100));
+	// The line of the hook arrives after a later line of WhatsappTray.
+	buffer.Push(CreateLine(20 * millisecond, "tray"));
+	buffer.Push(CreateLine(10 * millisecond, "hook"));
+	buffer.Push(CreateLine(20 * millisecond, "tray 2"));
+
+	CHECK(buffer.NextReleaseTime() == 110 * millisecond);
+	CHECK(PopAllReady(buffer, 109 * millisecond).empty());
+	CHECK(PopAllReady(buffer, 110 * millisecond) == std::vector<std::string>({ "hook" }));
+	// Lines with the same timestamp keep the order of arrival.
+	CHECK(PopAllReady(buffer, 120 * millisecond) == std::vector<std::string>({ "tray", "tray 2" }));
+	CHECK(buffer.IsEmpty());
+	CHECK(buffer.TakeLateCount() == 0);
+}
+
+void CheckLateLine()
+{
+	LogReorderBuffer buffer(std::chrono::milliseconds(100));
+	buffer.Push(CreateLine(50 * millisecond, "first"));
+	CHECK(PopAllReady(buffer, 150 * millisecond) == std::vector<std::string>({ "first" }));
+
+	// Older than the released line. It can not be put in order anymore, so it is sorted behind the released line but keeps its timestamp.
+	buffer.Push(CreateLine(40 * millisecond, "late"));
+	buffer.Push(CreateLine(60 * millisecond, "next"));
+	CHECK(buffer.TakeLateCount() == 1);
+	CHECK(buffer.TakeLateCount() == 0);
+
+	LogLine line;
+	CHECK(buffer.PopReady(150 * millisecond, line));
+	CHECK(line.text == "late");
+	CHECK(line.timestamp == 40 * millisecond);
+	CHECK(PopAllReady(buffer, 160 * millisecond) == std::vector<std::string>({ "next" }));
+}
+
+void CheckMaxLines()
+{
+	LogReorderBuffer buffer(std::chrono::milliseconds(100), 3);
+	for (int i = 0; i < 5; i++) {
+		buffer.Push(CreateLine((10 + i) * millisecond, "line " + std::to_string(i)));
+	}
+
+	// The window is not over, but more than maxLines are held back. The oldest are released.
+	CHECK(PopAllReady(buffer, 0) == std::vector<std::string>({ "line 0", "line 1" }));
+
+	// Pop() does not wait for the window, like at the end.
+	LogLine line;
+	std::vector<std::string> texts;
+	while (buffer.Pop(line)) {
+		texts.push_back(line.text);
+	}
+	CHECK(texts == std::vector<std::string>({ "line 2", "line 3", "line 4" }));
+	CHECK(buffer.IsEmpty());
+	CHECK(buffer.PopReady(1000 * millisecond, line) == false);
+}
+
+}
+
+int main()
+{
+	CheckOrderWithinWindow();
+	CheckLateLine();
+	CheckMaxLines();
+
+	return TestResult("LogReorderBufferTest");
+}
@@ -0,0 +1,230 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that no line is lost, cut or written twice when many threads log while the log-segments roll over. (See LogSegment.h and SegmentedLog.h)
+// SegmentedLog is the roll-over that the Logger uses. MappedLogFile only exists on Windows, so the test uses the mmap()-stand-in of PosixMappedLogFile.h.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o LogSegmentRollOverTest tests/LogSegmentRollOverTest.cpp
+
+#include "../WhatsappTray/SegmentedLog.h"
+#include "PosixMappedLogFile.h"
+#include "TestSupport.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t segmentSize = 16 * 1024;
+constexpr uint32_t threadCount = 4;
+constexpr uint32_t linesPerThread = 5000;
+
+/**
+ * @brief Opens the segments like Logger::OpenLogSegment(): "<base>_<number>.txt" with at least segmentSize bytes.
+ */
+class SegmentFiles
+{
+public:
+	explicit SegmentFiles(const std::string& basePath) : _basePath(basePath) { }
+
+	/* Called by SegmentedLog under its exclusive lock. */
+	bool Open(PosixMappedLogFile& file, size_t minimumSize)
+	{
+		if (isBroken) {
+			return false;
+		}
+		std::string path = _basePath + "_" + std::to_string(_paths.size()) + ".txt";
+		if (file.Open(path, (std::max)(segmentSize, minimumSize)) == false) {
+			return false;
+		}
+		_paths.push_back(path);
+		return true;
+	}
+
+	const std::vector<std::string>& Paths() const { return _paths; }
+
+	/* Lets Open() fail, like when the disk is full. */
+	bool isBroken = false;
+
+private:
+	std::string _basePath;
+	std::vector<std::string> _paths;
+};
+
+/**
+ * @brief "<thread> <line> <padding>\n". The padding lets the length vary, so the lines end at different places in the segments.
+ */
+std::string CreateLine(uint32_t thread, uint32_t line)
+{
+	std::string text = std::to_string(thread) + " " + std::to_string(line) + " ";
+	text.append((line * 31 + thread * 7) % 200, static_cast<char>('a' + line % 26));
+	text += '\n';
+	return text;
+}
+
+void CheckFullSegment()
+{
+	char memory[16];
+	LogSegment segment(memory, sizeof(memory));
+	CHECK(segment.TryAppend("0123456789", 10));
+	CHECK(segment.TryAppend("abcdefgh", 8) == false);
+	// A shorter line after a failed one also fails, so the segment has no holes.
+	CHECK(segment.TryAppend("xy", 2) == false);
+	CHECK(segment.UsedSize() == 10);
+	CHECK(std::string(memory, 10) == "0123456789");
+}
+
+void CheckRollOver()
+{
+	char directoryTemplate[] = "/tmp/LogSegmentRollOverTest-XXXXXX";
+	char* directory = mkdtemp(directoryTemplate);
+	CHECK(directory != nullptr);
+	if (directory == nullptr) {
+		return;
+	}
+
+	SegmentFiles segmentFiles(std::string(directory) + "/WhatsappTray");
+	SegmentedLog<PosixMappedLogFile> log([&](PosixMappedLogFile& file, size_t minimumSize) { return segmentFiles.Open(file, minimumSize); });
+	CHECK(log.Open());
+	std::atomic<uint32_t> failedCount = 0;
+	std::vector<std::thread> threads;
+	for (uint32_t thread = 0; thread < threadCount; thread++) {
+		threads.emplace_back([&, thread]() {
+			for (uint32_t line = 0; line < linesPerThread; line++) {
+				std::string text = CreateLine(thread, line);
+				failedCount += log.Append(text.data(), text.size()) ? 0 : 1;
+			}
+			// A line that is bigger than a segment gets its own segment.
+			std::string text = std::to_string(thread) + " " + std::to_string(linesPerThread) + " " + std::string(segmentSize * 2, 'L') + "\n";
+			failedCount += log.Append(text.data(), text.size()) ? 0 : 1;
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	log.Close();
+	CHECK(failedCount == 0);
+
+	auto paths = segmentFiles.Paths();
+	printf("  %zu segments\n", paths.size());
+	CHECK(paths.size() > 20);
+
+	std::set<std::string> expectedLines;
+	for (uint32_t thread = 0; thread < threadCount; thread++) {
+		for (uint32_t line = 0; line < linesPerThread; line++) {
+			expectedLines.insert(CreateLine(thread, line));
+		}
+		expectedLines.insert(std::to_string(thread) + " " + std::to_string(linesPerThread) + " " + std::string(segmentSize * 2, 'L') + "\n");
+	}
+
+	size_t lineCount = 0;
+	bool hasZeros = false;
+	bool hasCutLine = false;
+	std::vector<uint32_t> nextLines(threadCount, 0);
+	bool isInOrder = true;
+	for (auto& path : paths) {
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+		std::string text = content.str();
+		// The sealed file contains no zeros and every segment ends with a complete line.
+		hasZeros |= text.find('\0') != std::string::npos;
+		hasCutLine |= text.empty() || text.back() != '\n';
+
+		size_t start = 0;
+		while (start < text.size()) {
+			size_t end = text.find('\n', start);
+			if (end == std::string::npos) {
+				break;
+			}
+			std::string line = text.substr(start, end + 1 - start);
+			start = end + 1;
+			lineCount++;
+			if (expectedLines.erase(line) == 0) {
+				hasCutLine = true;
+				continue;
+			}
+			// The lines of one thread are in order over all segments.
+			uint32_t thread = static_cast<uint32_t>(strtoul(line.c_str(), nullptr, 10));
+			uint32_t number = static_cast<uint32_t>(strtoul(line.c_str() + line.find(' ') + 1, nullptr, 10));
+			isInOrder &= number == nextLines[thread];
+			nextLines[thread] = number + 1;
+		}
+		remove(path.c_str());
+	}
+	rmdir(directory);
+
+	CHECK(hasZeros == false);
+	CHECK(hasCutLine == false);
+	CHECK(isInOrder);
+	CHECK(expectedLines.empty());
+	CHECK(lineCount == threadCount * (linesPerThread + 1));
+}
+
+/**
+ * @brief The rotation by age, and what the Logger gets when no segment can be opened: Append() fails, so it continues with the fallback-file.
+ */
+void CheckRotationAndFailure()
+{
+	char directoryTemplate[] = "/tmp/LogSegmentRollOverTest-XXXXXX";
+	char* directory = mkdtemp(directoryTemplate);
+	CHECK(directory != nullptr);
+	if (directory == nullptr) {
+		return;
+	}
+
+	SegmentFiles segmentFiles(std::string(directory) + "/WhatsappTray");
+	SegmentedLog<PosixMappedLogFile> log([&](PosixMappedLogFile& file, size_t minimumSize) { return segmentFiles.Open(file, minimumSize); });
+	// Before the first segment is opened, there is nowhere to write.
+	CHECK(log.Append("a\n", 2) == false);
+	CHECK(log.Flush() == false);
+
+	CHECK(log.Open());
+	CHECK(log.Append("a\n", 2));
+	CHECK(log.Flush());
+	log.RotateIfOlderThan(std::chrono::hours(1));
+	CHECK(segmentFiles.Paths().size() == 1);
+	log.RotateIfOlderThan(std::chrono::seconds(0));
+	CHECK(segmentFiles.Paths().size() == 2);
+	CHECK(log.Append("b\n", 2));
+
+	// The next segment can not be opened. The lines that do not fit anymore are not written, and neither are all later ones.
+	segmentFiles.isBroken = true;
+	std::string fullLine(segmentSize, 'c');
+	CHECK(log.Append(fullLine.data(), fullLine.size()) == false);
+	CHECK(log.Append("d\n", 2) == false);
+	log.Close();
+
+	std::vector<std::string> contents;
+	for (auto& path : segmentFiles.Paths()) {
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+		contents.push_back(content.str());
+		remove(path.c_str());
+	}
+	rmdir(directory);
+	// The failed open sealed the second segment.
+	CHECK(contents == std::vector<std::string>({ "a\n", "b\n" }));
+}
+
+}
+
+int main()
+{
+	CheckFullSegment();
+	CheckRollOver();
+	CheckRotationAndFailure();
+
+	return TestResult("LogSegmentRollOverTest");
+}
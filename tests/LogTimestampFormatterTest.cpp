@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that the cached second of LogTimestampFormatter gives the same timestamps as formatting every line completely. (See LogTimestampFormatter.h)
+// The time-zone is set to UTC, so the expected texts do not depend on the machine.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o LogTimestampFormatterTest tests/LogTimestampFormatterTest.cpp
+
+#include "../WhatsappTray/LogTimestampFormatter.h"
+#include "TestSupport.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+
+namespace
+{
+
+using namespace std::chrono;
+
+system_clock::time_point TimeFromMilliseconds(int64_t milliseconds)
+{
+	return system_clock::time_point(duration_cast<system_clock::duration>(std::chrono::milliseconds(milliseconds)));
+}
+
+std::string Format(LogTimestampFormatter& formatter, int64_t milliseconds)
+{
+	std::string text;
+	formatter.AppendTo(text, TimeFromMilliseconds(milliseconds));
+	return text;
+}
+
+/**
+ * @brief Formats the time completely with strftime(), like it was done for every line before the cache.
+ */
+std::string FormatUncached(int64_t milliseconds, const char* formatString)
+{
+	int64_t second = milliseconds / 1000 - (milliseconds % 1000 < 0 ? 1 : 0);
+	time_t timer = static_cast<time_t>(second);
+	struct tm localTime;
+	localtime_r(&timer, &localTime);
+	char buffer[64];
+	size_t length = strftime(buffer, sizeof(buffer), formatString, &localTime);
+	snprintf(buffer + length, sizeof(buffer) - length, ".%03d", static_cast<int>(milliseconds - second * 1000));
+	return buffer;
+}
+
+void CheckKnownTimes()
+{
+	LogTimestampFormatter formatter;
+	// 2021-06-15 13:37:42.123 UTC
+	CHECK(Format(formatter, 1623764262123) == "13:37:42.123");
+	CHECK(Format(formatter, 1623764262000) == "13:37:42.000");
+	CHECK(Format(formatter, 1623764262999) == "13:37:42.999");
+	// The next second has to replace the cached one.
+	CHECK(Format(formatter, 1623764263007) == "13:37:43.007");
+	// Back in time, like after a clock-change.
+	CHECK(Format(formatter, 1623764262050) == "13:37:42.050");
+
+	// Before 1970 the second is rounded down, not towards zero.
+	CHECK(Format(formatter, -1) == "23:59:59.999");
+	CHECK(Format(formatter, -1000) == "23:59:59.000");
+	CHECK(Format(formatter, 0) == "00:00:00.000");
+
+	// Appends, does not replace.
+	std::string text = "[";
+	formatter.AppendTo(text, TimeFromMilliseconds(1623764262123));
+	CHECK(text == "[13:37:42.123");
+}
+
+void CheckSameAsUncached()
+{
+	const char* formatString = "%Y-%m-%d %H:%M:%S";
+	LogTimestampFormatter formatter(formatString);
+	CHECK(Format(formatter, 1623764262123) == "2021-06-15 13:37:42.123");
+
+	// Steps that are not a divisor of a second, so every millisecond-digit and many second-changes are hit.
+	int mismatchCount = 0;
+	for (int64_t milliseconds = 1623764000000; milliseconds < 1623764000000 + 200000; milliseconds += 37) {
+		mismatchCount += Format(formatter, milliseconds) != FormatUncached(milliseconds, formatString) ? 1 : 0;
+	}
+	CHECK(mismatchCount == 0);
+}
+
+}
+
+int main()
+{
+	setenv("TZ", "UTC", 1);
+	tzset();
+
+	CheckKnownTimes();
+	CheckSameAsUncached();
+
+	return TestResult("LogTimestampFormatterTest");
+}
@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// A TCP-server on 127.0.0.1 for the tests and the benchmark. It receives the frames like WinSockServer, but builds on Linux and can be disturbed on purpose:
+// DropConnections() closes the connections of all clients and SetReading(false) stops reading, so the socket-buffers of the client fill up.
+// NOTE: WinSockServer is not used, because it can not be disturbed like that. benchmarks/TcpServerBenchmark.cpp measures the WinSockServer itself.
+
+#pragma once
+
+#include "../WhatsappTray/LogServer.h"
+#include "../WhatsappTray/MessageFraming.h"
+#include "../WhatsappTray/PortableSocket.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+class LoopbackTcpServer : public LogServer
+{
+public:
+	LoopbackTcpServer()
+	{
+		StartupSockets();
+	}
+
+	~LoopbackTcpServer()
+	{
+		if (_listenSocket != INVALID_SOCKET) {
+			closesocket(_listenSocket);
+		}
+		CloseClients();
+		CleanupSockets();
+	}
+
+	/**
+	 * @brief Listens on a free port. Must be called before Run().
+	 */
+	bool Listen()
+	{
+		_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (_listenSocket == INVALID_SOCKET) {
+			return false;
+		}
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0;
+		socklen_t addressSize = sizeof(address);
+		if (bind(_listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+			|| listen(_listenSocket, SOMAXCONN) == SOCKET_ERROR
+			|| getsockname(_listenSocket, reinterpret_cast<sockaddr*>(&address), &addressSize) == SOCKET_ERROR) {
+			return false;
+		}
+		_portString = std::to_string(ntohs(address.sin_port));
+		return SetSocketNonBlocking(_listenSocket, true);
+	}
+
+	const char* PortString() const { return _portString.c_str(); }
+
+	bool Run() override
+	{
+		while (_isRunning) {
+			if (_dropConnections.exchange(false)) {
+				CloseClients();
+				_droppedConnectionCount++;
+			}
+
+			fd_set readSet;
+			FD_ZERO(&readSet);
+			FD_SET(_listenSocket, &readSet);
+			SOCKET maxSocket = _listenSocket;
+			bool isReading = _isReading;
+			if (isReading) {
+				for (auto& client : _clients) {
+					FD_SET(client.socket, &readSet);
+					maxSocket = client.socket > maxSocket ? client.socket : maxSocket;
+				}
+			}
+
+			timeval timeout;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = 10 * 1000;
+			if (select(SelectSocketCount(maxSocket), &readSet, NULL, NULL, &timeout) <= 0) {
+				continue;
+			}
+
+			if (FD_ISSET(_listenSocket, &readSet)) {
+				SOCKET clientSocket = accept(_listenSocket, NULL, NULL);
+				if (clientSocket != INVALID_SOCKET) {
+					_clients.push_back(Client{ clientSocket, FrameReader() });
+					_acceptedConnectionCount++;
+				}
+			}
+
+			for (size_t i = 0; isReading && i < _clients.size(); i++) {
+				if (FD_ISSET(_clients[i].socket, &readSet) && Receive(_clients[i]) == false) {
+					closesocket(_clients[i].socket);
+					_clients.erase(_clients.begin() + i);
+					i--;
+				}
+			}
+		}
+		return true;
+	}
+
+	void Stop() override { _isRunning = false; }
+
+	/**
+	 * @brief Closes the connections of all clients, like a restarted WhatsappTray. Can be called from any thread.
+	 */
+	void DropConnections() { _dropConnections = true; }
+
+	/**
+	 * @brief Stops or continues reading from the clients. Can be called from any thread.
+	 */
+	void SetReading(bool isReading) { _isReading = isReading; }
+
+	uint32_t AcceptedConnectionCount() const { return _acceptedConnectionCount; }
+	uint32_t DroppedConnectionCount() const { return _droppedConnectionCount; }
+
+private:
+	struct Client
+	{
+		SOCKET socket;
+		FrameReader frameReader;
+	};
+
+	std::string _portString;
+	SOCKET _listenSocket = INVALID_SOCKET;
+	/* Only used from the thread of Run(). */
+	std::vector<Client> _clients;
+	std::atomic<bool> _isRunning = true;
+	std::atomic<bool> _isReading = true;
+	std::atomic<bool> _dropConnections = false;
+	std::atomic<uint32_t> _acceptedConnectionCount = 0;
+	std::atomic<uint32_t> _droppedConnectionCount = 0;
+
+	bool Receive(Client& client)
+	{
+		char buffer[64 * 1024];
+		int size = static_cast<int>(recv(client.socket, buffer, sizeof(buffer), 0));
+		if (size <= 0) {
+			return false;
+		}
+
+		client.frameReader.Append(buffer, size);
+		std::string frame;
+		while (client.frameReader.NextFrame(frame)) {
+			ForwardRecord(frame);
+		}
+		return client.frameReader.HasError() == false;
+	}
+
+	void CloseClients()
+	{
+		for (auto& client : _clients) {
+			closesocket(client.socket);
+		}
+		_clients.clear();
+	}
+};
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that MessageBatch coalesces the messages into frames and decides correctly when the batch has to be sent. (See MessageBatch.h)
+// The time is passed in, so the flush-deadline is checked without sleeping.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o MessageBatchTest tests/MessageBatchTest.cpp
+
+#include "../WhatsappTray/MessageBatch.h"
+#include "TestSupport.h"
+
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using Clock = MessageBatch::Clock;
+
+/**
+ * @brief Splits the data of the batch into the messages again, like the server does it.
+ */
+std::vector<std::string> ReadFrames(const std::string& data, bool* hasError)
+{
+	FrameReader frameReader;
+	frameReader.Append(data.data(), data.size());
+	std::vector<std::string> messages;
+	std::string message;
+	while (frameReader.NextFrame(message)) {
+		messages.push_back(message);
+	}
+	*hasError = frameReader.HasError();
+	return messages;
+}
+
+void CheckCoalescing()
+{
+	MessageBatch batch;
+	auto now = Clock::now();
+	CHECK(batch.IsEmpty());
+
+	std::vector<std::string> messages = { "first", "", std::string(3000, 'x'), "last" };
+	for (auto& message : messages) {
+		batch.Add(message, now);
+	}
+	CHECK(batch.MessageCount() == messages.size());
+	CHECK(batch.Data().size() == 4 * frameHeaderSize + 5 + 0 + 3000 + 4);
+
+	bool hasError = true;
+	CHECK(ReadFrames(batch.Data(), &hasError) == messages);
+	CHECK(hasError == false);
+
+	// The memory is kept for the next batch.
+	auto capacity = batch.Data().capacity();
+	batch.Clear();
+	CHECK(batch.IsEmpty());
+	CHECK(batch.Data().empty());
+	CHECK(batch.Data().capacity() == capacity);
+}
+
+void CheckFullByMessages()
+{
+	MessageBatchConfig config;
+	config.maxMessages = 3;
+	MessageBatch batch(config);
+	auto now = Clock::now();
+
+	batch.Add("a", now);
+	batch.Add("b", now);
+	CHECK(batch.IsFull() == false);
+	CHECK(batch.ShouldFlush(now) == false);
+	batch.Add("c", now);
+	CHECK(batch.IsFull());
+	CHECK(batch.ShouldFlush(now));
+}
+
+void CheckFullByBytes()
+{
+	MessageBatchConfig config;
+	config.maxBytes = 100;
+	MessageBatch batch(config);
+	auto now = Clock::now();
+
+	batch.Add(std::string(90, 'x'), now);
+	CHECK(batch.IsFull() == false);
+	// The frame-header counts too.
+	batch.Add(std::string(6, 'y'), now);
+	CHECK(batch.Data().size() == 104);
+	CHECK(batch.IsFull());
+}
+
+void CheckDeadline()
+{
+	MessageBatchConfig config;
+	config.flushInterval = std::chrono::milliseconds(5);
+	MessageBatch batch(config);
+	auto start = Clock::now();
+
+	// An empty batch is never sent.
+	CHECK(batch.ShouldFlush(start + std::chrono::hours(1)) == false);
+
+	// The deadline starts with the first message and is not moved by the following ones.
+	batch.Add("first", start);
+	batch.Add("second", start + std::chrono::milliseconds(4));
+	CHECK(batch.ShouldFlush(start + std::chrono::milliseconds(4)) == false);
+	CHECK(batch.TimeUntilDeadline(start + std::chrono::milliseconds(3)) == std::chrono::milliseconds(2));
+	CHECK(batch.ShouldFlush(start + std::chrono::milliseconds(5)));
+	CHECK(batch.TimeUntilDeadline(start + std::chrono::milliseconds(7)) == Clock::duration::zero());
+
+	// After the batch was sent, the next message starts a new deadline.
+	batch.Clear();
+	auto later = start + std::chrono::milliseconds(100);
+	batch.Add("third", later);
+	CHECK(batch.ShouldFlush(later + std::chrono::milliseconds(4)) == false);
+	CHECK(batch.ShouldFlush(later + std::chrono::milliseconds(5)));
+}
+
+}
+
+int main()
+{
+	CheckCoalescing();
+	CheckFullByMessages();
+	CheckFullByBytes();
+	CheckDeadline();
+
+	return TestResult("MessageBatchTest");
+}
@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that logging in the hook does not allocate once the buffer-pool is warmed up. (See MessageBufferPool.h)
+// The allocations of the thread that logs are counted with a replaced operator new.
+// - The server reads: The message-processing thread returns the buffers after it copied them into the batch.
+// - The server is not reachable: The full buffer drops the oldest messages and their buffers go back into the pool.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o MessageBufferPoolAllocationTest tests/MessageBufferPoolAllocationTest.cpp
+
+#include "../WhatsappTray/MessageSender.h"
+#include "TestSupport.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+
+namespace
+{
+
+thread_local bool isCountingAllocations = false;
+std::atomic<uint64_t> allocationCount = 0;
+
+/**
+ * @brief Sends nothing. Can pretend that the server is not reachable.
+ */
+class DiscardingTransport : public LogTransport
+{
+public:
+	explicit DiscardingTransport(bool isReachable) : _isReachable(isReachable) { }
+
+	bool Open() override { return true; }
+	bool Connect() override { return _isReachable; }
+	bool IsConnected() const override { return _isReachable; }
+	void SetTimeout(std::chrono::milliseconds /*timeout*/) override { }
+	bool Send(const char /*data*/[], size_t /*size*/) override { return _isReachable; }
+	void Close() override { }
+	const char* Name() const override { return "discarding"; }
+
+private:
+	bool _isReachable;
+};
+
+/**
+ * @return The count of allocations of the thread that logged.
+ */
+uint64_t CountAllocationsWhileLogging(bool isReachable, QueueFullPolicy fullPolicy)
+{
+	MessageSender sender;
+	// Fewer messages fit into the buffer than the pool has buffers, so the pool can not run empty while the messages are on the way.
+	MessageQueueConfig queueConfig;
+	queueConfig.capacity = 128;
+	queueConfig.fullPolicy = fullPolicy;
+	sender.Start([=]() { return std::make_unique<DiscardingTransport>(isReachable); }, 1, queueConfig);
+
+	const std::string text = "A line of the hook that fits into a buffer of the pool.";
+	auto logLine = [&]() {
+		std::string record = sender.TakeBuffer();
+		LogRecordWriter::BeginText(record, 1);
+		record.append(text);
+		sender.Send(std::move(record), MessageLane::Bulk);
+	};
+
+	// Warm up, so the buffer of the lane is full when the server is not reachable.
+	for (int i = 0; i < 10000; i++) {
+		logLine();
+	}
+
+	allocationCount = 0;
+	isCountingAllocations = true;
+	for (int i = 0; i < 100000; i++) {
+		logLine();
+	}
+	isCountingAllocations = false;
+
+	sender.Stop(std::chrono::milliseconds(0));
+	return allocationCount;
+}
+
+}
+
+void* operator new(size_t size)
+{
+	if (isCountingAllocations) {
+		allocationCount++;
+	}
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t /*size*/) noexcept
+{
+	free(memory);
+}
+
+int main()
+{
+	uint64_t reachableCount = CountAllocationsWhileLogging(true, QueueFullPolicy::DropOldest);
+	uint64_t dropOldestCount = CountAllocationsWhileLogging(false, QueueFullPolicy::DropOldest);
+	uint64_t dropNewestCount = CountAllocationsWhileLogging(false, QueueFullPolicy::DropNewest);
+	printf("  allocations for 100000 lines: reachable=%llu dropOldest=%llu dropNewest=%llu\n", static_cast<unsigned long long>(reachableCount),
+		static_cast<unsigned long long>(dropOldestCount), static_cast<unsigned long long>(dropNewestCount));
+
+	CHECK(reachableCount == 0);
+	CHECK(dropOldestCount == 0);
+	CHECK(dropNewestCount == 0);
+
+	return TestResult("MessageBufferPoolAllocationTest");
+}
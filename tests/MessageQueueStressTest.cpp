@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Lets multiple producers and consumers hammer a small MessageQueue and checks that no message is lost or delivered twice. (See MessageQueue.h)
+// Every message ends exactly one way: It is taken by a consumer, removed by DropOldest (evictedMessageHandler) or rejected (Enqueue() did not move it).
+// - The capacity is small, so the positions wrap around the ring many times.
+// - With DropOldest the producers take messages themselves, at the same time as the consumers.
+// - The producers pause from time to time, so the consumer sleeps in WaitDequeue() again and again. A lost wake-up shows up as a long wait.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o MessageQueueStressTest tests/MessageQueueStressTest.cpp
+
+#include "../WhatsappTray/MessageQueue.h"
+#include "TestSupport.h"
+
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t producerCount = 4;
+constexpr uint32_t messagesPerProducer = 50000;
+/* A consumer that waited this long for a message that was already in the queue missed its wake-up. */
+constexpr auto lostWakeUpTime = std::chrono::milliseconds(500);
+
+const char* PolicyName(QueueFullPolicy policy)
+{
+	switch (policy) {
+	case QueueFullPolicy::DropNewest: return "DropNewest";
+	case QueueFullPolicy::DropOldest: return "DropOldest";
+	case QueueFullPolicy::Block: return "Block";
+	}
+	return "?";
+}
+
+/**
+ * @brief [producer uint32][sequence uint32] and some padding, so the messages do not all have the same size.
+ */
+std::string CreateMessage(uint32_t producer, uint32_t sequence)
+{
+	std::string message(8 + sequence % 24, 'p');
+	memcpy(&message[0], &producer, sizeof(producer));
+	memcpy(&message[4], &sequence, sizeof(sequence));
+	return message;
+}
+
+uint32_t MessageId(const std::string& message, uint32_t* sequenceOut = nullptr)
+{
+	uint32_t producer;
+	uint32_t sequence;
+	memcpy(&producer, message.data(), sizeof(producer));
+	memcpy(&sequence, message.data() + 4, sizeof(sequence));
+	if (sequenceOut != nullptr) {
+		*sequenceOut = sequence;
+	}
+	return producer * messagesPerProducer + sequence;
+}
+
+/**
+ * @param consumerCount 1: One consumer with WaitDequeue(), which also checks the order. More: The consumers only use TryDequeue().
+ */
+void RunStress(QueueFullPolicy policy, size_t capacity, uint32_t consumerCount)
+{
+	printf("  %s capacity=%zu consumers=%u\n", PolicyName(policy), capacity, consumerCount);
+
+	std::unique_ptr<std::atomic<uint8_t>[]> outcomes(new std::atomic<uint8_t>[producerCount * messagesPerProducer]);
+	for (uint32_t i = 0; i < producerCount * messagesPerProducer; i++) {
+		outcomes[i] = 0;
+	}
+	std::atomic<uint64_t> receivedCount = 0;
+	std::atomic<uint64_t> evictedCount = 0;
+	std::atomic<uint64_t> rejectedCount = 0;
+	std::atomic<uint64_t> lostWakeUpCount = 0;
+	std::atomic<uint64_t> outOfOrderCount = 0;
+
+	MessageQueueConfig config;
+	config.capacity = capacity;
+	config.fullPolicy = policy;
+	config.blockTimeout = std::chrono::milliseconds(10000);
+	config.evictedMessageHandler = [&](std::string&& message) {
+		outcomes[MessageId(message)]++;
+		evictedCount++;
+	};
+	MessageQueue queue(config);
+
+	std::atomic<uint32_t> runningProducers = producerCount;
+	std::vector<std::thread> threads;
+	for (uint32_t producer = 0; producer < producerCount; producer++) {
+		threads.emplace_back([&, producer]() {
+			for (uint32_t sequence = 0; sequence < messagesPerProducer; sequence++) {
+				std::string message = CreateMessage(producer, sequence);
+				queue.Enqueue(std::move(message));
+				// A rejected message is not moved.
+				if (message.empty() == false) {
+					outcomes[MessageId(message)]++;
+					rejectedCount++;
+				}
+				// Let the queue run empty, so the consumer has to sleep and be woken up.
+				if (sequence % 2000 == 0) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+			runningProducers--;
+		});
+	}
+
+	for (uint32_t consumer = 0; consumer < consumerCount; consumer++) {
+		threads.emplace_back([&]() {
+			std::vector<int64_t> lastSequences(producerCount, -1);
+			std::string message;
+			while (true) {
+				bool hasMessage;
+				if (consumerCount == 1) {
+					auto start = std::chrono::steady_clock::now();
+					hasMessage = queue.WaitDequeueTimed(message, std::chrono::microseconds(1000 * 1000));
+					if (hasMessage && std::chrono::steady_clock::now() - start >= lostWakeUpTime) {
+						lostWakeUpCount++;
+					}
+				} else {
+					hasMessage = queue.TryDequeue(message);
+				}
+
+				if (hasMessage == false) {
+					if (runningProducers == 0 && queue.Size() == 0) {
+						break;
+					}
+					continue;
+				}
+
+				uint32_t sequence;
+				uint32_t id = MessageId(message, &sequence);
+				uint32_t producer = id / messagesPerProducer;
+				if (static_cast<int64_t>(sequence) <= lastSequences[producer]) {
+					outOfOrderCount++;
+				}
+				lastSequences[producer] = sequence;
+				outcomes[id]++;
+				receivedCount++;
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	uint64_t wrongOutcomeCount = 0;
+	for (uint32_t i = 0; i < producerCount * messagesPerProducer; i++) {
+		wrongOutcomeCount += outcomes[i] != 1 ? 1 : 0;
+	}
+	uint64_t droppedCount = queue.TakeDroppedCount();
+	printf("    received=%llu evicted=%llu rejected=%llu\n", static_cast<unsigned long long>(receivedCount.load()), static_cast<unsigned long long>(evictedCount.load()), static_cast<unsigned long long>(rejectedCount.load()));
+
+	// Lost, or delivered more than once.
+	CHECK(wrongOutcomeCount == 0);
+	CHECK(receivedCount + evictedCount + rejectedCount == producerCount * messagesPerProducer);
+	CHECK(droppedCount == evictedCount + rejectedCount);
+	CHECK(queue.Size() == 0);
+	CHECK(lostWakeUpCount == 0);
+	if (consumerCount == 1) {
+		CHECK(outOfOrderCount == 0);
+	}
+	if (policy == QueueFullPolicy::Block) {
+		CHECK(droppedCount == 0);
+	}
+	if (policy != QueueFullPolicy::DropOldest) {
+		CHECK(evictedCount == 0);
+	}
+}
+
+}
+
+int main()
+{
+	for (auto policy : { QueueFullPolicy::DropNewest, QueueFullPolicy::DropOldest, QueueFullPolicy::Block }) {
+		RunStress(policy, 8, 1);
+		RunStress(policy, 64, 3);
+	}
+
+	return TestResult("MessageQueueStressTest");
+}
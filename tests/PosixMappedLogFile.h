@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The Linux stand-in for MappedLogFile, used by the tests and the benchmarks. (See WhatsappTray/MappedLogFile.h)
+// The segment is mapped with mmap() and ftruncate() the same way: The file gets the full size up front and is cut to the used size when it is closed.
+// NOTE: Only builds on Linux.
+
+#pragma once
+
+#include "../WhatsappTray/LogSegment.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+
+class PosixMappedLogFile
+{
+public:
+	~PosixMappedLogFile() { Close(); }
+
+	bool Open(const std::string& path, size_t size)
+	{
+		Close();
+
+		_file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if (_file < 0 || ftruncate(_file, static_cast<off_t>(size)) != 0) {
+			Close();
+			return false;
+		}
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0);
+		if (memory == MAP_FAILED) {
+			Close();
+			return false;
+		}
+		_memory = static_cast<char*>(memory);
+		_size = size;
+		_segment = std::make_unique<LogSegment>(_memory, size);
+		return true;
+	}
+
+	void Close()
+	{
+		size_t usedSize = _segment != nullptr ? _segment->UsedSize() : 0;
+		_segment.reset();
+		if (_memory != nullptr) {
+			munmap(_memory, _size);
+			_memory = nullptr;
+		}
+		if (_file >= 0) {
+			// Seal the segment, like MappedLogFile::Close().
+			if (ftruncate(_file, static_cast<off_t>(usedSize)) != 0) {
+				fprintf(stderr, "ERROR: The log-segment could not be cut to the used size.\n");
+			}
+			close(_file);
+			_file = -1;
+		}
+	}
+
+	bool TryAppend(const char* text, size_t length) { return _segment->TryAppend(text, length); }
+
+	void Flush()
+	{
+		if (_memory != nullptr) {
+			msync(_memory, _size, MS_SYNC);
+		}
+	}
+
+private:
+	int _file = -1;
+	char* _memory = nullptr;
+	size_t _size = 0;
+	std::unique_ptr<LogSegment> _segment;
+};
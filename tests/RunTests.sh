@@ -0,0 +1,26 @@
+#!/bin/sh
+# Builds and runs all tests on Linux. Every test is built with the command in its "Build on Linux:"-line.
+# Run from the root of the repository: sh tests/RunTests.sh
+
+buildDirectory=$(mktemp -d)
+trap 'rm -rf "$buildDirectory"' EXIT
+
+failedTests=""
+for testSource in tests/*Test.cpp; do
+	testName=$(basename "$testSource" .cpp)
+	buildCommand=$(sed -n 's|^// Build on Linux: *||p' "$testSource" | sed "s|-o $testName|-o $buildDirectory/$testName|")
+	if ! sh -c "$buildCommand"; then
+		echo "$testName: build failed"
+		failedTests="$failedTests $testName"
+		continue
+	fi
+	if ! "$buildDirectory/$testName"; then
+		failedTests="$failedTests $testName"
+	fi
+done
+
+if [ -n "$failedTests" ]; then
+	echo "Failed:$failedTests"
+	exit 1
+fi
+echo "All tests passed."
@@ -0,0 +1,230 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks the ring in shared memory between two processes, like the hook and WhatsappTray. (See SharedMemoryRing.h)
+// On Linux POSIX shared memory stands in for the file-mapping and an eventfd for the event of SharedMemoryServer.
+// - Write() writes all bytes or nothing.
+// - The frames of a writer-process arrive complete and in order, while the positions wrap around the small ring many times.
+// - After a corrupt frame the reader skips to the write-position and receives the following frames again.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o SharedMemoryRingTest tests/SharedMemoryRingTest.cpp -lrt
+
+#include "../WhatsappTray/SharedMemoryRing.h"
+#include "TestSupport.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t ringCapacity = 4096;
+constexpr uint32_t framesBeforeCorruption = 20000;
+constexpr uint32_t framesAfterCorruption = 2000;
+
+/**
+ * @brief "frame <number> <padding>". The padding lets the size of the frames vary between 16 bytes and 1KB.
+ */
+std::string CreatePayload(uint32_t number)
+{
+	std::string payload = "frame " + std::to_string(number) + " ";
+	payload.append((number * 7919) % 1000, static_cast<char>('a' + number % 26));
+	return payload;
+}
+
+/**
+ * @brief The shared memory of the ring, mapped again in every process like MapViewOfFile() does it.
+ */
+void* MapSharedMemory(const std::string& name, size_t size, bool create)
+{
+	int file = shm_open(name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDWR, 0600);
+	if (file < 0) {
+		return nullptr;
+	}
+	if (create && ftruncate(file, static_cast<off_t>(size)) != 0) {
+		close(file);
+		return nullptr;
+	}
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void Signal(int event)
+{
+	uint64_t value = 1;
+	(void)!write(event, &value, sizeof(value));
+}
+
+/**
+ * @brief Like WaitForSingleObject() on an auto-reset event.
+ *
+ * @return False on timeout.
+ */
+bool Wait(int event, int timeoutMs)
+{
+	pollfd pollEvent{ event, POLLIN, 0 };
+	if (poll(&pollEvent, 1, timeoutMs) <= 0) {
+		return false;
+	}
+	uint64_t value;
+	(void)!read(event, &value, sizeof(value));
+	return true;
+}
+
+/**
+ * @brief Retries until there is enough free space in the ring, like a hook whose WhatsappTray is slow.
+ */
+bool WriteFrame(SharedMemoryRing& ring, int dataWrittenEvent, const std::string& frame)
+{
+	for (int attempt = 0; attempt < 100000; attempt++) {
+		if (ring.Write(frame.data(), frame.size())) {
+			Signal(dataWrittenEvent);
+			return true;
+		}
+		usleep(10);
+	}
+	return false;
+}
+
+/**
+ * @brief The hook: Writes the frames, then a corrupt frame and after the reader skipped it more frames.
+ *
+ * @return The exit-code of the process.
+ */
+int RunWriter(const std::string& name, size_t memorySize, int dataWrittenEvent, int skippedEvent)
+{
+	void* memory = MapSharedMemory(name, memorySize, false);
+	SharedMemoryRing ring;
+	if (memory == nullptr || ring.Attach(memory, memorySize) == false) {
+		return 2;
+	}
+
+	std::string frame;
+	for (uint32_t number = 0; number < framesBeforeCorruption; number++) {
+		frame.clear();
+		std::string payload = CreatePayload(number);
+		MessageFraming::AppendFrame(frame, payload.data(), payload.size());
+		if (WriteFrame(ring, dataWrittenEvent, frame) == false) {
+			return 3;
+		}
+	}
+
+	// A length that is too big, followed by the start of a payload, like a hook with another version of the framing.
+	std::string corruptFrame = "\xFF\xFF\xFF\x7F" "garbage";
+	if (WriteFrame(ring, dataWrittenEvent, corruptFrame) == false) {
+		return 4;
+	}
+	// Frames that were written before the reader skipped, are skipped too. Wait so the count of received frames is known.
+	if (Wait(skippedEvent, 5000) == false) {
+		return 5;
+	}
+
+	for (uint32_t number = framesBeforeCorruption; number < framesBeforeCorruption + framesAfterCorruption; number++) {
+		frame.clear();
+		std::string payload = CreatePayload(number);
+		MessageFraming::AppendFrame(frame, payload.data(), payload.size());
+		if (WriteFrame(ring, dataWrittenEvent, frame) == false) {
+			return 6;
+		}
+	}
+	return 0;
+}
+
+void CheckAllOrNothing()
+{
+	std::vector<char> memory(SharedMemoryRing::RequiredMemorySize(64));
+	SharedMemoryRing ring;
+	CHECK(ring.Create(memory.data(), memory.size(), 64));
+	CHECK(ring.Create(memory.data(), memory.size(), 48) == false);
+
+	std::string data(60, 'x');
+	CHECK(ring.Write(data.data(), 60));
+	CHECK(ring.Write(data.data(), 8) == false);
+	CHECK(ring.UsedBytes() == 60);
+
+	char buffer[64];
+	CHECK(ring.Read(buffer, 32) == 32);
+	// Wraps around the end of the data-area.
+	std::string wrapped = "0123456789abcdefghijklmnopqrstuv";
+	CHECK(ring.Write(wrapped.data(), wrapped.size()));
+	CHECK(ring.Read(buffer, sizeof(buffer)) == 60);
+	CHECK(std::string(buffer + 28, 32) == wrapped);
+	CHECK(ring.UsedBytes() == 0);
+}
+
+void CheckBetweenProcesses()
+{
+	std::string name = "/WhatsappTrayRingTest-" + std::to_string(getpid());
+	size_t memorySize = SharedMemoryRing::RequiredMemorySize(ringCapacity);
+	void* memory = MapSharedMemory(name, memorySize, true);
+	CHECK(memory != nullptr);
+	if (memory == nullptr) {
+		return;
+	}
+	SharedMemoryRing ring;
+	CHECK(ring.Create(memory, memorySize, ringCapacity));
+
+	int dataWrittenEvent = eventfd(0, 0);
+	int skippedEvent = eventfd(0, 0);
+	pid_t writer = fork();
+	if (writer == 0) {
+		_exit(RunWriter(name, memorySize, dataWrittenEvent, skippedEvent));
+	}
+
+	// The loop of SharedMemoryServer::Run().
+	SharedMemoryFrameReader frameReader(ring);
+	std::vector<uint32_t> receivedNumbers;
+	bool hasCorruptFrame = false;
+	size_t skippedBytes = 0;
+	while (receivedNumbers.size() < framesBeforeCorruption + framesAfterCorruption) {
+		if (Wait(dataWrittenEvent, 5000) == false) {
+			break;
+		}
+		size_t skipped = frameReader.ReadFrames([&](const std::string& payload) {
+			uint32_t number = static_cast<uint32_t>(strtoul(payload.c_str() + 6, nullptr, 10));
+			hasCorruptFrame |= payload != CreatePayload(number);
+			receivedNumbers.push_back(number);
+		});
+		if (skipped > 0) {
+			skippedBytes += skipped;
+			Signal(skippedEvent);
+		}
+	}
+
+	int status = -1;
+	waitpid(writer, &status, 0);
+	printf("  received %zu frames, skipped %zu bytes\n", receivedNumbers.size(), skippedBytes);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	CHECK(hasCorruptFrame == false);
+	CHECK(skippedBytes >= 11);
+	CHECK(receivedNumbers.size() == framesBeforeCorruption + framesAfterCorruption);
+	bool isInOrder = true;
+	for (uint32_t i = 0; i < receivedNumbers.size(); i++) {
+		isInOrder &= receivedNumbers[i] == i;
+	}
+	CHECK(isInOrder);
+	CHECK(ring.UsedBytes() == 0);
+
+	close(dataWrittenEvent);
+	close(skippedEvent);
+	munmap(memory, memorySize);
+	shm_unlink(name.c_str());
+}
+
+}
+
+int main()
+{
+	CheckAllOrNothing();
+	CheckBetweenProcesses();
+
+	return TestResult("SharedMemoryRingTest");
+}
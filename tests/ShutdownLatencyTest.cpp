@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that MessageSender::Stop() returns in time while WhatsApp exits, also with a full message-buffer and a WhatsappTray that does not answer.
+// Stop() must return after timeout + transportTimeout at the latest. (See MessageSender::Stop())
+// - A server that accepts the connection but does not read: Every send blocks until the socket-buffer times out.
+// - A server whose backlog is full: Every connect blocks until it times out.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o ShutdownLatencyTest tests/ShutdownLatencyTest.cpp WhatsappTray/TcpClient.cpp
+
+#include "../WhatsappTray/MessageSender.h"
+#include "../WhatsappTray/TcpClient.h"
+#include "LoopbackTcpServer.h"
+#include "TestSupport.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+/* For the scheduling of the threads of the test. */
+constexpr auto tolerance = std::chrono::milliseconds(150);
+
+/**
+ * @brief A listen-socket that never accepts. Its backlog is filled, so new connects do not complete.
+ */
+class UnreachableServer
+{
+public:
+	UnreachableServer()
+	{
+		StartupSockets();
+		_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t addressSize = sizeof(address);
+		bind(_listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+		listen(_listenSocket, 0);
+		getsockname(_listenSocket, reinterpret_cast<sockaddr*>(&address), &addressSize);
+		_portString = std::to_string(ntohs(address.sin_port));
+
+		for (int i = 0; i < 4; i++) {
+			SOCKET fillSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			SetSocketNonBlocking(fillSocket, true);
+			connect(fillSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+			_fillSockets.push_back(fillSocket);
+		}
+	}
+
+	~UnreachableServer()
+	{
+		for (auto fillSocket : _fillSockets) {
+			closesocket(fillSocket);
+		}
+		closesocket(_listenSocket);
+		CleanupSockets();
+	}
+
+	const char* PortString() const { return _portString.c_str(); }
+
+private:
+	SOCKET _listenSocket;
+	std::vector<SOCKET> _fillSockets;
+	std::string _portString;
+};
+
+/**
+ * @brief Fills the buffer of the sender until it is full and the message-processing thread is stuck in a connect or send. Then measures Stop().
+ */
+void CheckStopLatency(const char* testCase, const char* portString, std::chrono::milliseconds timeout)
+{
+	MessageSender sender;
+	// Retry without a pause, so the message-processing thread is always in a connect or send.
+	ReconnectConfig reconnectConfig;
+	reconnectConfig.initialBackoff = std::chrono::milliseconds(1);
+	reconnectConfig.maxBackoff = std::chrono::milliseconds(1);
+	sender.Start([&]() { return std::make_unique<TcpClient>("127.0.0.1", portString); }, 1, MessageQueueConfig(), MessageBatchConfig(), reconnectConfig);
+
+	std::atomic<bool> isProducing = true;
+	std::thread producer([&]() {
+		std::string text(4000, 'x');
+		while (isProducing) {
+			std::string record = sender.TakeBuffer();
+			LogRecordWriter::BeginText(record, 1);
+			record.append(text);
+			sender.Send(std::move(record), MessageLane::Bulk);
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(700));
+
+	auto start = std::chrono::steady_clock::now();
+	uint64_t unsentCount = sender.Stop(timeout);
+	auto duration = std::chrono::steady_clock::now() - start;
+	isProducing = false;
+	producer.join();
+
+	auto durationMs = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+	printf("  %s: Stop(%lldms) took %lldms, %llu messages unsent\n", testCase, static_cast<long long>(timeout.count()), static_cast<long long>(durationMs), static_cast<unsigned long long>(unsentCount));
+	CHECK(duration <= timeout + MessageSender::transportTimeout + tolerance);
+}
+
+}
+
+int main()
+{
+	LoopbackTcpServer notReadingServer;
+	CHECK(notReadingServer.Listen());
+	notReadingServer.SetReading(false);
+	std::thread serverThread([&]() { notReadingServer.Run(); });
+
+	for (auto timeout : { std::chrono::milliseconds(0), std::chrono::milliseconds(200), std::chrono::milliseconds(1000) }) {
+		CheckStopLatency("not reading", notReadingServer.PortString(), timeout);
+	}
+
+	notReadingServer.Stop();
+	serverThread.join();
+
+	UnreachableServer unreachableServer;
+	for (auto timeout : { std::chrono::milliseconds(0), std::chrono::milliseconds(200), std::chrono::milliseconds(1000) }) {
+		CheckStopLatency("unreachable", unreachableServer.PortString(), timeout);
+	}
+
+	return TestResult("ShutdownLatencyTest");
+}
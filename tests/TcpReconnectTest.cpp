@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that no message is lost or duplicated when the server closes the connection between two batches, like a restarted WhatsappTray.
+// The messages have different sizes, so the frames are split over multiple recv()-calls and the framing is checked on every new connection.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o TcpReconnectTest tests/TcpReconnectTest.cpp WhatsappTray/TcpClient.cpp
+
+#include "../WhatsappTray/MessageSender.h"
+#include "../WhatsappTray/TcpClient.h"
+#include "LoopbackTcpServer.h"
+#include "TestSupport.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t roundCount = 5;
+constexpr uint32_t messagesPerRound = 200;
+
+/**
+ * @brief "message <number> <padding>". The padding lets the size of the frames vary between 16 bytes and 8KB.
+ */
+std::string CreateMessage(uint32_t number)
+{
+	std::string text = "message " + std::to_string(number) + " ";
+	text.append((number * 7919) % 8192, static_cast<char>('a' + number % 26));
+	return text;
+}
+
+}
+
+int main()
+{
+	LoopbackTcpServer server;
+	CHECK(server.Listen());
+
+	// Only touched by the thread of the server.
+	std::vector<uint32_t> receivedNumbers;
+	bool hasCorruptMessage = false;
+	std::atomic<uint32_t> receivedCount = 0;
+	server.NotifyOnNewMessage([&](const LogLine& line) {
+		if (line.text.compare(0, 8, "message ") != 0) {
+			return;
+		}
+		uint32_t number = static_cast<uint32_t>(strtoul(line.text.c_str() + 8, nullptr, 10));
+		hasCorruptMessage |= line.text != CreateMessage(number);
+		receivedNumbers.push_back(number);
+		receivedCount++;
+	});
+	std::thread serverThread([&]() { server.Run(); });
+
+	std::string portString = server.PortString();
+	MessageSender sender;
+	// The server is always reachable, so the reconnect must not wait for a backoff.
+	ReconnectConfig reconnectConfig;
+	reconnectConfig.initialBackoff = std::chrono::milliseconds(1);
+	sender.Start([&]() { return std::make_unique<TcpClient>("127.0.0.1", portString.c_str()); }, 1, MessageQueueConfig(), MessageBatchConfig(), reconnectConfig);
+
+	uint32_t sentCount = 0;
+	for (uint32_t round = 0; round < roundCount; round++) {
+		for (uint32_t i = 0; i < messagesPerRound; i++) {
+			std::string record = sender.TakeBuffer();
+			LogRecordWriter::BeginText(record, 1);
+			record.append(CreateMessage(sentCount++));
+			sender.Send(std::move(record), MessageLane::Bulk);
+		}
+		CHECK(WaitUntil([&]() { return receivedCount == sentCount; }));
+
+		// The connection is idle now. The next batch is the first one that meets the closed connection.
+		server.DropConnections();
+		CHECK(WaitUntil([&]() { return server.DroppedConnectionCount() == round + 1; }));
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+
+	// Stop() sends the statistics of the lanes over one more connection.
+	CHECK(sender.Stop(std::chrono::milliseconds(1000)) == 0);
+	CHECK(WaitUntil([&]() { return server.AcceptedConnectionCount() == roundCount + 1; }));
+	server.Stop();
+	serverThread.join();
+
+	CHECK(hasCorruptMessage == false);
+	CHECK(receivedNumbers.size() == sentCount);
+	bool isInOrder = true;
+	for (uint32_t i = 0; i < receivedNumbers.size(); i++) {
+		isInOrder &= receivedNumbers[i] == i;
+	}
+	CHECK(isInOrder);
+
+	return TestResult("TcpReconnectTest");
+}
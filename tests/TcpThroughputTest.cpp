@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks the throughput of the persistent, framed TCP-connection of the hook over the loopback. (See TcpClient.h and MessageFraming.h)
+// Before, every message opened its own connection and waited for the acknowledge of the server, which allowed a few thousand messages per second at best.
+// The limit of the check is far below what the persistent connection reaches, so the test does not fail on a slow or busy machine.
+// For exact numbers and the other transports see benchmarks/LogTransportBenchmark.cpp.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o TcpThroughputTest tests/TcpThroughputTest.cpp WhatsappTray/TcpClient.cpp
+
+#include "../WhatsappTray/MessageSender.h"
+#include "../WhatsappTray/TcpClient.h"
+#include "LoopbackTcpServer.h"
+#include "TestSupport.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+constexpr uint32_t messageCount = 200000;
+constexpr size_t messageSize = 100;
+/* Messages per second that the persistent connection has to reach at least. */
+constexpr double minimumThroughput = 20000;
+
+}
+
+int main()
+{
+	LoopbackTcpServer server;
+	CHECK(server.Listen());
+
+	// Only touched by the thread of the server.
+	uint64_t receivedBytes = 0;
+	std::atomic<uint32_t> receivedCount = 0;
+	server.NotifyOnNewMessage([&](const LogLine& line) {
+		if (line.text.compare(0, 6, "bench ") != 0) {
+			return;
+		}
+		receivedBytes += line.text.size();
+		receivedCount.fetch_add(1, std::memory_order_release);
+	});
+	std::thread serverThread([&]() { server.Run(); });
+
+	std::string portString = server.PortString();
+	// The lanes hold all messages, so none is dropped while the first connect is made.
+	MessageQueueConfig queueConfig;
+	queueConfig.capacity = messageCount;
+	queueConfig.maxBytes = messageCount * 256;
+	MessageSender sender;
+	sender.Start([&]() { return std::make_unique<TcpClient>("127.0.0.1", portString.c_str()); }, 1, queueConfig);
+
+	std::string text = "bench ";
+	text.append(messageSize - text.size(), 'x');
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < messageCount; i++) {
+		std::string record = sender.TakeBuffer();
+		LogRecordWriter::BeginText(record, 1);
+		record.append(text);
+		sender.Send(std::move(record), MessageLane::Bulk);
+	}
+	CHECK(WaitUntil([&]() { return receivedCount.load(std::memory_order_acquire) == messageCount; }, std::chrono::milliseconds(30000)));
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	CHECK(sender.Stop(std::chrono::milliseconds(1000)) == 0);
+	server.Stop();
+	serverThread.join();
+
+	double throughput = receivedCount / seconds;
+	printf("  %u messages in %.3fs: %.0f messages/s %.1f MB/s over %u connection(s)\n", receivedCount.load(), seconds, throughput, receivedBytes / seconds / 1e6, server.AcceptedConnectionCount());
+	CHECK(throughput >= minimumThroughput);
+	// All messages went over the one persistent connection. Stop() may open one more for the statistics of the lanes.
+	CHECK(server.AcceptedConnectionCount() <= 2);
+
+	return TestResult("TcpThroughputTest");
+}
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// The checks of the tests. Every test is a small program that returns 0 when all checks passed. (See tests/RunTests.sh)
+
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+inline int testFailureCount = 0;
+
+/**
+ * A failed check is printed and the test continues, so one run shows all failures.
+ */
+#define CHECK(condition) do { if (!(condition)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); testFailureCount++; } } while (0)
+
+/**
+ * @brief Waits until the condition is true or the timeout is reached.
+ *
+ * @return The last result of the condition.
+ */
+inline bool WaitUntil(const std::function<bool()>& condition, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+{
+	auto deadline = std::chrono::steady_clock::now() + timeout;
+	while (condition() == false) {
+		if (std::chrono::steady_clock::now() >= deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+inline int TestResult(const char* testName)
+{
+	if (testFailureCount == 0) {
+		printf("%s: passed\n", testName);
+		return 0;
+	}
+	printf("%s: %d checks failed\n", testName, testFailureCount);
+	return 1;
+}
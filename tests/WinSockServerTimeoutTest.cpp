@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Checks that the WinSockServer closes a client that stopped in the middle of a frame, but keeps idle clients and serves the other clients meanwhile. (See WinSockServer.h)
+// The timeout is shortened to one second, so the test does not wait for the default.
+//
+// Build on Linux: g++ -std=c++17 -O2 -pthread -o WinSockServerTimeoutTest tests/WinSockServerTimeoutTest.cpp WhatsappTray/WinSockServer.cpp WhatsappTray/TcpClient.cpp
+
+#include "../WhatsappTray/MessageFraming.h"
+#include "../WhatsappTray/TcpClient.h"
+#include "../WhatsappTray/WinSockServer.h"
+#include "TestSupport.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+constexpr std::chrono::seconds partialFrameTimeout(1);
+
+std::string FindFreePort()
+{
+	SOCKET probeSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressSize = sizeof(address);
+	std::string portString;
+	if (bind(probeSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != SOCKET_ERROR
+		&& getsockname(probeSocket, reinterpret_cast<sockaddr*>(&address), &addressSize) != SOCKET_ERROR) {
+		portString = std::to_string(ntohs(address.sin_port));
+	}
+	closesocket(probeSocket);
+	return portString;
+}
+
+std::string CreateFrame(const std::string& text)
+{
+	std::string record;
+	LogRecordWriter::BeginText(record, 1);
+	record.append(text);
+	std::string frame;
+	MessageFraming::AppendFrame(frame, record.data(), record.size());
+	return frame;
+}
+
+/**
+ * @brief True if the server closed the connection. Waits up to timeout for it.
+ */
+bool IsClosedByServer(SOCKET clientSocket, std::chrono::milliseconds timeout)
+{
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(clientSocket, &readSet);
+	timeval timeoutTime;
+	timeoutTime.tv_sec = static_cast<long>(timeout.count() / 1000);
+	timeoutTime.tv_usec = static_cast<long>((timeout.count() % 1000) * 1000);
+	if (select(SelectSocketCount(clientSocket), &readSet, NULL, NULL, &timeoutTime) <= 0) {
+		return false;
+	}
+	char buffer[16];
+	return recv(clientSocket, buffer, sizeof(buffer), 0) <= 0;
+}
+
+SOCKET Connect(const std::string& portString)
+{
+	sockaddr_in serverAddress{};
+	SOCKET clientSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (TcpClient::CreateServerAddress("127.0.0.1", portString.c_str(), serverAddress) == false
+		|| connect(clientSocket, reinterpret_cast<const sockaddr*>(&serverAddress), sizeof(serverAddress)) == SOCKET_ERROR) {
+		closesocket(clientSocket);
+		return INVALID_SOCKET;
+	}
+	return clientSocket;
+}
+
+}
+
+int main()
+{
+	StartupSockets();
+	std::string portString = FindFreePort();
+	CHECK(portString.empty() == false);
+
+	// Only touched by the thread of the server.
+	std::atomic<uint32_t> receivedCount = 0;
+	std::atomic<uint32_t> stalledNoticeCount = 0;
+	WinSockServer server(portString.c_str(), partialFrameTimeout);
+	server.NotifyOnNewMessage([&](const LogLine& line) {
+		if (line.text.compare(0, 6, "<Conne") == 0) {
+			stalledNoticeCount++;
+		} else {
+			receivedCount++;
+		}
+	});
+	std::thread serverThread([&]() { server.Run(); });
+
+	SOCKET idleSocket = INVALID_SOCKET;
+	CHECK(WaitUntil([&]() { return (idleSocket = Connect(portString)) != INVALID_SOCKET; }));
+	SOCKET stalledSocket = Connect(portString);
+	SOCKET activeSocket = Connect(portString);
+	CHECK(stalledSocket != INVALID_SOCKET && activeSocket != INVALID_SOCKET);
+
+	// The idle client sent complete frames and then nothing.
+	std::string frame = CreateFrame("idle");
+	CHECK(send(idleSocket, frame.data(), static_cast<int>(frame.size()), socketSendFlags) == static_cast<int>(frame.size()));
+	// The stalled client stops in the middle of its frame, like a hooked process that hangs.
+	frame = CreateFrame("stalled");
+	CHECK(send(stalledSocket, frame.data(), static_cast<int>(frame.size() / 2), socketSendFlags) == static_cast<int>(frame.size() / 2));
+	CHECK(WaitUntil([&]() { return receivedCount == 1; }));
+
+	// Meanwhile the other clients are served.
+	auto stallStart = std::chrono::steady_clock::now();
+	frame = CreateFrame("active");
+	for (int i = 0; i < 10; i++) {
+		CHECK(send(activeSocket, frame.data(), static_cast<int>(frame.size()), socketSendFlags) == static_cast<int>(frame.size()));
+	}
+	CHECK(WaitUntil([&]() { return receivedCount == 11; }));
+	CHECK(stalledNoticeCount == 0);
+
+	// The select()-timeout of the server is one second, so the stalled client is closed within two seconds after the timeout.
+	CHECK(IsClosedByServer(stalledSocket, std::chrono::milliseconds(4000)));
+	auto closeTime = std::chrono::steady_clock::now() - stallStart;
+	printf("  stalled client closed after %lldms\n", static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(closeTime).count()));
+	CHECK(closeTime >= partialFrameTimeout - std::chrono::milliseconds(100));
+	CHECK(WaitUntil([&]() { return stalledNoticeCount == 1; }));
+
+	// The idle and the active client are still connected.
+	CHECK(IsClosedByServer(idleSocket, std::chrono::milliseconds(100)) == false);
+	CHECK(IsClosedByServer(activeSocket, std::chrono::milliseconds(100)) == false);
+	frame = CreateFrame("idle again");
+	CHECK(send(idleSocket, frame.data(), static_cast<int>(frame.size()), socketSendFlags) == static_cast<int>(frame.size()));
+	CHECK(WaitUntil([&]() { return receivedCount == 12; }));
+
+	closesocket(idleSocket);
+	closesocket(stalledSocket);
+	closesocket(activeSocket);
+	server.Stop();
+	serverThread.join();
+	CleanupSockets();
+
+	return TestResult("WinSockServerTimeoutTest");
+}
@@ -0,0 +1,288 @@
+/* SPDX-License-Identifier: GPL-3.0-only */
+/* Copyright(C) 2021 - 2021 WhatsappTray Sebastian Amann */
+
+// Reads the binary log-journals of WhatsappTray (*.wtlj) and prints them as text. (See WhatsappTray/LogJournal.h)
+// The records are filtered with the fields of the record-header, so records that are not printed are skipped without looking at the text.
+//
+// Build on Linux:   g++ -std=c++17 -O2 -o LogJournalDecoder tools/LogJournalDecoder.cpp
+// Build on Windows: cl /std:c++17 /O2 /EHsc tools\LogJournalDecoder.cpp
+//
+// Usage: LogJournalDecoder [options] <file>...
+//   --level=<fatal|error|warning|info|debug>  Only records up to this level. Records without level, like the ones of the hook, are always printed.
+//   --module=<name>                           Only records of this module, for example "WhatsappTray" or "Hook". Can be passed multiple times.
+//   --producer=<process-id>                   Only records of this process.
+//   --from=<time> --to=<time>                 Only records in this time-range. "YYYY-MM-DDTHH:MM:SS" in local time or seconds since 1970.
+// The files are printed in the order they are passed, so pass the segments of a session sorted.
+
+#include "../WhatsappTray/LogJournal.h"
+#include "../WhatsappTray/LogTimestampFormatter.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/* The same order as Loglevel in Logger.h. */
+const char* const levelNames[] = { "-", "APP", "FATAL", "ERROR", "WARNING", "INFO", "DEBUG" };
+constexpr uint8_t levelCount = sizeof(levelNames) / sizeof(levelNames[0]);
+
+struct DecoderFilter
+{
+	uint8_t maxLevel = levelCount - 1;
+	std::vector<std::string> modules;
+	bool hasProducer = false;
+	uint32_t producerId = 0;
+	int64_t fromUnixTimeNs = INT64_MIN;
+	int64_t toUnixTimeNs = INT64_MAX;
+};
+
+/**
+ * @brief Reads the file in big blocks. The records are taken directly out of the block.
+ */
+class JournalReader
+{
+public:
+	explicit JournalReader(FILE* file)
+		: _file(file), _buffer(blockSize)
+	{
+	}
+
+	/**
+	 * @brief Makes sure that the next count bytes are in the buffer.
+	 * @return Nullptr at the end of the file.
+	 */
+	const char* Peek(size_t count)
+	{
+		if (_end - _position < count) {
+			Refill(count);
+			if (_end - _position < count) {
+				return nullptr;
+			}
+		}
+		return _buffer.data() + _position;
+	}
+
+	/**
+	 * @return False if the file ended before.
+	 */
+	bool Skip(size_t count)
+	{
+		if (_end - _position >= count) {
+			_position += count;
+			return true;
+		}
+
+		// Only a long record is not in the buffer. Let the file skip it.
+		count -= _end - _position;
+		_position = _end;
+		return fseek(_file, static_cast<long>(count), SEEK_CUR) == 0;
+	}
+
+private:
+	static constexpr size_t blockSize = 1024 * 1024;
+
+	FILE* _file;
+	std::vector<char> _buffer;
+	size_t _position = 0;
+	size_t _end = 0;
+
+	void Refill(size_t count)
+	{
+		size_t remaining = _end - _position;
+		memmove(_buffer.data(), _buffer.data() + _position, remaining);
+		_position = 0;
+		_end = remaining;
+		if (_buffer.size() < count) {
+			_buffer.resize(count);
+		}
+		_end += fread(_buffer.data() + _end, 1, _buffer.size() - _end, _file);
+	}
+};
+
+bool ParseLevel(const char* name, uint8_t& level)
+{
+	const char* const names[] = { "fatal", "error", "warning", "info", "debug" };
+	for (uint8_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (strcmp(name, names[i]) == 0) {
+			// "fatal" is Loglevel::LOG_FATAL
+			level = i + 2;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Parses "YYYY-MM-DDTHH:MM:SS" in local time or seconds since 1970.
+ */
+bool ParseTime(const char* text, int64_t& unixTimeNs)
+{
+	struct tm localTime = {};
+	char separator = 0;
+	if (sscanf(text, "%d-%d-%d%c%d:%d:%d", &localTime.tm_year, &localTime.tm_mon, &localTime.tm_mday, &separator, &localTime.tm_hour, &localTime.tm_min, &localTime.tm_sec) == 7 && (separator == 'T' || separator == ' ')) {
+		localTime.tm_year -= 1900;
+		localTime.tm_mon -= 1;
+		localTime.tm_isdst = -1;
+		unixTimeNs = static_cast<int64_t>(mktime(&localTime)) * 1000000000;
+		return true;
+	}
+
+	char* end = nullptr;
+	long long seconds = strtoll(text, &end, 10);
+	if (end == text || *end != '\0') {
+		return false;
+	}
+	unixTimeNs = seconds * 1000000000;
+	return true;
+}
+
+bool MatchesModule(const LogJournalRecordHeader& header, const char* text, const DecoderFilter& filter)
+{
+	if (filter.modules.empty()) {
+		return true;
+	}
+	for (const auto& module : filter.modules) {
+		if (module.size() == header.moduleLength && memcmp(text + header.moduleOffset, module.data(), module.size()) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @return False if the file is not a journal.
+ */
+bool DecodeFile(const char* path, const DecoderFilter& filter, LogTimestampFormatter& timestampFormatter, std::string& output)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr) {
+		fprintf(stderr, "ERROR: '%s' could not be opened.\n", path);
+		return false;
+	}
+
+	JournalReader reader(file);
+	const char* data = reader.Peek(sizeof(LogJournalFileHeader));
+	LogJournalFileHeader fileHeader;
+	if (data != nullptr) {
+		memcpy(&fileHeader, data, sizeof(fileHeader));
+	}
+	if (data == nullptr || memcmp(fileHeader.magic, logJournalMagic, sizeof(fileHeader.magic)) != 0 || fileHeader.version != logJournalVersion) {
+		fprintf(stderr, "ERROR: '%s' is not a log-journal.\n", path);
+		fclose(file);
+		return false;
+	}
+	reader.Skip(fileHeader.headerSize);
+
+	// The records are sorted by time within a file. The range is still checked for every record, because the hook sends its records a bit later.
+	int64_t clockToUnixTime = fileHeader.unixTimeNs - fileHeader.clockTimestamp;
+
+	while ((data = reader.Peek(sizeof(LogJournalRecordHeader))) != nullptr) {
+		LogJournalRecordHeader header;
+		memcpy(&header, data, sizeof(header));
+		// The rest of the segment is filled with zeros.
+		if (header.size < sizeof(header)) {
+			break;
+		}
+
+		int64_t unixTimeNs = header.timestamp + clockToUnixTime;
+		bool isSelected = header.level <= filter.maxLevel
+			&& (filter.hasProducer == false || header.producerId == filter.producerId)
+			&& unixTimeNs >= filter.fromUnixTimeNs && unixTimeNs <= filter.toUnixTimeNs;
+		if (isSelected == false) {
+			if (reader.Skip(header.size) == false) {
+				break;
+			}
+			continue;
+		}
+
+		data = reader.Peek(header.size);
+		if (data == nullptr) {
+			// The last record was not completely written.
+			break;
+		}
+		const char* text = data + sizeof(header);
+		size_t textLength = header.size - sizeof(header);
+		if (header.moduleOffset + header.moduleLength <= textLength && MatchesModule(header, text, filter)) {
+			auto time = std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(unixTimeNs)));
+			timestampFormatter.AppendTo(output, time);
+			output.push_back(' ');
+			output.append(header.level < levelCount ? levelNames[header.level] : "?");
+			output.push_back(' ');
+			output.append(std::to_string(header.producerId));
+			output.push_back(' ');
+			output.append(text, textLength);
+			output.push_back('\n');
+			if (output.size() > 64 * 1024) {
+				fwrite(output.data(), 1, output.size(), stdout);
+				output.clear();
+			}
+		}
+		reader.Skip(header.size);
+	}
+
+	fclose(file);
+	return true;
+}
+
+void PrintUsage()
+{
+	fprintf(stderr, "Usage: LogJournalDecoder [--level=<fatal|error|warning|info|debug>] [--module=<name>]... [--producer=<process-id>] [--from=<time>] [--to=<time>] <file>...\n");
+	fprintf(stderr, "       <time> is \"YYYY-MM-DDTHH:MM:SS\" in local time or seconds since 1970.\n");
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+	DecoderFilter filter;
+	std::vector<const char*> paths;
+
+	for (int i = 1; i < argc; i++) {
+		const char* argument = argv[i];
+		bool isValid = true;
+		if (strncmp(argument, "--level=", 8) == 0) {
+			isValid = ParseLevel(argument + 8, filter.maxLevel);
+		} else if (strncmp(argument, "--module=", 9) == 0) {
+			filter.modules.push_back(argument + 9);
+		} else if (strncmp(argument, "--producer=", 11) == 0) {
+			filter.hasProducer = true;
+			filter.producerId = static_cast<uint32_t>(strtoul(argument + 11, nullptr, 10));
+		} else if (strncmp(argument, "--from=", 7) == 0) {
+			isValid = ParseTime(argument + 7, filter.fromUnixTimeNs);
+		} else if (strncmp(argument, "--to=", 5) == 0) {
+			isValid = ParseTime(argument + 5, filter.toUnixTimeNs);
+		} else if (strncmp(argument, "--", 2) == 0) {
+			isValid = false;
+		} else {
+			paths.push_back(argument);
+		}
+
+		if (isValid == false) {
+			fprintf(stderr, "ERROR: Invalid argument '%s'.\n", argument);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (paths.empty()) {
+		PrintUsage();
+		return 1;
+	}
+
+	LogTimestampFormatter timestampFormatter("%Y-%m-%d %H:%M:%S");
+	std::string output;
+	int result = 0;
+	for (const char* path : paths) {
+		if (DecodeFile(path, filter, timestampFormatter, output) == false) {
+			result = 1;
+		}
+	}
+	fwrite(output.data(), 1, output.size(), stdout);
+	return result;
+}